@@ -11,7 +11,7 @@
 #include <algorithm>
 #include <vector>
 #include <unordered_map>
-#include <Windows.h>
+#include "Platform.h"
 
 namespace AlexeiMikhailov
 {
@@ -58,26 +58,26 @@ namespace AlexeiMikhailov
 
 # pragma region SIZE TYPES
 
-	using byte_t = unsigned __int8;
-	using err_t = unsigned __int8;
+	using byte_t = uint8_t;
+	using err_t = uint8_t;
 
-# ifdef _WIN64
-	using const_size_t = const unsigned __int64;
-	using word_t = unsigned __int64;
-	using addr_t = unsigned __int64;
-	using const_diff_t = const __int64;
+# if defined(_WIN64) || defined(__LP64__)
+	using const_size_t = const uint64_t;
+	using word_t = uint64_t;
+	using addr_t = uint64_t;
+	using const_diff_t = const int64_t;
 	constexpr size_t word_size = sizeof(word_t);
 	constexpr size_t addr_size = sizeof(addr_t);
-	constexpr size_t bits_per_word = word_size * 8ui64;
+	constexpr size_t bits_per_word = word_size * 8u;
 	constexpr size_t sign_bit_mask = 0x8000000000000000;
 # else
-	using const_size_t = const unsigned __int32;
-	using word_t = unsigned __int32;
-	using addr_t = unsigned __int32;
-	using const_diff_t = const __int32;
+	using const_size_t = const uint32_t;
+	using word_t = uint32_t;
+	using addr_t = uint32_t;
+	using const_diff_t = const int32_t;
 	constexpr size_t word_size = sizeof(word_t);
 	constexpr size_t addr_size = sizeof(addr_t);
-	constexpr size_t bits_per_word = word_size * 8ui32;
+	constexpr size_t bits_per_word = word_size * 8u;
 	constexpr size_t sign_bit_mask = 0x80000000;
 # endif
 
@@ -87,38 +87,38 @@ namespace AlexeiMikhailov
 
 # pragma region SIZE LITERAL MACRO
 
-# ifdef _WIN64
+# if defined(_WIN64) || defined(__LP64__)
 
 	/// Preprocessor macro which replaces suffix-less integer literal to be sizeof-ready. 
 	///	This macro uses different code style to be similar to standard C `sizeof` keyword to keep consistency. 
-#	define word_literal(x) ((const_size_t)(x##ui64)) // NOLINT
+#	define word_literal(x) ((const_size_t)(x##ull)) // NOLINT
 
 	/// Preprocessor macro which replaces suffix-less integer literal to be sizeof-ready. 
 	///	This macro uses different code style to be similar to standard C `sizeof` keyword to keep consistency. 
-#	define size_literal(x) ((const_size_t)(x##ui64)) // NOLINT
+#	define size_literal(x) ((const_size_t)(x##ull)) // NOLINT
 
 	/// Preprocessor macro which replaces suffix-less integer literal to be sizeof-ready. 
 	///	This macro uses lower_snake_case code style to be similar to standard C `sizeof` keyword to keep consistency. 
-#	define diff_literal(x) (const_diff_t(x##ui64)) // NOLINT
+#	define diff_literal(x) (const_diff_t(x##ll)) // NOLINT
 # else
 	/// Preprocessor macro which replaces suffix-less integer literal to be sizeof-ready. 
 	///	This macro uses lower_snake_case code style to be similar to standard C `sizeof` keyword to keep consistency. 
-#	define word_literal(x) (const_size_t(x##ui32)) // NOLINT
+#	define word_literal(x) (const_size_t(x##u)) // NOLINT
 
 	/// Preprocessor macro which replaces suffix-less integer literal to be sizeof-ready. 
 	///	This macro uses lower_snake_case code style to be similar to standard C `sizeof` keyword to keep consistency. 
-#	define size_literal(x) (const_size_t(x##ui32)) // NOLINT
+#	define size_literal(x) (const_size_t(x##u)) // NOLINT
 
 	/// Preprocessor macro which replaces suffix-less integer literal to be sizeof-ready. 
 	///	This macro uses lower_snake_case code style to be similar to standard C `sizeof` keyword to keep consistency. 
-#	define diff_literal(x) (const_diff_t(x##ui32)) // NOLINT
+#	define diff_literal(x) (const_diff_t(x)) // NOLINT
 # endif
 
 # pragma endregion
 
 	inline size_t align(size_t size)
 	{
-# ifdef _WIN64
+# if defined(_WIN64) || defined(__LP64__)
 		return size + 0b00000000'00000000'00000000'00000000'00000000'00000000'00000000'00000111 &
 			0b11111111'11111111'11111111'11111111'11111111'11111111'11111111'11111000;
 # else
@@ -139,7 +139,7 @@ namespace AlexeiMikhailov
 		return size + alignment & ~alignment;
 	}
 
-	enum class allocate_result : unsigned __int8
+	enum class allocate_result : uint8_t
 	{
 		ok,
 		busy_arena,
@@ -597,10 +597,10 @@ namespace AlexeiMikhailov
 			size = alignment == 0 ? align(size) : align(size, alignment);
 
 			static size_t size_key = 0u;
-# ifdef _WIN64
-			size_key = 64ui64 - __lzcnt64(size - size_literal(1));
+# if defined(_WIN64) || defined(__LP64__)
+			size_key = 64ull - __lzcnt64(size - size_literal(1));
 #else
-			size_key = 32ui32 - __lzcnt(size - size_literal(1));
+			size_key = 32u - __lzcnt(size - size_literal(1));
 # endif
 			size = size_literal(1) << size_key;
 
@@ -63,6 +63,26 @@ namespace AlexeyAntropov
 				}
 				~PoolAllocator();
 
+				template<typename TVisitor>
+				void WalkHeap(TVisitor& visitor) const
+				{
+					for (const Page& page : m_pages)
+					{
+						if (!page.m_pData)
+						{
+							continue;
+						}
+
+						visitor.Region(page.m_pData, page.m_totalSize);
+						for (size_t offset = page.m_first; offset != InvalidIndexUINT64;)
+						{
+							const Header* block = reinterpret_cast<const Header*>(static_cast<const uint8_t*>(page.m_pData) + offset);
+							visitor.Block(block + 1, block->m_size, block->bIsFree);
+							offset = block->m_next;
+						}
+					}
+				}
+
 			private:
 
 				bool RequestPage(Page& page, size_t size, size_t pageIndex) const;
@@ -121,6 +141,32 @@ namespace AlexeyAntropov
 				void* Allocate();
 				void Free(void* ptr);
 
+				template<typename TVisitor>
+				void WalkHeap(TVisitor& visitor) const
+				{
+					for (const SmallPage& page : m_pages)
+					{
+						if (!page.m_pData)
+						{
+							continue;
+						}
+
+						visitor.Region(page.m_pData, SmallPage::m_size);
+
+						std::vector<bool> bFree(page.GetMaxBlocksNum(), false);
+						for (uint16_t id : page.m_freeList)
+						{
+							bFree[id] = true;
+						}
+
+						// the first block only holds the header of the second one, every header is at the end of the previous block
+						for (size_t id = 1; id < page.GetMaxBlocksNum(); id++)
+						{
+							visitor.Block(static_cast<const uint8_t*>(page.m_pData) + id * m_blockSize, m_blockSize - sizeof(SmallHeader), bFree[id]);
+						}
+					}
+				}
+
 			private:
 
 				uint8_t m_blockSize = 0;
@@ -138,6 +184,19 @@ namespace AlexeyAntropov
 			void* Allocate(size_t size, size_t alignment);
 			void Free(void* ptr);
 
+			template<typename TVisitor>
+			void WalkHeap(TVisitor& visitor) const
+			{
+				for (const auto& smallAllocator : m_smallAllocators)
+				{
+					if (smallAllocator)
+					{
+						smallAllocator->WalkHeap(visitor);
+					}
+				}
+				m_allocator.WalkHeap(visitor);
+			}
+
 		private:
 
 			inline size_t CalculateAlignedSize(size_t blockSize) const;
@@ -201,7 +260,7 @@ namespace AlexeyAntropov
 
 		size_t PoolAllocator::Page::GetMinAllowedEmptySpace() const
 		{
-			return (std::min)(2048ull, (std::max)((size_t)(m_totalSize * 0.05f), SAILOR_SMALLEST_DATA_SIZE * 2ull));
+			return (std::min)((size_t)2048ull, (std::max)((size_t)(m_totalSize * 0.05f), (size_t)(SAILOR_SMALLEST_DATA_SIZE * 2ull)));
 		}
 
 		Header* Page::MoveHeader(Header* block, int64_t shift)
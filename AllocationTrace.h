@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "Platform.h"
+
+// Binary allocation trace.
+//
+// The file starts with AllocationTraceHeader, followed by a stream of records, every value is an unsigned LEB128 varint.
+// The first varint of a record is (value << 2) | opcode:
+//     Allocate: (id << 2) | 0, size, alignment
+//     Free:     (id << 2) | 1
+//     Thread:   (threadId << 2) | 2, the following records were made by that thread
+// Opcode 3 is reserved. Ids are small integers reused after Free (like file descriptors),
+// so the replayer keeps live pointers in a plain array indexed by id; sparse large ids of other writers go to a hash map.
+// realloc is recorded as Allocate of the new block followed by Free of the old one.
+
+enum class ETraceOpcode : uint8_t
+{
+	Allocate = 0,
+	Free = 1,
+	Thread = 2
+};
+
+struct AllocationTraceHeader
+{
+	static const uint32_t VERSION = 1;
+
+	char m_magic[8];
+	uint32_t m_version;
+	uint32_t m_flags;
+	// Upper bound of the ids, 0 if unknown
+	uint64_t m_idsCount;
+	// Number of records, 0 if unknown
+	uint64_t m_recordsCount;
+
+	static const char* GetMagic()
+	{
+		return "ALLOCTRC";
+	}
+
+	void Init()
+	{
+		memcpy(m_magic, GetMagic(), sizeof(m_magic));
+		m_version = VERSION;
+		m_flags = 0;
+		m_idsCount = 0;
+		m_recordsCount = 0;
+	}
+
+	bool IsValid() const
+	{
+		return memcmp(m_magic, GetMagic(), sizeof(m_magic)) == 0 && m_version == VERSION;
+	}
+};
+
+struct TraceRecord
+{
+	ETraceOpcode m_opcode;
+	uint64_t m_id;
+	uint64_t m_size;
+	uint64_t m_alignment;
+};
+
+namespace Varint
+{
+	static const size_t MAX_LENGTH = 10;
+
+	// Writes the value into buffer (at least MAX_LENGTH bytes), returns the number of bytes written
+	inline size_t Encode(uint64_t value, uint8_t* buffer)
+	{
+		size_t length = 0;
+		while (value >= 0x80)
+		{
+			buffer[length++] = (uint8_t)(value | 0x80);
+			value >>= 7;
+		}
+		buffer[length++] = (uint8_t)value;
+		return length;
+	}
+
+	// Returns nullptr if the varint is truncated or too long
+	inline const uint8_t* Decode(const uint8_t* data, const uint8_t* end, uint64_t& value)
+	{
+		uint64_t res = 0;
+		for (int shift = 0; shift < 64 && data < end; shift += 7)
+		{
+			const uint8_t byte = *data++;
+			res |= (uint64_t)(byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+			{
+				value = res;
+				return data;
+			}
+		}
+		return nullptr;
+	}
+}
+
+// Appends records to a trace file through an in-memory buffer, the header is rewritten with the final counts on Close
+class AllocationTraceWriter
+{
+public:
+	AllocationTraceWriter() = default;
+	AllocationTraceWriter(const AllocationTraceWriter&) = delete;
+	AllocationTraceWriter& operator=(const AllocationTraceWriter&) = delete;
+
+	~AllocationTraceWriter()
+	{
+		Close();
+	}
+
+	bool Open(const char* path)
+	{
+		Close();
+
+		m_file = fopen(path, "wb");
+		if (!m_file)
+		{
+			return false;
+		}
+
+		m_header.Init();
+		m_buffer.reserve(BUFFER_SIZE + 4 * Varint::MAX_LENGTH);
+		return fwrite(&m_header, sizeof(m_header), 1, m_file) == 1;
+	}
+
+	void Close()
+	{
+		if (!m_file)
+		{
+			return;
+		}
+
+		Flush();
+		fseek(m_file, 0, SEEK_SET);
+		fwrite(&m_header, sizeof(m_header), 1, m_file);
+		fclose(m_file);
+		m_file = nullptr;
+	}
+
+	void Allocate(uint64_t id, uint64_t size, uint64_t alignment)
+	{
+		Put((id << 2) | (uint64_t)ETraceOpcode::Allocate);
+		Put(size);
+		Put(alignment);
+		Commit(id);
+	}
+
+	void Free(uint64_t id)
+	{
+		Put((id << 2) | (uint64_t)ETraceOpcode::Free);
+		Commit(id);
+	}
+
+	void Thread(uint64_t threadId)
+	{
+		Put((threadId << 2) | (uint64_t)ETraceOpcode::Thread);
+		Commit(0);
+	}
+
+	// Already encoded records, the caller is responsible for the counts
+	void WriteRaw(const uint8_t* data, size_t size, uint64_t recordsCount, uint64_t idsCount)
+	{
+		Flush();
+		fwrite(data, 1, size, m_file);
+		m_header.m_recordsCount += recordsCount;
+		m_header.m_idsCount = (std::max)(m_header.m_idsCount, idsCount);
+	}
+
+	void Flush()
+	{
+		if (m_file && !m_buffer.empty())
+		{
+			fwrite(m_buffer.data(), 1, m_buffer.size(), m_file);
+			fflush(m_file);
+			m_buffer.clear();
+		}
+	}
+
+private:
+	static const size_t BUFFER_SIZE = 1024 * 1024;
+
+	inline void Put(uint64_t value)
+	{
+		uint8_t bytes[Varint::MAX_LENGTH];
+		const size_t length = Varint::Encode(value, bytes);
+		m_buffer.insert(m_buffer.end(), bytes, bytes + length);
+	}
+
+	inline void Commit(uint64_t id)
+	{
+		m_header.m_recordsCount++;
+		m_header.m_idsCount = (std::max)(m_header.m_idsCount, id + 1);
+		if (m_buffer.size() >= BUFFER_SIZE)
+		{
+			Flush();
+		}
+	}
+
+	FILE* m_file = nullptr;
+	AllocationTraceHeader m_header;
+	std::vector<uint8_t> m_buffer;
+};
+
+// Sequential reader on top of the memory mapped file, records are decoded one by one,
+// the consumed part of the file is periodically dropped from the working set.
+class AllocationTraceReader
+{
+public:
+	bool Open(const char* path)
+	{
+		if (!m_file.Open(path) || m_file.GetSize() < sizeof(AllocationTraceHeader))
+		{
+			m_file.Close();
+			return false;
+		}
+
+		memcpy(&m_header, m_file.GetData(), sizeof(m_header));
+		if (!m_header.IsValid())
+		{
+			m_file.Close();
+			return false;
+		}
+
+		Rewind();
+		return true;
+	}
+
+	void Rewind()
+	{
+		m_position = m_file.GetData() + sizeof(AllocationTraceHeader);
+		m_released = m_file.GetData();
+		m_bCorrupted = false;
+	}
+
+	// Returns false at the end of the trace or if it's corrupted
+	inline bool Next(TraceRecord& record)
+	{
+		const uint8_t* end = m_file.GetData() + m_file.GetSize();
+		if (m_position >= end)
+		{
+			return false;
+		}
+
+		uint64_t value = 0;
+		const uint8_t* position = Varint::Decode(m_position, end, value);
+		if (!position)
+		{
+			m_bCorrupted = true;
+			return false;
+		}
+
+		record.m_opcode = (ETraceOpcode)(value & 3);
+		record.m_id = value >> 2;
+
+		switch (record.m_opcode)
+		{
+		case ETraceOpcode::Allocate:
+			position = Varint::Decode(position, end, record.m_size);
+			position = position ? Varint::Decode(position, end, record.m_alignment) : nullptr;
+			break;
+		case ETraceOpcode::Free:
+		case ETraceOpcode::Thread:
+			break;
+		default:
+			position = nullptr;
+			break;
+		}
+
+		if (!position)
+		{
+			m_bCorrupted = true;
+			return false;
+		}
+
+		m_position = position;
+		return true;
+	}
+
+	// Drops the pages read since the last call from the working set, cheap enough to call every few thousands records
+	void ReleaseConsumed()
+	{
+		if (m_position - m_released >= RELEASE_STEP)
+		{
+			m_file.Release((size_t)(m_position - m_file.GetData()));
+			m_released = m_position;
+		}
+	}
+
+	const AllocationTraceHeader& GetHeader() const
+	{
+		return m_header;
+	}
+
+	bool IsCorrupted() const
+	{
+		return m_bCorrupted;
+	}
+
+	size_t GetFileSize() const
+	{
+		return m_file.GetSize();
+	}
+
+private:
+	static const ptrdiff_t RELEASE_STEP = 64 * 1024 * 1024;
+
+	Platform::MappedFile m_file;
+	AllocationTraceHeader m_header;
+	const uint8_t* m_position = nullptr;
+	const uint8_t* m_released = nullptr;
+	bool m_bCorrupted = false;
+};
@@ -0,0 +1,42 @@
+// LD_PRELOAD library replacing malloc of any program with one of the contest allocators.
+// The allocator is selected at build time, one library per allocator:
+//
+//     g++ -std=c++17 -O2 -fPIC -shared -pthread -DSHIM_ALLOCATOR=AntonShatalov::Ololokator AllocatorShim.cpp -o libololokator.so -ldl
+//     LD_PRELOAD=./libololokator.so ./app
+//
+// See AllocatorShim.h for the details and README.md for the commands of every participant.
+
+// the participants' headers rely on these, AntonShatalov.h defines min/max macros, so they go first
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Platform.h"
+#include "AllocatorShim.h"
+
+#include "DaniilPavlenko.h"
+#include "OlegApanasik.h"
+#include "AlexeyAntropov.h"
+#include "AntonShatalov.h"
+#include "AlexeiMikhailov.h"
+#include "DenisPerevalov.h"
+
+#ifndef SHIM_ALLOCATOR
+#error "Define SHIM_ALLOCATOR to the allocator class, e.g. -DSHIM_ALLOCATOR=AntonShatalov::Ololokator"
+#endif
+
+DEFINE_ALLOCATOR_SHIM(SHIM_ALLOCATOR)
@@ -0,0 +1,319 @@
+#pragma once
+
+#ifdef _WIN32
+#error "AllocatorShim is a Linux LD_PRELOAD library"
+#endif
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <dlfcn.h>
+#include <malloc.h>
+#include <new>
+#include <pthread.h>
+#include <unistd.h>
+#include "LockedAllocator.h"
+
+// Runs a contest allocator as the process-wide malloc, see AllocatorShim.cpp for the build.
+//
+// One TAllocator instance serves all the threads behind TLock, it's created on the first call and never destroyed,
+// because the process keeps freeing memory after the static destructors ran.
+// Every block has a 16 bytes header with the requested size (for realloc and malloc_usable_size),
+// the distance to the block returned by the allocator and the owner of the block.
+// Blocks are aligned by the shim itself, the participants don't have to honor the alignment.
+// The participants get their own memory with malloc, so the calls made from inside the allocator,
+// sizes it can't serve and the calls made before it's created go to glibc.
+// The mmap threshold of glibc is fixed, so the pools of the participants always come from mmap:
+// with the dynamic threshold they move to the brk heap after a while, and the allocators that keep
+// a lookup table over the whole address range of their pools (Ololokator) blow it up to gigabytes.
+
+extern "C"
+{
+	void* __libc_malloc(size_t size);
+	void __libc_free(void* ptr);
+}
+
+template<typename TAllocator, typename TLock = SpinLock>
+class AllocatorShim
+{
+public:
+	static const size_t HEADER_SIZE = 16;
+	static const size_t DEFAULT_ALIGNMENT = 16;
+	static const int MMAP_THRESHOLD = 128 * 1024;
+
+	static void* Malloc(size_t size)
+	{
+		return Memalign(DEFAULT_ALIGNMENT, size);
+	}
+
+	static void* Memalign(size_t alignment, size_t size)
+	{
+		alignment = alignment < DEFAULT_ALIGNMENT ? DEFAULT_ALIGNMENT : alignment;
+		if (size > SIZE_MAX - HEADER_SIZE - alignment)
+		{
+			errno = ENOMEM;
+			return nullptr;
+		}
+
+		const size_t total = size + HEADER_SIZE + alignment - 1;
+
+		if (!t_bInside)
+		{
+			t_bInside = true;
+			m_lock.Lock();
+
+			TAllocator* allocator = GetAllocator();
+			void* raw = allocator ? allocator->Allocate(total, 1) : nullptr;
+
+			m_lock.Unlock();
+			t_bInside = false;
+
+			if (raw)
+			{
+				return Place(raw, size, alignment, EOwner::Participant);
+			}
+		}
+
+		void* raw = __libc_malloc(total);
+		if (!raw)
+		{
+			errno = ENOMEM;
+			return nullptr;
+		}
+		return Place(raw, size, alignment, EOwner::Libc);
+	}
+
+	static void Free(void* ptr)
+	{
+		if (!ptr)
+		{
+			return;
+		}
+
+		const BlockHeader* header = GetHeader(ptr);
+		void* raw = (uint8_t*)ptr - header->m_offset;
+
+		if (header->m_owner == EOwner::Libc)
+		{
+			__libc_free(raw);
+			return;
+		}
+
+		const bool bInside = t_bInside;
+		t_bInside = true;
+		m_lock.Lock();
+		GetAllocator()->Free(raw);
+		m_lock.Unlock();
+		t_bInside = bInside;
+	}
+
+	static void* Calloc(size_t count, size_t size)
+	{
+		if (size && count > SIZE_MAX / size)
+		{
+			errno = ENOMEM;
+			return nullptr;
+		}
+
+		// the participants reuse the memory, it's never guaranteed to be zeroed
+		void* ptr = Malloc(count * size);
+		if (ptr)
+		{
+			memset(ptr, 0, count * size);
+		}
+		return ptr;
+	}
+
+	static void* Realloc(void* ptr, size_t size)
+	{
+		if (!ptr)
+		{
+			return Malloc(size);
+		}
+		if (size == 0)
+		{
+			Free(ptr);
+			return nullptr;
+		}
+
+		const size_t oldSize = GetHeader(ptr)->m_size;
+		if (size <= oldSize && size >= oldSize / 2)
+		{
+			GetHeader(ptr)->m_size = size;
+			return ptr;
+		}
+
+		void* res = Malloc(size);
+		if (res)
+		{
+			memcpy(res, ptr, oldSize < size ? oldSize : size);
+			Free(ptr);
+		}
+		return res;
+	}
+
+	static int PosixMemalign(void** memptr, size_t alignment, size_t size)
+	{
+		if ((alignment & (alignment - 1)) || alignment % sizeof(void*) != 0)
+		{
+			return EINVAL;
+		}
+
+		void* ptr = Memalign(alignment, size);
+		if (!ptr)
+		{
+			return ENOMEM;
+		}
+		*memptr = ptr;
+		return 0;
+	}
+
+	static size_t UsableSize(void* ptr)
+	{
+		return ptr ? GetHeader(ptr)->m_size : 0;
+	}
+
+	// The threads started from inside the allocator (OlegApanasik populates its blocks in parallel) would wait
+	// for the lock held by their creator, so they get their memory from glibc as the creator does
+	static int CreateThread(pthread_t* thread, const pthread_attr_t* attr, void* (*start)(void*), void* arg)
+	{
+		typedef int (*CreateThreadFunc)(pthread_t*, const pthread_attr_t*, void* (*)(void*), void*);
+		static CreateThreadFunc createThread = (CreateThreadFunc)dlsym(RTLD_NEXT, "pthread_create");
+
+		if (!t_bInside)
+		{
+			return createThread(thread, attr, start, arg);
+		}
+
+		ThreadStart* threadStart = (ThreadStart*)__libc_malloc(sizeof(ThreadStart));
+		if (!threadStart)
+		{
+			return EAGAIN;
+		}
+		threadStart->m_start = start;
+		threadStart->m_arg = arg;
+
+		const int res = createThread(thread, attr, &RunInside, threadStart);
+		if (res != 0)
+		{
+			__libc_free(threadStart);
+		}
+		return res;
+	}
+
+	// fork() must not happen with the allocator locked by another thread
+	static void RegisterForkHandlers()
+	{
+		pthread_atfork([]() { m_lock.Lock(); }, []() { m_lock.Unlock(); }, []() { m_lock.Unlock(); });
+	}
+
+private:
+	enum class EOwner : uint32_t
+	{
+		Participant,
+		Libc
+	};
+
+	struct BlockHeader
+	{
+		uint64_t m_size;
+		uint32_t m_offset;
+		EOwner m_owner;
+	};
+
+	struct ThreadStart
+	{
+		void* (*m_start)(void*);
+		void* m_arg;
+	};
+
+	static void* RunInside(void* arg)
+	{
+		ThreadStart threadStart = *(ThreadStart*)arg;
+		__libc_free(arg);
+
+		t_bInside = true;
+		return threadStart.m_start(threadStart.m_arg);
+	}
+
+	static inline BlockHeader* GetHeader(void* ptr)
+	{
+		return (BlockHeader*)((uint8_t*)ptr - HEADER_SIZE);
+	}
+
+	static inline void* Place(void* raw, size_t size, size_t alignment, EOwner owner)
+	{
+		const uintptr_t address = ((uintptr_t)raw + HEADER_SIZE + alignment - 1) & ~(uintptr_t)(alignment - 1);
+		void* ptr = (void*)address;
+
+		BlockHeader* header = GetHeader(ptr);
+		header->m_size = size;
+		header->m_offset = (uint32_t)(address - (uintptr_t)raw);
+		header->m_owner = owner;
+		return ptr;
+	}
+
+	// Called under the lock, the constructor's own allocations go to glibc
+	static TAllocator* GetAllocator()
+	{
+		if (!m_allocator)
+		{
+			mallopt(M_MMAP_THRESHOLD, MMAP_THRESHOLD);
+			m_allocator = new (m_storage) TAllocator();
+		}
+		return m_allocator;
+	}
+
+	static TLock m_lock;
+	static TAllocator* m_allocator;
+	alignas(64) static uint8_t m_storage[sizeof(TAllocator)];
+	// initial-exec TLS never calls malloc on access
+	static __thread bool t_bInside __attribute__((tls_model("initial-exec")));
+};
+
+template<typename TAllocator, typename TLock>
+TLock AllocatorShim<TAllocator, TLock>::m_lock;
+
+template<typename TAllocator, typename TLock>
+TAllocator* AllocatorShim<TAllocator, TLock>::m_allocator = nullptr;
+
+template<typename TAllocator, typename TLock>
+alignas(64) uint8_t AllocatorShim<TAllocator, TLock>::m_storage[sizeof(TAllocator)];
+
+template<typename TAllocator, typename TLock>
+__thread bool AllocatorShim<TAllocator, TLock>::t_bInside __attribute__((tls_model("initial-exec")));
+
+// Exports the malloc family on top of AllocatorShim<TAllocator>, used once per library
+#define DEFINE_ALLOCATOR_SHIM(TAllocator) \
+	typedef AllocatorShim<TAllocator> ShimType; \
+	extern "C" \
+	{ \
+		void* malloc(size_t size) { return ShimType::Malloc(size); } \
+		void free(void* ptr) { ShimType::Free(ptr); } \
+		void* calloc(size_t count, size_t size) { return ShimType::Calloc(count, size); } \
+		void* realloc(void* ptr, size_t size) { return ShimType::Realloc(ptr, size); } \
+		void* reallocarray(void* ptr, size_t count, size_t size) \
+		{ \
+			if (size && count > SIZE_MAX / size) { errno = ENOMEM; return nullptr; } \
+			return ShimType::Realloc(ptr, count * size); \
+		} \
+		void* memalign(size_t alignment, size_t size) \
+		{ \
+			if (alignment & (alignment - 1)) { errno = EINVAL; return nullptr; } \
+			return ShimType::Memalign(alignment, size); \
+		} \
+		void* aligned_alloc(size_t alignment, size_t size) { return memalign(alignment, size); } \
+		int posix_memalign(void** memptr, size_t alignment, size_t size) { return ShimType::PosixMemalign(memptr, alignment, size); } \
+		void* valloc(size_t size) { return ShimType::Memalign((size_t)sysconf(_SC_PAGESIZE), size); } \
+		void* pvalloc(size_t size) \
+		{ \
+			const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE); \
+			return ShimType::Memalign(pageSize, (size + pageSize - 1) & ~(pageSize - 1)); \
+		} \
+		size_t malloc_usable_size(void* ptr) { return ShimType::UsableSize(ptr); } \
+		int pthread_create(pthread_t* thread, const pthread_attr_t* attr, void* (*start)(void*), void* arg) \
+		{ \
+			return ShimType::CreateThread(thread, attr, start, arg); \
+		} \
+	} \
+	__attribute__((constructor)) static void RegisterAllocatorShim() { ShimType::RegisterForkHandlers(); }
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+// Optional entry points of the allocators, detected at compile time. The contest interface is only
+// Allocate(size, alignment) and Free(ptr), an allocator may add to it:
+//     void* Reallocate(void* ptr, size_t newSize) - resizes a block keeping its content like realloc,
+//                                                    returns nullptr and keeps the block if it can't.
+//     void Free(void* ptr, size_t size) - sized deallocation like the C++14 sized delete: size is the one passed to Allocate,
+//                                                    so the allocator doesn't have to keep it in a header. The harness passes it
+//                                                    for the blocks allocated with alignments up to 8 only, the others go to Free(ptr).
+//     size_t AllocateBatch(size_t size, size_t count, void** out) - count blocks of size bytes with the alignment of 8 at once,
+//                                                    returns how many of them are written to out, fewer if the memory runs out.
+//     void FreeBatch(void** ptrs, size_t count) - frees count blocks, allocated by either call; the blocks of one AllocateBatch
+//                                                    freed in their order are the fast case.
+//     bool Owns(const void* ptr) const - true if ptr is a block of the allocator, found by its address; HybridAllocator needs it
+//                                                    to route Free to the backend holding the block.
+//     template<typename TVisitor> void WalkHeap(TVisitor& visitor) const - enumerates the memory the allocator holds:
+//                                                    visitor.Region(begin, size) for every region taken from the system,
+//                                                    followed by visitor.Block(ptr, size, bFree) for the blocks within it;
+//                                                    ptr is what Allocate returns for the block and size is what it can hold.
+// ReallocateBlock calls Reallocate if it's there and emulates it with the contest calls otherwise, FreeBlock falls back to Free(ptr),
+// AllocateBatchBlocks and FreeBatchBlocks to a loop of the single calls, Owns and WalkHeap have no fallback.
+
+template<typename TAllocator, typename = void>
+struct HasReallocate : std::false_type
+{
+};
+
+template<typename TAllocator>
+struct HasReallocate<TAllocator, std::void_t<decltype(std::declval<TAllocator&>().Reallocate(std::declval<void*>(), size_t()))>> : std::true_type
+{
+};
+
+template<typename TAllocator, typename = void>
+struct HasSizedFree : std::false_type
+{
+};
+
+template<typename TAllocator>
+struct HasSizedFree<TAllocator, std::void_t<decltype(std::declval<TAllocator&>().Free(std::declval<void*>(), size_t()))>> : std::true_type
+{
+};
+
+template<typename TAllocator, typename = void>
+struct HasAllocateBatch : std::false_type
+{
+};
+
+template<typename TAllocator>
+struct HasAllocateBatch<TAllocator, std::void_t<decltype(std::declval<TAllocator&>().AllocateBatch(size_t(), size_t(), std::declval<void**>()))>> : std::true_type
+{
+};
+
+template<typename TAllocator, typename = void>
+struct HasFreeBatch : std::false_type
+{
+};
+
+template<typename TAllocator>
+struct HasFreeBatch<TAllocator, std::void_t<decltype(std::declval<TAllocator&>().FreeBatch(std::declval<void**>(), size_t()))>> : std::true_type
+{
+};
+
+template<typename TAllocator, typename = void>
+struct HasOwns : std::false_type
+{
+};
+
+template<typename TAllocator>
+struct HasOwns<TAllocator, std::void_t<decltype(std::declval<const TAllocator&>().Owns(std::declval<const void*>()))>> : std::true_type
+{
+};
+
+// Stands for the visitors of WalkHeap in the detection
+struct HeapVisitorProbe
+{
+	void Region(const void* /*begin*/, size_t /*size*/) {}
+	void Block(const void* /*ptr*/, size_t /*size*/, bool /*bFree*/) {}
+};
+
+template<typename TAllocator, typename = void>
+struct HasWalkHeap : std::false_type
+{
+};
+
+template<typename TAllocator>
+struct HasWalkHeap<TAllocator, std::void_t<decltype(std::declval<const TAllocator&>().WalkHeap(std::declval<HeapVisitorProbe&>()))>> : std::true_type
+{
+};
+
+// Frees the block of size bytes allocated with an alignment up to 8, with the sized Free if the allocator has it
+template<typename TAllocator>
+inline void FreeBlock(TAllocator& allocator, void* ptr, size_t size)
+{
+	if constexpr (HasSizedFree<TAllocator>::value)
+	{
+		allocator.Free(ptr, size);
+	}
+	else
+	{
+		allocator.Free(ptr);
+	}
+}
+
+// Allocates count blocks of size bytes with the alignment of 8 into out, returns how many are allocated
+template<typename TAllocator>
+inline size_t AllocateBatchBlocks(TAllocator& allocator, size_t size, size_t count, void** out)
+{
+	if constexpr (HasAllocateBatch<TAllocator>::value)
+	{
+		return allocator.AllocateBatch(size, count, out);
+	}
+	else
+	{
+		size_t allocated = 0;
+		for (; allocated < count; allocated++)
+		{
+			out[allocated] = allocator.Allocate(size, 8);
+			if (!out[allocated])
+			{
+				break;
+			}
+		}
+		return allocated;
+	}
+}
+
+// Frees count blocks of size bytes allocated with an alignment up to 8, the fallback passes the size to FreeBlock
+template<typename TAllocator>
+inline void FreeBatchBlocks(TAllocator& allocator, void** ptrs, size_t count, size_t size)
+{
+	if constexpr (HasFreeBatch<TAllocator>::value)
+	{
+		allocator.FreeBatch(ptrs, count);
+	}
+	else
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			FreeBlock(allocator, ptrs[i], size);
+		}
+	}
+}
+
+// Resizes the block of oldSize bytes, the fallback is Allocate + memcpy + Free, so the caller must know oldSize
+template<typename TAllocator>
+inline void* ReallocateBlock(TAllocator& allocator, void* ptr, size_t oldSize, size_t newSize, size_t alignment = 8)
+{
+	if constexpr (HasReallocate<TAllocator>::value)
+	{
+		return ptr ? allocator.Reallocate(ptr, newSize) : allocator.Allocate(newSize, alignment);
+	}
+	else
+	{
+		void* newPtr = allocator.Allocate(newSize, alignment);
+		if (newPtr && ptr)
+		{
+			memcpy(newPtr, ptr, oldSize < newSize ? oldSize : newSize);
+			if (alignment <= 8)
+			{
+				FreeBlock(allocator, ptr, oldSize);
+			}
+			else
+			{
+				allocator.Free(ptr);
+			}
+		}
+		return newPtr;
+	}
+}
+
@@ -30,7 +30,7 @@ namespace  AntonShatalov
 	{
 		if constexpr (sizeof(T) > 4)
 		{
-#ifdef _WIN64
+#if defined(_WIN64) || defined(__LP64__)
 			unsigned long index;
 			if (_BitScanReverse64(&index, (uint64)value))
 			{
@@ -110,8 +110,8 @@ namespace  AntonShatalov
 	template <bool X64_BIT, int MAX_LEVEL> class TPoolTree
 	{
 	private:
-		template <bool X64_BIT_BRANCH> struct FHelper;
-		template <> struct FHelper<true>
+		template <bool X64_BIT_BRANCH, typename Dummy = void> struct FHelper;
+		template <typename Dummy> struct FHelper<true, Dummy>
 		{
 			typedef uint64 NodeType;
 
@@ -120,7 +120,7 @@ namespace  AntonShatalov
 				return _BitScanForward64(index, mask);
 			}
 		};
-		template <> struct FHelper<false>
+		template <typename Dummy> struct FHelper<false, Dummy>
 		{
 			typedef uint32 NodeType;
 
@@ -277,11 +277,71 @@ namespace  AntonShatalov
 			--m_curCount;
 		}
 
-		inline bool contains(uint8* ptr) const
+		//takes the free allocations of a whole leaf node in one descent, up to count of them, and goes on to the next node
+		inline uint32 allocBatch(uint8** out, uint32 count)
+		{
+			if (!valid())
+				return 0;
+
+			uint32 done = 0;
+			while (done < count)
+			{
+				uint32 offset = 0;
+				NodeType bits = 0;
+				if (consumeNode<0>(offset, bits, count - done) == EConsume::Fail)
+					break;
+
+				offset <<= NODE_CAPACITY_BIT;
+				unsigned long subIndex;
+				while (bitScanForward(&subIndex, bits) > 0)
+				{
+					bits &= bits - 1;
+					out[done++] = m_memory + ((size_t)(offset | subIndex) << m_ptrDeviserBit);
+				}
+			}
+
+			m_curCount += done;
+			return done;
+		}
+
+		//the neighbours of one leaf node are given back together, only the first of them can make the node non full
+		inline void deallocBatch(uint8* const* ptrs, uint32 count)
+		{
+			for (uint32 i = 0; i < count;)
+			{
+#ifdef ENABLE_DEBUG
+				if (!contains(ptrs[i]))
+					__debugbreak();
+#endif
+
+				uint32 offset = (uint32)((ptrs[i] - m_memory) >> m_ptrDeviserBit);
+				uint32 node = offset >> NODE_CAPACITY_BIT;
+				giveBack<0>(offset);
+
+				NodeType bits = 0;
+				for (++i; i < count; ++i)
+				{
+					offset = (uint32)((ptrs[i] - m_memory) >> m_ptrDeviserBit);
+					if ((offset >> NODE_CAPACITY_BIT) != node)
+						break;
+					bits |= (NodeType)1 << (offset & (NODE_CAPACITY - 1));
+				}
+				m_tree[m_levels[MAX_LEVEL] + node] |= bits;
+			}
+			m_curCount -= count;
+		}
+
+		inline bool contains(const uint8* ptr) const
 		{
 			return ptr >= m_memory && ptr <= m_lastBite;
 		}
 
+		//the leaf nodes keep a set bit for every free allocation
+		inline bool isFree(uint32 offset) const
+		{
+			return ((m_tree[m_levels[MAX_LEVEL] + (offset >> NODE_CAPACITY_BIT)] >> (offset & (NODE_CAPACITY - 1))) & 1) != 0;
+		}
+
 		inline uint8* getFirstBite() const
 		{
 			return m_memory;
@@ -423,6 +483,63 @@ namespace  AntonShatalov
 			}
 		}
 
+		//like consume, but the leaf node gives up to count allocations as bits and offset ends up being the node index
+		template<int CALL_LEVEL> inline EConsume consumeNode(uint32& offset, NodeType& bits, uint32 count)
+		{
+			unsigned long subIndex;
+
+			uint32 num = m_levels[CALL_LEVEL] + offset;
+#ifdef ENABLE_DEBUG
+			if (num < m_levels[CALL_LEVEL] || num >= m_levels[CALL_LEVEL + 1])
+				__debugbreak();
+#endif
+
+			NodeType node = m_tree[num];
+
+			if constexpr (CALL_LEVEL < MAX_LEVEL)
+			{
+				if (bitScanForward(&subIndex, node) == 0)
+					return EConsume::Fail;
+
+				offset = (offset << NODE_CAPACITY_BIT) | subIndex;
+				EConsume result = consumeNode<CALL_LEVEL + 1>(offset, bits, count);
+
+				if (result == EConsume::Full)
+				{
+					node &= ~(1llu << subIndex);
+					m_tree[num] = node;
+
+					return node == 0 ? EConsume::Full : EConsume::Ok;
+				}
+				else
+				{
+					return result;
+				}
+			}
+			else
+			{
+				if (node == 0)
+					return EConsume::Fail;
+
+				//the whole node in one go, or its count lowest allocations
+				NodeType rest = 0;
+				if (count < NODE_CAPACITY)
+				{
+					rest = node;
+					for (uint32 i = 0; i < count && rest; ++i)
+						rest &= rest - 1;
+				}
+				bits = node & ~rest;
+				m_tree[num] = rest;
+
+				//the cached node may be this one, it must not give the taken allocations again
+				m_cachedNodeValue = rest;
+				m_cachedNodeNum = num;
+
+				return rest == 0 ? EConsume::Full : EConsume::Ok;
+			}
+		}
+
 		template<int CALL_LEVEL> inline EGiveBack giveBack(const uint32& offset)
 		{
 			if constexpr (CALL_LEVEL < MAX_LEVEL)
@@ -583,12 +700,12 @@ namespace  AntonShatalov
 
 		static const size_t POOL_FORCE_CLEAR_LIMIT = 8 << (10 + 10); //8 Mb
 
-		template <bool WIDE_RANGE> struct FHelper;
-		template <> struct FHelper<true>
+		template <bool WIDE_RANGE, typename Dummy = void> struct FHelper;
+		template <typename Dummy> struct FHelper<true, Dummy>
 		{
 			typedef int64 LookUpIndexType;
 		};
-		template <> struct FHelper<false>
+		template <typename Dummy> struct FHelper<false, Dummy>
 		{
 			typedef int LookUpIndexType;
 		};
@@ -813,6 +930,85 @@ namespace  AntonShatalov
 			}
 		}
 
+		//true for the allocations of the pools, the direct mallocs are not known
+		inline bool owns(const uint8* ptr) const
+		{
+			return findPool(ptr) != uint32_max;
+		}
+
+		//fills out from the pools of the size a leaf node at a time, alloc goes on to the next pool when one is full
+		uint32 allocBatch(size_t size, size_t alignment, uint8** out, uint32 count)
+		{
+			int sizedIndex = max((int)logOfTwoCeil(size) - MIN_ALLOC_SIZE_BIT, 0);
+			FSized& sized = m_sizeds[sizedIndex];
+
+			uint32 done = 0;
+			while (done < count)
+			{
+				if (sized.lastPool != uint32_max)
+				{
+					FInnerPool& pool = m_pools[sized.lastPool];
+					uint32 allocated = pool.allocBatch(out + done, count - done);
+#ifdef ENABLE_MEMORY_TRACKING
+					for (uint32 i = done; i < done + allocated; ++i)
+						pool.registerPointer(out[i], size);
+#endif
+					done += allocated;
+					if (done == count)
+						break;
+				}
+
+				uint8* ptr = alloc(size, alignment);
+				if (!ptr)
+					break;
+				out[done++] = ptr;
+			}
+
+			return done;
+		}
+
+		//a run of allocations of one pool is looked up once, its last one goes through dealloc for the pool bookkeeping
+		inline void deallocBatch(uint8* const* ptrs, uint32 count)
+		{
+			for (uint32 i = 0; i < count;)
+			{
+				uint32 last = i + 1;
+				uint32 poolNum = findPool(ptrs[i]);
+				if (poolNum != uint32_max)
+				{
+					FInnerPool& pool = m_pools[poolNum];
+					while (last < count && pool.contains(ptrs[last]))
+						++last;
+
+					pool.deallocBatch(ptrs + i, last - 1 - i);
+#ifdef ENABLE_MEMORY_TRACKING
+					for (uint32 j = i; j < last - 1; ++j)
+						pool.unregisterPointer(ptrs[j]);
+#endif
+				}
+
+				dealloc(ptrs[last - 1]);
+				i = last;
+			}
+		}
+
+		//every valid pool is a region of allocations of its size, the direct mallocs are not visited
+		template <typename TVisitor> inline void walk(TVisitor& visitor) const
+		{
+			for (size_t i = 0; i < m_pools.size(); ++i)
+			{
+				const FInnerPool& pool = m_pools[i];
+				if (!pool.valid())
+					continue;
+
+				visitor.Region(pool.getFirstBite(), pool.getMemorySize());
+
+				const size_t allocSize = (size_t)1 << pool.getPtrDiviserBit();
+				for (uint32 j = 0; j < pool.getMaximalAllocsCount(); ++j)
+					visitor.Block(pool.getFirstBite() + ((size_t)j << pool.getPtrDiviserBit()), allocSize, pool.isFree(j));
+			}
+		}
+
 		inline void debugOutput() const
 		{
 #ifdef ENABLE_OUTPUT
@@ -910,6 +1106,23 @@ namespace  AntonShatalov
 		std::vector<FInnerPool> m_pools;
 		std::vector<FSized> m_sizeds;
 
+		//the pool holding the allocation, uint32_max for the direct mallocs
+		inline uint32 findPool(const uint8* ptr) const
+		{
+			LookUpIndexType index = (LookUpIndexType)(((size_t)ptr >> MINIMAL_POOL_SIZE_BIT) << 1);
+			if (index < m_lookUpFirst || index > m_lookUpLast)
+				return uint32_max;
+			index -= m_lookUpFirst;
+
+			for (uint32 i = 0; i < 2; ++i)
+			{
+				uint32 poolNum = m_lookUp[index + i];
+				if (poolNum != uint32_max && m_pools[poolNum].contains(ptr))
+					return poolNum;
+			}
+			return uint32_max;
+		}
+
 		inline void registerPool(uint32 poolNum, LookUpIndexType minIndex, LookUpIndexType maxIndex)
 		{
 			for (LookUpIndexType i = minIndex; i <= maxIndex; i += 2)
@@ -985,6 +1198,22 @@ namespace  AntonShatalov
 			m_multiPoolTree.dealloc((uint8*)ptr);
 		}
 
+		size_t AllocateBatch(size_t size, size_t count, void** out)
+		{
+			return m_multiPoolTree.allocBatch(size, 8, (uint8**)out, (uint32)count);
+		}
+
+		inline void FreeBatch(void** ptrs, size_t count)
+		{
+			m_multiPoolTree.deallocBatch((uint8* const*)ptrs, (uint32)count);
+		}
+
+		//the blocks above the largest pool size go to malloc and are not owned
+		inline bool Owns(const void* ptr) const
+		{
+			return m_multiPoolTree.owns((const uint8*)ptr);
+		}
+
 		inline size_t GetOccupiedSpace() const
 		{
 			return 0;
@@ -995,8 +1224,13 @@ namespace  AntonShatalov
 			m_multiPoolTree.debugOutput();
 		}
 
+		template <typename TVisitor> inline void WalkHeap(TVisitor& visitor) const
+		{
+			m_multiPoolTree.walk(visitor);
+		}
+
 	private:
-#ifdef _WIN64
+#if defined(_WIN64) || defined(__LP64__)
 		static const bool WIN64_BIT = true;
 #else
 		static const bool WIN64_BIT = false;
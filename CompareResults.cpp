@@ -0,0 +1,384 @@
+// Compares two results.csv files written by MemoryAllocatorContest and flags statistically significant regressions.
+//
+//     g++ -std=c++17 -O2 CompareResults.cpp -o CompareResults
+//     ./CompareResults baseline.csv new.csv [threshold percent, 5 by default]
+//
+// Time, memory overhead and score of every allocator, size and test are compared point by point (allocated size),
+// a cell is the geometric mean of the new / old ratios of its points and is significant if the one-sample t-test
+// of the log ratios rejects "no change" at 95%. Several rows of the same point (e.g. the files of several runs
+// concatenated) are averaged first. A cell with a single point is tested with Welch's t-test on those rows if there are
+// several, otherwise its time is tested on the exported repetitions: the median time of a repetition with its 95% CI,
+// the CI gives the standard error of the median. The overhead and the score of a single point can't be tested.
+// A regression is a significant change to the worse by more than the threshold, the exit code is 1 if there are any.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+struct Metric
+{
+	const char* m_name;
+	bool m_bHigherIsBetter;
+	// added to both values before the ratio, so the points near zero don't produce infinite ratios
+	double m_floor;
+};
+
+static const Metric METRICS[] = { { "time_ms", false, 1.0 }, { "overhead_mb", false, 1.0 }, { "score", true, 0.01 } };
+static const int METRICS_COUNT = sizeof(METRICS) / sizeof(METRICS[0]);
+static const int TIME_METRIC = 0;
+
+// The columns of a row after the metrics, the repetitions of the time
+static const char* REPETITION_COLUMNS[] = { "repetitions", "median_ms", "ci_low_ms", "ci_high_ms" };
+enum ERepetitionColumn
+{
+	RepetitionsCount = METRICS_COUNT,
+	RepetitionsMedian,
+	RepetitionsLow,
+	RepetitionsHigh,
+	ColumnsCount
+};
+
+// allocated size -> rows of the metrics and the repetition columns
+typedef std::map<size_t, std::vector<std::vector<double>>> CellPoints;
+
+struct RunFile
+{
+	std::vector<std::pair<std::string, std::string>> m_environment;
+	// "allocator / size / test" -> points
+	std::map<std::string, CellPoints> m_cells;
+};
+
+static std::vector<std::string> SplitCsvLine(const std::string& line)
+{
+	std::vector<std::string> fields(1);
+	bool bQuoted = false;
+	for (size_t i = 0; i < line.size(); i++)
+	{
+		const char c = line[i];
+		if (bQuoted)
+		{
+			if (c == '"' && i + 1 < line.size() && line[i + 1] == '"')
+			{
+				fields.back() += '"';
+				i++;
+			}
+			else if (c == '"')
+			{
+				bQuoted = false;
+			}
+			else
+			{
+				fields.back() += c;
+			}
+		}
+		else if (c == '"')
+		{
+			bQuoted = true;
+		}
+		else if (c == ',')
+		{
+			fields.emplace_back();
+		}
+		else if (c != '\r')
+		{
+			fields.back() += c;
+		}
+	}
+	return fields;
+}
+
+static bool ReadRunFile(const char* path, RunFile& run)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		return false;
+	}
+
+	std::vector<std::string> header;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.empty())
+		{
+			continue;
+		}
+
+		if (line[0] == '#')
+		{
+			const size_t colon = line.find(':');
+			if (colon != std::string::npos)
+			{
+				const size_t valueStart = line.find_first_not_of(' ', colon + 1);
+				run.m_environment.emplace_back(line.substr(2, colon - 2), valueStart == std::string::npos ? "" : line.substr(valueStart));
+			}
+			continue;
+		}
+
+		std::vector<std::string> fields = SplitCsvLine(line);
+		if (header.empty())
+		{
+			header = fields;
+			continue;
+		}
+
+		std::map<std::string, std::string> row;
+		for (size_t i = 0; i < header.size() && i < fields.size(); i++)
+		{
+			row[header[i]] = fields[i];
+		}
+
+		std::vector<double> values(ColumnsCount);
+		for (int i = 0; i < METRICS_COUNT; i++)
+		{
+			values[i] = atof(row[METRICS[i].m_name].c_str());
+		}
+		for (int i = METRICS_COUNT; i < ColumnsCount; i++)
+		{
+			values[i] = atof(row[REPETITION_COLUMNS[i - METRICS_COUNT]].c_str());
+		}
+
+		const std::string cell = row["allocator"] + " / " + row["size"] + " / " + row["test"];
+		run.m_cells[cell][(size_t)strtoull(row["allocated_bytes"].c_str(), nullptr, 10)].push_back(values);
+	}
+
+	return !header.empty();
+}
+
+// Two-sided 95% critical value of Student's t
+static double GetCriticalT(double degreesOfFreedom)
+{
+	static const double table[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+		2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+		2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+
+	if (degreesOfFreedom < 1.0)
+	{
+		return INFINITY;
+	}
+	const size_t index = (size_t)degreesOfFreedom;
+	return index <= 30 ? table[index - 1] : 1.96;
+}
+
+static void GetMeanVariance(const std::vector<double>& values, double& mean, double& variance)
+{
+	mean = 0.0;
+	for (double value : values)
+	{
+		mean += value;
+	}
+	mean /= (double)values.size();
+
+	variance = 0.0;
+	for (double value : values)
+	{
+		variance += (value - mean) * (value - mean);
+	}
+	variance = values.size() > 1 ? variance / (double)(values.size() - 1) : 0.0;
+}
+
+struct Comparison
+{
+	double m_old = 0.0;
+	double m_new = 0.0;
+	double m_ratio = 1.0;
+	bool m_bTestable = false;
+	bool m_bSignificant = false;
+};
+
+static Comparison Compare(const CellPoints& oldPoints, const CellPoints& newPoints, int metric)
+{
+	const double floor = METRICS[metric].m_floor;
+
+	std::vector<double> logRatios;
+	std::vector<double> oldLogs;
+	std::vector<double> newLogs;
+	// the row of the last point if it has only one on both sides
+	const std::vector<double>* oldRow = nullptr;
+	const std::vector<double>* newRow = nullptr;
+
+	Comparison comparison;
+	for (auto& it : oldPoints)
+	{
+		auto newIt = newPoints.find(it.first);
+		if (newIt == newPoints.end())
+		{
+			continue;
+		}
+
+		double oldMean = 0.0;
+		oldLogs.clear();
+		for (const std::vector<double>& values : it.second)
+		{
+			oldMean += values[metric] / (double)it.second.size();
+			oldLogs.push_back(log(values[metric] + floor));
+		}
+
+		double newMean = 0.0;
+		newLogs.clear();
+		for (const std::vector<double>& values : newIt->second)
+		{
+			newMean += values[metric] / (double)newIt->second.size();
+			newLogs.push_back(log(values[metric] + floor));
+		}
+
+		comparison.m_old += oldMean;
+		comparison.m_new += newMean;
+		logRatios.push_back(log((newMean + floor) / (oldMean + floor)));
+		oldRow = it.second.size() == 1 ? &it.second[0] : nullptr;
+		newRow = newIt->second.size() == 1 ? &newIt->second[0] : nullptr;
+	}
+
+	if (logRatios.empty())
+	{
+		return comparison;
+	}
+
+	double mean = 0.0;
+	double variance = 0.0;
+	GetMeanVariance(logRatios, mean, variance);
+	comparison.m_ratio = exp(mean);
+
+	if (logRatios.size() > 1)
+	{
+		comparison.m_bTestable = true;
+		comparison.m_bSignificant = variance == 0.0 ? mean != 0.0 :
+			fabs(mean) / sqrt(variance / (double)logRatios.size()) > GetCriticalT((double)logRatios.size() - 1.0);
+	}
+	else if (oldLogs.size() > 1 && newLogs.size() > 1)
+	{
+		double oldMean = 0.0;
+		double oldVariance = 0.0;
+		double newMean = 0.0;
+		double newVariance = 0.0;
+		GetMeanVariance(oldLogs, oldMean, oldVariance);
+		GetMeanVariance(newLogs, newMean, newVariance);
+
+		const double oldError = oldVariance / (double)oldLogs.size();
+		const double newError = newVariance / (double)newLogs.size();
+		const double error = oldError + newError;
+
+		comparison.m_bTestable = true;
+		if (error == 0.0)
+		{
+			comparison.m_bSignificant = newMean != oldMean;
+		}
+		else
+		{
+			// Welch-Satterthwaite degrees of freedom
+			const double degreesOfFreedom = error * error /
+				(oldError * oldError / (double)(oldLogs.size() - 1) + newError * newError / (double)(newLogs.size() - 1));
+			comparison.m_bSignificant = fabs(newMean - oldMean) / sqrt(error) > GetCriticalT(degreesOfFreedom);
+		}
+	}
+	else if (metric == TIME_METRIC && oldRow && newRow && (*oldRow)[RepetitionsCount] > 1.0 && (*newRow)[RepetitionsCount] > 1.0 &&
+		(*oldRow)[RepetitionsLow] > 0.0 && (*newRow)[RepetitionsLow] > 0.0)
+	{
+		// the medians are compared instead of the totals, the short tests have few whole milliseconds
+		const double oldLog = log((*oldRow)[RepetitionsMedian]);
+		const double newLog = log((*newRow)[RepetitionsMedian]);
+		// the 95% CI of a log median is about 2 x 1.96 standard errors wide
+		const double oldError = (log((*oldRow)[RepetitionsHigh]) - log((*oldRow)[RepetitionsLow])) / (2.0 * 1.96);
+		const double newError = (log((*newRow)[RepetitionsHigh]) - log((*newRow)[RepetitionsLow])) / (2.0 * 1.96);
+		const double error = sqrt(oldError * oldError + newError * newError);
+
+		comparison.m_old = (*oldRow)[RepetitionsMedian];
+		comparison.m_new = (*newRow)[RepetitionsMedian];
+		comparison.m_ratio = exp(newLog - oldLog);
+		comparison.m_bTestable = true;
+		comparison.m_bSignificant = error == 0.0 ? newLog != oldLog : fabs(newLog - oldLog) / error > 1.96;
+	}
+
+	return comparison;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		printf("Usage: %s baseline.csv new.csv [threshold percent]\n", argv[0]);
+		return 2;
+	}
+
+	const double threshold = argc > 3 ? atof(argv[3]) * 0.01 : 0.05;
+
+	RunFile oldRun;
+	RunFile newRun;
+	if (!ReadRunFile(argv[1], oldRun) || !ReadRunFile(argv[2], newRun))
+	{
+		printf("Can't read %s\n", oldRun.m_cells.empty() ? argv[1] : argv[2]);
+		return 2;
+	}
+
+	printf("%-16s %-40s %s\n", "", "baseline", "new");
+	for (auto& it : newRun.m_environment)
+	{
+		std::string oldValue;
+		for (auto& oldIt : oldRun.m_environment)
+		{
+			oldValue = oldIt.first == it.first ? oldIt.second : oldValue;
+		}
+		printf("%-16s %-40s %s\n", it.first.c_str(), oldValue.substr(0, 39).c_str(), it.second.c_str());
+	}
+	printf("\n");
+
+	size_t regressions = 0;
+	size_t improvements = 0;
+
+	for (auto& it : newRun.m_cells)
+	{
+		auto oldIt = oldRun.m_cells.find(it.first);
+		if (oldIt == oldRun.m_cells.end())
+		{
+			printf("%s: new\n", it.first.c_str());
+			continue;
+		}
+
+		for (int metric = 0; metric < METRICS_COUNT; metric++)
+		{
+			const Comparison comparison = Compare(oldIt->second, it.second, metric);
+			const double change = comparison.m_ratio - 1.0;
+			const bool bWorse = METRICS[metric].m_bHigherIsBetter ? change < -threshold : change > threshold;
+			const bool bBetter = METRICS[metric].m_bHigherIsBetter ? change > threshold : change < -threshold;
+
+			const char* verdict = "";
+			if (!comparison.m_bTestable)
+			{
+				verdict = bWorse || bBetter ? "not enough points" : "";
+			}
+			else if (comparison.m_bSignificant && bWorse)
+			{
+				verdict = "REGRESSION";
+				regressions++;
+			}
+			else if (comparison.m_bSignificant && bBetter)
+			{
+				verdict = "improvement";
+				improvements++;
+			}
+			else if (bWorse || bBetter)
+			{
+				verdict = "noise";
+			}
+
+			printf("%-60s %-12s %12.2f -> %12.2f  %+7.1f%%  %s\n", it.first.c_str(), METRICS[metric].m_name,
+				comparison.m_old, comparison.m_new, change * 100.0, verdict);
+		}
+	}
+
+	for (auto& it : oldRun.m_cells)
+	{
+		if (newRun.m_cells.find(it.first) == newRun.m_cells.end())
+		{
+			printf("%s: missing\n", it.first.c_str());
+		}
+	}
+
+	printf("\n%zu regressions, %zu improvements above %.1f%%\n", regressions, improvements, threshold * 100.0);
+	return regressions ? 1 : 0;
+}
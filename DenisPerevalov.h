@@ -1,6 +1,7 @@
 #include <iostream>
 #include <iomanip>
 #include <deque>
+#include <cstring>
 
 /* OneshotLocator, Denis Perevalov
      ,         .
@@ -45,8 +46,10 @@ namespace  DenisPerevalov
 
 	struct Item {
 		Page *page;
-		static void setup(Item* it, Page *page) {
+		uint64 size;	//bytes of the block, Reallocate copies them
+		static void setup(Item* it, Page *page, uint64 size) {
 			it->page = page;
+			it->size = size;
 		}
 	};
 	
@@ -57,6 +60,7 @@ namespace  DenisPerevalov
 
 		uint64 FreeSize = 0;
 		uint8* RecPos = nullptr;
+		uint8* LastData = nullptr;	//the last allocated block, it can grow in place
 
 		static Page* create_page(uint64 size, uint8 table_index) {
 			size += sizeof(Item);		//Increase to be able to keep at least one item
@@ -85,14 +89,29 @@ namespace  DenisPerevalov
 
 		void* alloc(size_t size) {		// You must check can_alloc() before calling this
 			Item *it = (Item*)RecPos;
-			Item::setup(it, this);
+			Item::setup(it, this, size);
 			uint8* data = RecPos + sizeof(Item);
+			LastData = data;
 			RecPos += size + sizeof(Item);
 			FreeSize -= size + sizeof(Item);
 			counter++;
 			return data;
 		}
 
+		bool resize_last(uint8* data, size_t size) {	//moves the end of the last block, false if the page is out of space
+			if (data != LastData) {
+				return false;
+			}
+			uint64 current = RecPos - data;
+			if (size > current && size - current > FreeSize) {
+				return false;
+			}
+			FreeSize = FreeSize + current - size;
+			RecPos = data + size;
+			((Item*)data - 1)->size = size;
+			return true;
+		}
+
 		bool free_one_item() {	//delete one element, returns true if need delete the page
 			counter--;
 			return (counter <= 0);
@@ -150,6 +169,26 @@ namespace  DenisPerevalov
 			}
 		}
 
+		// The last block of a page grows and shrinks in place, the pages which are not current get no more allocations
+		void* Reallocate(void* ptr, size_t newSize) {
+			if (!ptr) {
+				return Allocate(newSize, 0);
+			}
+			Item* it = (Item*)ptr - 1;
+			Page* page = it->page;
+			if (page->resize_last((uint8*)ptr, newSize)) {
+				return ptr;
+			}
+			//taken before Allocate, the new block can land on the same page
+			uint64 oldSize = it->size;
+			void* data = Allocate(newSize, 0);
+			if (data) {
+				memcpy(data, ptr, (newSize < oldSize) ? newSize : oldSize);
+				Free(ptr);
+			}
+			return data;
+		}
+
 	private:
 		// Pages
 		Page *FreePages[maxn];		//heads of the pages lists (though we don't maintaining list structure for now)
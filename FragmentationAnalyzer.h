@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Harness.h"
+
+// Visitor of WalkHeap (AllocatorTraits.h) filling FragmentationStats:
+//     internal fragmentation: the bytes of the allocated blocks beyond the sizes requested for them;
+//     external fragmentation: 1 - largest free block / free bytes, 0 when the free memory is a single block;
+//     metadata: what's left of the regions, headers and alignment gaps.
+// The allocated blocks are matched against the pointers the test holds with their requested sizes.
+// Every region gets a heap map of MAP_WIDTH cells, each one covering an equal part of the region:
+//     '#' allocated, '.' free, '+' both, ' ' neither (headers, padding).
+class FragmentationAnalyzer
+{
+public:
+	static const size_t MAP_WIDTH = 64;
+
+	FragmentationAnalyzer(const std::unordered_map<const void*, size_t>& requested, FragmentationStats& stats)
+		: m_requested(requested)
+		, m_stats(stats)
+	{
+	}
+
+	~FragmentationAnalyzer()
+	{
+		FinishRegion();
+	}
+
+	void Region(const void* begin, size_t size)
+	{
+		FinishRegion();
+
+		m_stats.m_regions++;
+		m_stats.m_regionBytes += size;
+		m_regionBegin = (uintptr_t)begin;
+		m_regionSize = size;
+		m_allocatedCells.assign(MAP_WIDTH, 0);
+		m_freeCells.assign(MAP_WIDTH, 0);
+	}
+
+	void Block(const void* ptr, size_t size, bool bFree)
+	{
+		if (bFree)
+		{
+			m_stats.m_freeBlocks++;
+			m_stats.m_freeBytes += size;
+			m_stats.m_largestFreeBlock = (std::max)(m_stats.m_largestFreeBlock, size);
+		}
+		else
+		{
+			auto it = m_requested.find(ptr);
+			if (it != m_requested.end())
+			{
+				m_stats.m_allocatedBlocks++;
+				m_stats.m_allocatedBytes += size;
+				m_stats.m_requestedBytes += (std::min)(it->second, size);
+			}
+			else
+			{
+				m_stats.m_untrackedBytes += size;
+			}
+		}
+
+		Mark((uintptr_t)ptr, size, bFree ? m_freeCells : m_allocatedCells);
+	}
+
+private:
+	// Adds the part of the block within every cell of the region
+	void Mark(uintptr_t ptr, size_t size, std::vector<size_t>& cells)
+	{
+		if (m_regionSize == 0 || ptr < m_regionBegin || ptr >= m_regionBegin + m_regionSize)
+		{
+			return;
+		}
+
+		const size_t begin = ptr - m_regionBegin;
+		const size_t end = (std::min)(begin + size, m_regionSize);
+		for (size_t cell = begin * MAP_WIDTH / m_regionSize; cell < MAP_WIDTH; cell++)
+		{
+			const size_t cellBegin = cell * m_regionSize / MAP_WIDTH;
+			const size_t cellEnd = (cell + 1) * m_regionSize / MAP_WIDTH;
+			if (cellBegin >= end)
+			{
+				break;
+			}
+			cells[cell] += (std::min)(end, cellEnd) - (std::max)(begin, cellBegin);
+		}
+	}
+
+	void FinishRegion()
+	{
+		if (m_regionSize == 0)
+		{
+			return;
+		}
+
+		std::string map;
+		for (size_t cell = 0; cell < MAP_WIDTH; cell++)
+		{
+			const size_t allocated = m_allocatedCells[cell];
+			const size_t free = m_freeCells[cell];
+			const size_t covered = allocated + free;
+			if (covered == 0)
+			{
+				map += ' ';
+			}
+			else
+			{
+				map += allocated * 4 >= covered * 3 ? '#' : (free * 4 >= covered * 3 ? '.' : '+');
+			}
+		}
+
+		char buffer[64];
+		snprintf(buffer, sizeof(buffer), "%#014llx %10.3fmb |", (unsigned long long)m_regionBegin, (double)m_regionSize / 1048576.0);
+		m_stats.m_heapMaps.push_back(buffer + map + "|");
+		m_regionSize = 0;
+	}
+
+	const std::unordered_map<const void*, size_t>& m_requested;
+	FragmentationStats& m_stats;
+
+	uintptr_t m_regionBegin = 0;
+	size_t m_regionSize = 0;
+	std::vector<size_t> m_allocatedCells;
+	std::vector<size_t> m_freeCells;
+};
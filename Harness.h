@@ -0,0 +1,269 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "Platform.h"
+#include "LatencyHistogram.h"
+#include "MemoryTimeline.h"
+
+// Common pieces of the contest harness shared by all test cases.
+
+struct Timer
+{
+	int64_t m_counterStart = 0;
+	int64_t m_counterEnd = 0;
+	int64_t m_counterAcc = 0;
+	double m_pcFrequence = 0.0;
+	// Hardware counters counting only while the timer runs, optional
+	Platform::PerfCounterGroup* m_counters = nullptr;
+
+	void Start()
+	{
+		if (m_counters)
+		{
+			m_counters->Enable();
+		}
+		m_pcFrequence = double(Platform::QueryTimerFrequency()) / 1000.0;
+		m_counterStart = Platform::QueryTimerCounter();
+	}
+
+	void Stop()
+	{
+		m_counterEnd = Platform::QueryTimerCounter();
+		m_counterAcc += m_counterEnd - m_counterStart;
+		if (m_counters)
+		{
+			m_counters->Disable();
+		}
+	}
+
+	// Stops at a counter taken earlier with Platform::QueryTimerCounter, e.g. by the last of the worker threads to finish
+	void StopAt(int64_t counterEnd)
+	{
+		m_counterEnd = counterEnd;
+		m_counterAcc += m_counterEnd - m_counterStart;
+		if (m_counters)
+		{
+			m_counters->Disable();
+		}
+	}
+
+	int64_t ResultMs() const
+	{
+		return int64_t(double(m_counterEnd - m_counterStart) / m_pcFrequence);
+	}
+
+	// Time accumulated since the accumulator had the given value, to measure a single run of a repeated test
+	double ResultAccumulatedMsSince(int64_t counterAcc) const
+	{
+		if (m_pcFrequence == 0.0)
+		{
+			return 0.0;
+		}
+		return (double)(m_counterAcc - counterAcc) / m_pcFrequence;
+	}
+
+	int64_t ResultAccumulatedMs() const
+	{
+		if (m_pcFrequence == 0.0)
+		{
+			return 0;
+		}
+		return int64_t((double)m_counterAcc / m_pcFrequence);
+	}
+
+	double ResultAccumulatedSec() const
+	{
+		if (m_pcFrequence == 0.0)
+		{
+			return 0.0;
+		}
+		return (double)m_counterAcc / m_pcFrequence * 0.001;
+	}
+
+	void Clear()
+	{
+		m_counterStart = 0;
+		m_counterEnd = 0;
+		m_counterAcc = 0;
+		m_pcFrequence = 0.0;
+	}
+};
+
+inline size_t GetTotalUsedVirtualMemory()
+{
+	return Platform::GetCommittedMemory();
+}
+
+typedef std::unordered_map<std::string, std::unordered_map<size_t, std::pair<size_t, float>>> TestResult;
+
+// Median of the repetitions of a measurement with its distribution-free 95% confidence interval:
+// the order statistics around the median that the binomial(n, 1/2) distribution covers with 95% probability.
+// Below 6 samples the interval can't reach 95% and is the whole range.
+struct SampleStatistics
+{
+	double m_median = 0.0;
+	double m_low = 0.0;
+	double m_high = 0.0;
+	size_t m_count = 0;
+
+	static SampleStatistics Compute(std::vector<double> samples)
+	{
+		SampleStatistics statistics;
+		statistics.m_count = samples.size();
+		if (samples.empty())
+		{
+			return statistics;
+		}
+
+		std::sort(samples.begin(), samples.end());
+
+		const size_t n = samples.size();
+		statistics.m_median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) * 0.5;
+
+		const double low = std::floor((double)n * 0.5 - 1.96 * std::sqrt((double)n) * 0.5);
+		const size_t lowIndex = low < 0.0 ? 0 : (size_t)low;
+		statistics.m_low = samples[lowIndex];
+		statistics.m_high = samples[n - 1 - lowIndex];
+		return statistics;
+	}
+};
+
+// test -> allocated size -> time of a single repetition in ms
+typedef std::unordered_map<std::string, std::unordered_map<size_t, SampleStatistics>> TestStatistics;
+
+// Score of a single test: the faster and the less overhead the better, step is the allocations count step 1..5
+inline float CalculateScore(float ms, float memoryOverhead, float step, float allocationSize)
+{
+	return (float)(((1500.0 * (step / 5.0)) / ms) * (allocationSize / (allocationSize + memoryOverhead)));
+}
+
+// Hardware counters summed over the timed regions of a test and the Allocate + Free calls they cover
+struct PerfCounterStats
+{
+	uint64_t m_values[Platform::PerfCountersCount] = {};
+	bool m_bAvailable[Platform::PerfCountersCount] = {};
+	uint64_t m_operations = 0;
+
+	void Add(const Platform::PerfCounterGroup& counters, uint64_t operations)
+	{
+		uint64_t values[Platform::PerfCountersCount];
+		if (!counters.Read(values))
+		{
+			return;
+		}
+
+		for (int i = 0; i < Platform::PerfCountersCount; i++)
+		{
+			m_values[i] += values[i];
+			m_bAvailable[i] = m_bAvailable[i] || counters.HasCounter(i);
+		}
+		m_operations += operations;
+	}
+
+	double GetPerOperation(int counter) const
+	{
+		return m_operations ? (double)m_values[counter] / (double)m_operations : 0.0;
+	}
+};
+
+// Thread scaling measurement for a single threads count
+struct ScalingPoint
+{
+	size_t m_threads = 0;
+	int64_t m_ms = 0;
+	double m_opsPerSec = 0.0;
+	double m_efficiency = 0.0;
+	float m_peakMemoryMb = 0.0f;
+};
+
+// "pattern/mode" -> points sorted by threads count
+typedef std::unordered_map<std::string, std::vector<ScalingPoint>> ScalingResult;
+
+// Heap state of an allocator walked by FragmentationAnalyzer
+struct FragmentationStats
+{
+	size_t m_regions = 0;
+	size_t m_regionBytes = 0;
+	// blocks of the pointers the test holds and the bytes it asked for them
+	size_t m_allocatedBlocks = 0;
+	size_t m_allocatedBytes = 0;
+	size_t m_requestedBytes = 0;
+	// allocated blocks the test doesn't hold: leaked or lost by the allocator
+	size_t m_untrackedBytes = 0;
+	size_t m_freeBlocks = 0;
+	size_t m_freeBytes = 0;
+	size_t m_largestFreeBlock = 0;
+	// a line per region, see FragmentationAnalyzer
+	std::vector<std::string> m_heapMaps;
+
+	// Share of the allocated blocks wasted by the rounding of the sizes
+	double GetInternal() const
+	{
+		return m_allocatedBytes > m_requestedBytes ? (double)(m_allocatedBytes - m_requestedBytes) / (double)m_allocatedBytes : 0.0;
+	}
+
+	// Share of the free memory that can't serve a request of the size of all of it
+	double GetExternal() const
+	{
+		return m_freeBytes ? 1.0 - (double)m_largestFreeBlock / (double)m_freeBytes : 0.0;
+	}
+
+	// Headers, alignment gaps and the tails of the regions
+	size_t GetMetadataBytes() const
+	{
+		const size_t blocks = m_allocatedBytes + m_untrackedBytes + m_freeBytes;
+		return m_regionBytes > blocks ? m_regionBytes - blocks : 0;
+	}
+};
+
+// A window of steps of TestCase_Churn
+struct ChurnPoint
+{
+	// steps done at the end of the window
+	size_t m_steps = 0;
+	double m_opsPerSec = 0.0;
+	size_t m_liveBytes = 0;
+	// committed memory above the one before the allocator was created
+	size_t m_footprint = 0;
+	// allocations of the window that returned null
+	size_t m_failed = 0;
+
+	size_t GetOverhead() const
+	{
+		return m_footprint > m_liveBytes ? m_footprint - m_liveBytes : 0;
+	}
+};
+
+struct Result
+{
+	Result(std::string allocator) : m_allocator(allocator) {}
+
+	std::string m_allocator;
+	std::unordered_map<std::string, TestResult> m_results;
+	// spread of the repetitions behind every point of m_results, the main tests only
+	std::unordered_map<std::string, TestStatistics> m_statistics;
+	std::unordered_map<std::string, ScalingResult> m_scaling;
+	// size -> test -> per-operation latencies, filled only with ENABLE_LATENCY_HISTOGRAMS
+	std::unordered_map<std::string, std::unordered_map<std::string, LatencyStats>> m_latency;
+	// size -> test -> footprint of every allocations count step, filled only with ENABLE_MEMORY_TIMELINE
+	std::unordered_map<std::string, std::unordered_map<std::string, std::vector<MemoryTimeline>>> m_memory;
+	// size -> test -> hardware counters, filled only with ENABLE_PERF_COUNTERS
+	std::unordered_map<std::string, std::unordered_map<std::string, PerfCounterStats>> m_counters;
+	// size -> heap state after TestCase_Fragmentation, allocators with WalkHeap only
+	std::unordered_map<std::string, FragmentationStats> m_fragmentation;
+	// size -> lifetime -> windows of TestCase_Churn
+	std::unordered_map<std::string, std::unordered_map<std::string, std::vector<ChurnPoint>>> m_churn;
+
+	// cells that failed to run, e.g. the child process of an isolated cell crashed
+	std::vector<std::string> m_errors;
+
+	// totals of TestCase_MemoryPerformance
+	float m_globalScore = 0.0f;
+	float m_globalMemoryOverhead = 0.0f;
+	float m_globalTime = 0.0f;
+};
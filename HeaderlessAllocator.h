@@ -0,0 +1,233 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#include <map>
+#include <unordered_set>
+
+// Small-object allocator without per-block headers, built for the sized Free(ptr, size) (AllocatorTraits.h).
+// The blocks up to MAX_SMALL_SIZE bytes come from size classes of 8 bytes steps: every class carves slabs of SLAB_SIZE
+// bytes into blocks of its size and keeps the freed ones in an intrusive list, so a block costs only its rounding to 8.
+// Free(ptr, size) finds the class from the size and touches nothing but the block.
+// Free(ptr) has to find the slab of the block first, with a lookup in the map of the slabs by address.
+// An alignment above 8 rounds the size up to a multiple of it, up to the slab alignment; such blocks are freed with Free(ptr)
+// since their class doesn't follow from the size. The larger blocks go to malloc, or to posix_memalign/_aligned_malloc
+// for an alignment above the 16 bytes of malloc.
+class HeaderlessAllocator
+{
+public:
+	static const size_t GRANULARITY = 8;
+	static const size_t MAX_SMALL_SIZE = 256;
+	static const size_t CLASSES_COUNT = MAX_SMALL_SIZE / GRANULARITY;
+	static const size_t SLAB_SIZE = 256 * 1024;
+	// the blocks of a slab start at this alignment, so a class of a multiple of an alignment up to it keeps the blocks aligned
+	static const size_t SLAB_ALIGNMENT = 256;
+	// the alignment of malloc, the larger blocks of a larger alignment come from the aligned allocation of the platform
+	static const size_t LARGE_ALIGNMENT = 16;
+
+	HeaderlessAllocator() = default;
+	HeaderlessAllocator(const HeaderlessAllocator&) = delete;
+	HeaderlessAllocator& operator=(const HeaderlessAllocator&) = delete;
+
+	~HeaderlessAllocator()
+	{
+		for (auto& slab : m_slabs)
+		{
+			free(slab.second.m_memory);
+		}
+	}
+
+	void* Allocate(size_t size, size_t alignment)
+	{
+		if (alignment > GRANULARITY && alignment <= SLAB_ALIGNMENT)
+		{
+			size = (size + alignment - 1) & ~(alignment - 1);
+		}
+
+		if (size > MAX_SMALL_SIZE || alignment > SLAB_ALIGNMENT)
+		{
+			return AllocateLarge(size, alignment);
+		}
+
+		SizeClass& sizeClass = m_classes[GetClass(size)];
+		if (FreeBlock* block = sizeClass.m_free)
+		{
+			sizeClass.m_free = block->m_next;
+			return block;
+		}
+
+		if (sizeClass.m_cursor == sizeClass.m_end && !AddSlab(GetClass(size)))
+		{
+			return nullptr;
+		}
+
+		void* ptr = sizeClass.m_cursor;
+		sizeClass.m_cursor += (GetClass(size) + 1) * GRANULARITY;
+		return ptr;
+	}
+
+	// size is the one passed to Allocate with an alignment up to 8
+	void Free(void* ptr, size_t size)
+	{
+		if (!ptr)
+		{
+			return;
+		}
+
+		if (size > MAX_SMALL_SIZE)
+		{
+			FreeLarge(ptr);
+			return;
+		}
+
+		Push(GetClass(size), ptr);
+	}
+
+	void Free(void* ptr)
+	{
+		if (!ptr)
+		{
+			return;
+		}
+
+		auto it = m_slabs.upper_bound((uintptr_t)ptr);
+		if (it != m_slabs.begin())
+		{
+			--it;
+			if ((uintptr_t)ptr < it->first + SLAB_SIZE)
+			{
+				Push(it->second.m_class, ptr);
+				return;
+			}
+		}
+
+		FreeLarge(ptr);
+	}
+
+	// See AllocatorTraits.h: the slabs with their blocks, the untouched tail of the current slab of a class is a free block;
+	// the blocks of malloc aren't tracked
+	template<typename TVisitor>
+	void WalkHeap(TVisitor& visitor) const
+	{
+		std::unordered_set<const void*> freeBlocks;
+		for (const SizeClass& sizeClass : m_classes)
+		{
+			for (const FreeBlock* block = sizeClass.m_free; block; block = block->m_next)
+			{
+				freeBlocks.insert(block);
+			}
+		}
+
+		for (auto& slab : m_slabs)
+		{
+			const size_t blockSize = (slab.second.m_class + 1) * GRANULARITY;
+			const SizeClass& sizeClass = m_classes[slab.second.m_class];
+			uint8_t* begin = (uint8_t*)slab.first;
+			uint8_t* end = begin + SLAB_SIZE / blockSize * blockSize;
+			uint8_t* used = sizeClass.m_end == end ? sizeClass.m_cursor : end;
+
+			visitor.Region(begin, SLAB_SIZE);
+			for (uint8_t* block = begin; block < used; block += blockSize)
+			{
+				visitor.Block(block, blockSize, freeBlocks.count(block) != 0);
+			}
+			if (used < end)
+			{
+				visitor.Block(used, (size_t)(end - used), true);
+			}
+		}
+	}
+
+private:
+	struct FreeBlock
+	{
+		FreeBlock* m_next;
+	};
+
+	struct SizeClass
+	{
+		FreeBlock* m_free = nullptr;
+		uint8_t* m_cursor = nullptr;
+		uint8_t* m_end = nullptr;
+	};
+
+	struct Slab
+	{
+		void* m_memory;
+		size_t m_class;
+	};
+
+	// malloc aligns by 16, the larger alignments need the aligned allocation of the platform
+	void* AllocateLarge(size_t size, size_t alignment)
+	{
+		if (alignment <= LARGE_ALIGNMENT)
+		{
+			return malloc(size);
+		}
+#ifdef _WIN32
+		void* ptr = _aligned_malloc(size, alignment);
+		if (ptr)
+		{
+			m_alignedBlocks.insert(ptr);
+		}
+		return ptr;
+#else
+		void* ptr = nullptr;
+		return posix_memalign(&ptr, alignment, size) == 0 ? ptr : nullptr;
+#endif
+	}
+
+	void FreeLarge(void* ptr)
+	{
+#ifdef _WIN32
+		if (!m_alignedBlocks.empty() && m_alignedBlocks.erase(ptr))
+		{
+			_aligned_free(ptr);
+			return;
+		}
+#endif
+		free(ptr);
+	}
+
+	static inline size_t GetClass(size_t size)
+	{
+		return size ? (size - 1) / GRANULARITY : 0;
+	}
+
+	inline void Push(size_t index, void* ptr)
+	{
+		FreeBlock* block = (FreeBlock*)ptr;
+		block->m_next = m_classes[index].m_free;
+		m_classes[index].m_free = block;
+	}
+
+	// The rest of the current slab is lost, it's less than a block
+	bool AddSlab(size_t index)
+	{
+		void* memory = malloc(SLAB_SIZE + SLAB_ALIGNMENT);
+		if (!memory)
+		{
+			return false;
+		}
+
+		const uintptr_t begin = ((uintptr_t)memory + SLAB_ALIGNMENT - 1) & ~(uintptr_t)(SLAB_ALIGNMENT - 1);
+		m_slabs[begin] = { memory, index };
+
+		const size_t blockSize = (index + 1) * GRANULARITY;
+		SizeClass& sizeClass = m_classes[index];
+		sizeClass.m_cursor = (uint8_t*)begin;
+		sizeClass.m_end = (uint8_t*)begin + SLAB_SIZE / blockSize * blockSize;
+		return true;
+	}
+
+	SizeClass m_classes[CLASSES_COUNT];
+	// slab blocks begin -> its memory and class, for Free(ptr)
+	std::map<uintptr_t, Slab> m_slabs;
+#ifdef _WIN32
+	// the blocks of _aligned_malloc, they need _aligned_free
+	std::unordered_set<void*> m_alignedBlocks;
+#endif
+};
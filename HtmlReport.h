@@ -0,0 +1,771 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Harness.h"
+#include "ResultsExport.h"
+#include "TestMatrix.h"
+
+// results.html without scripts or external resources: the charts are inline SVG built from the results,
+// so a report can be archived and opened offline. The sections follow the data of the run:
+// every size and test of Result::m_results, then the scaling, churn, fragmentation, latency and counters results if there are any.
+// For every size and test of the main tests there are the consumed time, the memory overhead, the time per Allocate/Free
+// and the overhead relative to the allocated size.
+
+// A line of a chart, the points are sorted by x
+struct ChartSeries
+{
+	std::string m_name;
+	std::vector<std::pair<double, double>> m_points;
+};
+
+inline std::string EscapeHtml(const std::string& value)
+{
+	std::string res;
+	for (char c : value)
+	{
+		switch (c)
+		{
+		case '<': res += "&lt;"; break;
+		case '>': res += "&gt;"; break;
+		case '&': res += "&amp;"; break;
+		case '"': res += "&quot;"; break;
+		default: res += c; break;
+		}
+	}
+	return res;
+}
+
+// Short label of an axis tick or a point
+inline std::string FormatChartValue(double value)
+{
+	char buffer[64];
+	const double magnitude = std::fabs(value);
+	if (magnitude == 0.0 || magnitude >= 100.0)
+	{
+		snprintf(buffer, sizeof(buffer), "%.0f", value);
+	}
+	else if (magnitude >= 10.0)
+	{
+		snprintf(buffer, sizeof(buffer), "%.1f", value);
+	}
+	else if (magnitude >= 1.0)
+	{
+		snprintf(buffer, sizeof(buffer), "%.2f", value);
+	}
+	else
+	{
+		snprintf(buffer, sizeof(buffer), "%.3g", value);
+	}
+
+	// 2.50 -> 2.5, 1.00 -> 1
+	std::string label = buffer;
+	if (label.find('.') != std::string::npos && label.find('e') == std::string::npos)
+	{
+		label.erase(label.find_last_not_of('0') + 1);
+		if (label.back() == '.')
+		{
+			label.pop_back();
+		}
+	}
+	return label;
+}
+
+// 1, 2 or 5 times a power of ten, so that about ticksCount steps cover range
+inline double GetChartStep(double range, int ticksCount)
+{
+	if (range <= 0.0)
+	{
+		return 1.0;
+	}
+
+	const double raw = range / ticksCount;
+	const double magnitude = std::pow(10.0, std::floor(std::log10(raw)));
+	const double normalized = raw / magnitude;
+	return (normalized <= 1.0 ? 1.0 : normalized <= 2.0 ? 2.0 : normalized <= 5.0 ? 5.0 : 10.0) * magnitude;
+}
+
+// Line chart of the series, or grouped columns at every distinct x when bBars is set; y starts at 0
+inline std::string GetSvgChart(const std::string& title, const char* xTitle, const char* yTitle, const std::vector<ChartSeries>& series, bool bBars = false)
+{
+	static const char* colors[] = { "#3366cc", "#dc3912", "#ff9900", "#109618", "#990099", "#0099c6", "#dd4477", "#66aa00", "#b82e2e", "#316395" };
+	static const int ColorsCount = (int)(sizeof(colors) / sizeof(colors[0]));
+	static const int Width = 520;
+	static const int Left = 64;
+	static const int Right = 12;
+	static const int Top = 30;
+	static const int PlotHeight = 180;
+	static const int LegendColumns = 3;
+
+	std::set<double> xs;
+	double yMax = 0.0;
+	for (const ChartSeries& line : series)
+	{
+		for (auto& point : line.m_points)
+		{
+			xs.insert(point.first);
+			yMax = (std::max)(yMax, point.second);
+		}
+	}
+
+	if (xs.empty())
+	{
+		return std::string();
+	}
+
+	const int legendRows = ((int)series.size() + LegendColumns - 1) / LegendColumns;
+	const int height = Top + PlotHeight + 44 + legendRows * 16;
+	const int plotWidth = Width - Left - Right;
+	const int bottom = Top + PlotHeight;
+
+	const double yStep = GetChartStep(yMax, 5);
+	const double yTop = yMax > 0.0 ? std::ceil(yMax / yStep) * yStep : 1.0;
+
+	double xMin = *xs.begin();
+	double xMax = *xs.rbegin();
+	if (xMax <= xMin)
+	{
+		xMin -= xMin != 0.0 ? std::fabs(xMin) * 0.5 : 1.0;
+		xMax += xMax != 0.0 ? std::fabs(xMax) * 0.5 : 1.0;
+	}
+
+	const std::vector<double> categories(xs.begin(), xs.end());
+	const double categoryWidth = (double)plotWidth / (double)categories.size();
+
+	auto toY = [&](double y) { return bottom - y / yTop * PlotHeight; };
+	auto toX = [&](double x)
+	{
+		if (bBars)
+		{
+			const size_t index = std::lower_bound(categories.begin(), categories.end(), x) - categories.begin();
+			return Left + categoryWidth * ((double)index + 0.5);
+		}
+		return Left + (x - xMin) / (xMax - xMin) * plotWidth;
+	};
+
+	char buffer[512];
+	snprintf(buffer, sizeof(buffer), "<svg class=\"chart\" xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" viewBox=\"0 0 %d %d\">\n",
+		Width, height, Width, height);
+	std::string svg = buffer;
+
+	svg += "<text x=\"" + std::to_string(Width / 2) + "\" y=\"18\" text-anchor=\"middle\" class=\"title\">" + EscapeHtml(title) + "</text>\n";
+
+	// horizontal grid with the y ticks
+	for (double y = 0.0; y <= yTop + yStep * 0.5; y += yStep)
+	{
+		snprintf(buffer, sizeof(buffer), "<line x1=\"%d\" y1=\"%.1f\" x2=\"%d\" y2=\"%.1f\" class=\"grid\"/>"
+			"<text x=\"%d\" y=\"%.1f\" text-anchor=\"end\">%s</text>\n",
+			Left, toY(y), Width - Right, toY(y), Left - 4, toY(y) + 4, FormatChartValue(y).c_str());
+		svg += buffer;
+	}
+
+	// x ticks: the categories of the columns, 6 steps of the line charts
+	if (bBars)
+	{
+		const size_t every = categories.size() / 8 + 1;
+		for (size_t i = 0; i < categories.size(); i += every)
+		{
+			snprintf(buffer, sizeof(buffer), "<text x=\"%.1f\" y=\"%d\" text-anchor=\"middle\">%s</text>\n",
+				toX(categories[i]), bottom + 14, FormatChartValue(categories[i]).c_str());
+			svg += buffer;
+		}
+	}
+	else
+	{
+		const double xStep = GetChartStep(xMax - xMin, 6);
+		for (double x = std::ceil(xMin / xStep) * xStep; x <= xMax + xStep * 0.001; x += xStep)
+		{
+			snprintf(buffer, sizeof(buffer), "<line x1=\"%.1f\" y1=\"%d\" x2=\"%.1f\" y2=\"%d\" class=\"axis\"/>"
+				"<text x=\"%.1f\" y=\"%d\" text-anchor=\"middle\">%s</text>\n",
+				toX(x), bottom, toX(x), bottom + 4, toX(x), bottom + 14, FormatChartValue(x).c_str());
+			svg += buffer;
+		}
+	}
+
+	snprintf(buffer, sizeof(buffer), "<line x1=\"%d\" y1=\"%d\" x2=\"%d\" y2=\"%d\" class=\"axis\"/>"
+		"<line x1=\"%d\" y1=\"%d\" x2=\"%d\" y2=\"%d\" class=\"axis\"/>\n",
+		Left, Top, Left, bottom, Left, bottom, Width - Right, bottom);
+	svg += buffer;
+
+	snprintf(buffer, sizeof(buffer), "<text x=\"%d\" y=\"%d\" text-anchor=\"middle\">%s</text>"
+		"<text x=\"12\" y=\"%d\" text-anchor=\"middle\" transform=\"rotate(-90 12 %d)\">%s</text>\n",
+		Left + plotWidth / 2, bottom + 30, EscapeHtml(xTitle).c_str(), Top + PlotHeight / 2, Top + PlotHeight / 2, EscapeHtml(yTitle).c_str());
+	svg += buffer;
+
+	const double barWidth = categoryWidth * 0.8 / (double)(std::max)(series.size(), (size_t)1);
+	for (size_t s = 0; s < series.size(); s++)
+	{
+		const ChartSeries& line = series[s];
+		const char* color = colors[s % ColorsCount];
+
+		if (!bBars && line.m_points.size() > 1)
+		{
+			std::string points;
+			for (auto& point : line.m_points)
+			{
+				snprintf(buffer, sizeof(buffer), "%s%.1f,%.1f", points.empty() ? "" : " ", toX(point.first), toY(point.second));
+				points += buffer;
+			}
+			svg += std::string("<polyline fill=\"none\" stroke=\"") + color + "\" stroke-width=\"2\" points=\"" + points + "\"/>\n";
+		}
+
+		for (auto& point : line.m_points)
+		{
+			const std::string tooltip = "<title>" + EscapeHtml(line.m_name) + ": " + FormatChartValue(point.first) + ", " + FormatChartValue(point.second) + "</title>";
+			if (bBars)
+			{
+				const double x = toX(point.first) - categoryWidth * 0.4 + barWidth * (double)s;
+				snprintf(buffer, sizeof(buffer), "<rect x=\"%.1f\" y=\"%.1f\" width=\"%.1f\" height=\"%.1f\" fill=\"%s\">",
+					x, toY(point.second), barWidth, bottom - toY(point.second), color);
+				svg += buffer + tooltip + "</rect>\n";
+			}
+			else
+			{
+				snprintf(buffer, sizeof(buffer), "<circle cx=\"%.1f\" cy=\"%.1f\" r=\"3\" fill=\"%s\">", toX(point.first), toY(point.second), color);
+				svg += buffer + tooltip + "</circle>\n";
+			}
+		}
+	}
+
+	for (size_t s = 0; s < series.size(); s++)
+	{
+		const int x = Left + (int)(s % LegendColumns) * (plotWidth / LegendColumns);
+		const int y = bottom + 44 + (int)(s / LegendColumns) * 16;
+		snprintf(buffer, sizeof(buffer), "<rect x=\"%d\" y=\"%d\" width=\"10\" height=\"10\" fill=\"%s\"/><text x=\"%d\" y=\"%d\">",
+			x, y - 9, colors[s % ColorsCount], x + 14, y);
+		svg += buffer + EscapeHtml(series[s].m_name) + "</text>\n";
+	}
+
+	return svg + "</svg>\n";
+}
+
+// Anchor of a section, the names are identifiers (TestMatrix.h) but the tests of the other cases may have any characters
+inline std::string GetReportAnchor(const std::string& name)
+{
+	std::string anchor;
+	for (char c : name)
+	{
+		anchor += isalnum((unsigned char)c) ? c : '_';
+	}
+	return anchor;
+}
+
+// Sizes of m_results: the ones of the matrix in its order, then the ones of the other tests sorted
+inline std::vector<std::string> GetReportSizes(std::vector<Result>& results, const TestMatrix& matrix)
+{
+	std::vector<std::string> sizes;
+	std::set<std::string> others;
+	for (const SizeRange& size : matrix.m_sizes)
+	{
+		sizes.push_back(size.m_name);
+	}
+	for (auto& result : results)
+	{
+		for (auto& size : result.m_results)
+		{
+			if (std::find(sizes.begin(), sizes.end(), size.first) == sizes.end())
+			{
+				others.insert(size.first);
+			}
+		}
+	}
+	sizes.insert(sizes.end(), others.begin(), others.end());
+	return sizes;
+}
+
+// Time, overhead, time per operation and relative overhead charts of every test of a size
+inline std::string GetSizeHtml(std::vector<Result>& results, const TestMatrix& matrix, const std::string& size)
+{
+	const SizeRange* range = nullptr;
+	for (const SizeRange& matrixSize : matrix.m_sizes)
+	{
+		range = matrixSize.m_name == size ? &matrixSize : range;
+	}
+
+	// the patterns in their order, then the other tests sorted
+	std::vector<std::string> tests;
+	std::set<std::string> others;
+	for (int pattern = 0; pattern < PatternsCount; pattern++)
+	{
+		tests.push_back(GetPatternName(pattern));
+	}
+	for (auto& result : results)
+	{
+		auto it = result.m_results.find(size);
+		if (it == result.m_results.end())
+		{
+			continue;
+		}
+		for (auto& test : it->second)
+		{
+			if (std::find(tests.begin(), tests.begin() + PatternsCount, test.first) == tests.begin() + PatternsCount)
+			{
+				others.insert(test.first);
+			}
+		}
+	}
+	tests.insert(tests.end(), others.begin(), others.end());
+
+	std::string html;
+	for (size_t t = 0; t < tests.size(); t++)
+	{
+		const std::string& test = tests[t];
+		// the allocations counts of the main tests are the steps of the range, the other tests don't have them
+		const bool bPerOperation = range != nullptr && t < PatternsCount;
+
+		std::vector<ChartSeries> time, overhead, perOperation, ratio;
+		for (auto& result : results)
+		{
+			auto sizeIt = result.m_results.find(size);
+			if (sizeIt == result.m_results.end() || !sizeIt->second.count(test))
+			{
+				continue;
+			}
+
+			const std::map<size_t, std::pair<size_t, float>> points(sizeIt->second[test].begin(), sizeIt->second[test].end());
+			const TestStatistics* statistics = result.m_statistics.count(size) ? &result.m_statistics[size] : nullptr;
+
+			ChartSeries series;
+			series.m_name = result.m_allocator;
+			time.push_back(series);
+			overhead.push_back(series);
+			perOperation.push_back(series);
+			ratio.push_back(series);
+
+			size_t step = 0;
+			for (auto& point : points)
+			{
+				step++;
+				const double allocatedMb = (double)point.first / 1048576.0;
+				time.back().m_points.emplace_back(allocatedMb, (double)point.second.first);
+				overhead.back().m_points.emplace_back(allocatedMb, (double)point.second.second);
+				if (allocatedMb > 0.0)
+				{
+					ratio.back().m_points.emplace_back(allocatedMb, (double)point.second.second / allocatedMb * 100.0);
+				}
+
+				if (bPerOperation)
+				{
+					// a repetition does allocations Allocate and as many Free calls, the median repetition if there were several
+					const size_t allocations = range->m_allocations / 5 * step;
+					double ms = (double)point.second.first / (double)matrix.GetIterations(*range);
+					if (statistics && statistics->count(test) && statistics->at(test).count(point.first))
+					{
+						ms = statistics->at(test).at(point.first).m_median;
+					}
+					if (allocations)
+					{
+						perOperation.back().m_points.emplace_back(allocatedMb, ms * 1000000.0 / (2.0 * (double)allocations));
+					}
+				}
+			}
+		}
+
+		if (time.empty())
+		{
+			continue;
+		}
+
+		std::string title = test;
+		title[0] = (char)toupper((unsigned char)title[0]);
+
+		html += "<h3>" + EscapeHtml(title) + "</h3>\n<div class=\"charts\">\n";
+		html += GetSvgChart(title + " consumed time", "Total allocated, mb", "ms", time);
+		html += GetSvgChart(title + " memory overhead", "Total allocated, mb", "mb", overhead, true);
+		if (bPerOperation)
+		{
+			html += GetSvgChart(title + " time per Allocate/Free", "Total allocated, mb", "ns", perOperation);
+		}
+		html += GetSvgChart(title + " overhead to allocated", "Total allocated, mb", "%", ratio);
+		html += "</div>\n";
+	}
+
+	if (html.empty())
+	{
+		return html;
+	}
+
+	return "<h2 id=\"size_" + GetReportAnchor(size) + "\">" + EscapeHtml(range ? range->GetTitle() : size) + "</h2>\n" + html + "<hr/>\n";
+}
+
+// Throughput by threads count of every group and mode of Result::m_scaling
+inline std::string GetScalingHtml(std::vector<Result>& results)
+{
+	std::map<std::string, std::set<std::string>> groups;
+	for (auto& result : results)
+	{
+		for (auto& group : result.m_scaling)
+		{
+			for (auto& mode : group.second)
+			{
+				groups[group.first].insert(mode.first);
+			}
+		}
+	}
+
+	std::string html;
+	for (auto& group : groups)
+	{
+		html += "<h3>" + EscapeHtml(group.first) + "</h3>\n<div class=\"charts\">\n";
+		for (const std::string& mode : group.second)
+		{
+			std::vector<ChartSeries> throughput;
+			for (auto& result : results)
+			{
+				auto groupIt = result.m_scaling.find(group.first);
+				if (groupIt == result.m_scaling.end() || !groupIt->second.count(mode))
+				{
+					continue;
+				}
+
+				throughput.emplace_back();
+				throughput.back().m_name = result.m_allocator;
+				for (const ScalingPoint& point : groupIt->second[mode])
+				{
+					throughput.back().m_points.emplace_back((double)point.m_threads, point.m_opsPerSec * 0.000001);
+				}
+			}
+			html += GetSvgChart(group.first + " " + mode, "Threads", "Mops/s", throughput);
+		}
+		html += "</div>\n";
+	}
+
+	if (html.empty())
+	{
+		return html;
+	}
+
+	return "<h2 id=\"scaling\">Multithreaded</h2>\n" + html + "<hr/>\n";
+}
+
+// Throughput and overhead of every window of the churn runs
+inline std::string GetChurnHtml(std::vector<Result>& results)
+{
+	std::map<std::string, std::set<std::string>> sizes;
+	for (auto& result : results)
+	{
+		for (auto& size : result.m_churn)
+		{
+			for (auto& lifetime : size.second)
+			{
+				sizes[size.first].insert(lifetime.first);
+			}
+		}
+	}
+
+	std::string html;
+	for (auto& size : sizes)
+	{
+		for (const std::string& lifetime : size.second)
+		{
+			std::vector<ChartSeries> throughput, overhead;
+			for (auto& result : results)
+			{
+				auto sizeIt = result.m_churn.find(size.first);
+				if (sizeIt == result.m_churn.end() || !sizeIt->second.count(lifetime))
+				{
+					continue;
+				}
+
+				throughput.emplace_back();
+				overhead.emplace_back();
+				throughput.back().m_name = overhead.back().m_name = result.m_allocator;
+				for (const ChurnPoint& point : sizeIt->second[lifetime])
+				{
+					const double steps = (double)point.m_steps * 0.000001;
+					throughput.back().m_points.emplace_back(steps, point.m_opsPerSec * 0.000001);
+					overhead.back().m_points.emplace_back(steps, (double)point.GetOverhead() / 1048576.0);
+				}
+			}
+
+			html += "<h3>" + EscapeHtml(size.first + " " + lifetime) + "</h3>\n<div class=\"charts\">\n";
+			html += GetSvgChart(size.first + " " + lifetime + " throughput", "Steps, millions", "Mops/s", throughput);
+			html += GetSvgChart(size.first + " " + lifetime + " overhead", "Steps, millions", "mb", overhead);
+			html += "</div>\n";
+		}
+	}
+
+	if (html.empty())
+	{
+		return html;
+	}
+
+	return "<h2 id=\"churn\">Steady-state churn</h2>\n" + html + "<hr/>\n";
+}
+
+// Table of the heap states of TestCase_Fragmentation with the heap maps folded under every row
+inline std::string GetFragmentationHtml(std::vector<Result>& results)
+{
+	std::string rows;
+	for (auto& result : results)
+	{
+		const std::map<std::string, FragmentationStats*> sizes = [&]()
+		{
+			std::map<std::string, FragmentationStats*> sorted;
+			for (auto& size : result.m_fragmentation)
+			{
+				sorted[size.first] = &size.second;
+			}
+			return sorted;
+		}();
+
+		for (auto& size : sizes)
+		{
+			const FragmentationStats& stats = *size.second;
+
+			char buffer[512];
+			snprintf(buffer, sizeof(buffer), "<td>%zu</td><td>%.2f</td><td>%.1f</td><td>%.1f</td><td>%.2f</td><td>%.2f</td></tr>\n",
+				stats.m_regions, (double)stats.m_regionBytes / 1048576.0, stats.GetInternal() * 100.0, stats.GetExternal() * 100.0,
+				(double)stats.GetMetadataBytes() / 1048576.0, (double)stats.m_untrackedBytes / 1048576.0);
+			rows += "<tr><td>" + EscapeHtml(result.m_allocator) + "</td><td>" + EscapeHtml(size.first) + "</td>" + buffer;
+
+			if (!stats.m_heapMaps.empty())
+			{
+				std::string maps;
+				for (const std::string& map : stats.m_heapMaps)
+				{
+					maps += EscapeHtml(map) + "\n";
+				}
+				rows += "<tr><td colspan=\"8\"><details><summary>heap map</summary><pre>" + maps + "</pre></details></td></tr>\n";
+			}
+		}
+	}
+
+	if (rows.empty())
+	{
+		return rows;
+	}
+
+	return "<h2 id=\"fragmentation\">Fragmentation after freeing a random half</h2>\n"
+		"<table class=\"latency\">\n"
+		"<tr><th>Allocator</th><th>Size</th><th>Regions</th><th>Regions, mb</th><th>Internal, %</th><th>External, %</th>"
+		"<th>Metadata, mb</th><th>Untracked, mb</th></tr>\n" +
+		rows +
+		"</table>\n"
+		"<hr/>\n";
+}
+
+// Table of latency percentiles for every allocator, size and test, empty if the histograms weren't collected
+inline std::string GetLatencyHtml(std::vector<Result>& results, const TestMatrix& matrix)
+{
+	static const double percentiles[] = { 50.0, 99.0, 99.9 };
+
+	const double nsPerTick = 1000000000.0 / Platform::GetCycleCounterFrequency();
+
+	std::string rows;
+	for (auto& result : results)
+	{
+		for (const SizeRange& sizeRange : matrix.m_sizes)
+		{
+			const char* size = sizeRange.m_name.c_str();
+			for (int pattern = 0; pattern < PatternsCount; pattern++)
+			{
+				const char* test = GetPatternName(pattern);
+				const LatencyStats& stats = result.m_latency[size][test];
+				if (stats.m_allocate.GetTotalCount() == 0)
+				{
+					continue;
+				}
+
+				const LatencyHistogram* histograms[] = { &stats.m_allocate, &stats.m_free };
+				const char* operations[] = { "Allocate", "Free" };
+
+				for (int i = 0; i < 2; i++)
+				{
+					rows += "<tr><td>" + EscapeHtml(result.m_allocator) + "</td><td>" + size + "</td><td>" + test + "</td><td>" + operations[i] + "</td>";
+					for (double percentile : percentiles)
+					{
+						char buffer[64];
+						snprintf(buffer, sizeof(buffer), "<td>%.0f</td>", histograms[i]->GetPercentile(percentile) * nsPerTick);
+						rows += buffer;
+					}
+
+					char buffer[64];
+					snprintf(buffer, sizeof(buffer), "<td>%.0f</td></tr>\n", histograms[i]->GetMax() * nsPerTick);
+					rows += buffer;
+				}
+			}
+		}
+	}
+
+	if (rows.empty())
+	{
+		return rows;
+	}
+
+	return "<h2 id=\"latency\">Latency percentiles, ns</h2>\n"
+		"<table class=\"latency\">\n"
+		"<tr><th>Allocator</th><th>Size</th><th>Test</th><th>Operation</th><th>p50</th><th>p99</th><th>p99.9</th><th>max</th></tr>\n" +
+		rows +
+		"</table>\n"
+		"<hr/>\n";
+}
+
+// Table of hardware counters per Allocate/Free for every allocator, size and test, empty if they weren't collected
+inline std::string GetPerfCountersHtml(std::vector<Result>& results, const TestMatrix& matrix)
+{
+	std::string rows;
+	for (auto& result : results)
+	{
+		for (const SizeRange& sizeRange : matrix.m_sizes)
+		{
+			const char* size = sizeRange.m_name.c_str();
+			for (int pattern = 0; pattern < PatternsCount; pattern++)
+			{
+				const char* test = GetPatternName(pattern);
+				const PerfCounterStats& stats = result.m_counters[size][test];
+				if (stats.m_operations == 0)
+				{
+					continue;
+				}
+
+				rows += "<tr><td>" + EscapeHtml(result.m_allocator) + "</td><td>" + size + "</td><td>" + test + "</td>";
+				for (int i = 0; i < Platform::PerfCountersCount; i++)
+				{
+					char buffer[64];
+					if (stats.m_bAvailable[i])
+					{
+						snprintf(buffer, sizeof(buffer), "<td>%.2f</td>", stats.GetPerOperation(i));
+					}
+					else
+					{
+						snprintf(buffer, sizeof(buffer), "<td>-</td>");
+					}
+					rows += buffer;
+				}
+				rows += "</tr>\n";
+			}
+		}
+	}
+
+	if (rows.empty())
+	{
+		return rows;
+	}
+
+	std::string header = "<tr><th>Allocator</th><th>Size</th><th>Test</th>";
+	for (int i = 0; i < Platform::PerfCountersCount; i++)
+	{
+		header += std::string("<th>") + Platform::GetPerfCounterName(i) + "</th>";
+	}
+	header += "</tr>\n";
+
+	return "<h2 id=\"counters\">Hardware counters per Allocate/Free</h2>\n"
+		"<table class=\"latency\">\n" +
+		header +
+		rows +
+		"</table>\n"
+		"<hr/>\n";
+}
+
+// Environment, totals and errors of the allocators
+inline std::string GetSummaryHtml(std::vector<Result>& results, const RunEnvironment& environment)
+{
+	std::string html = "<table class=\"environment\">\n";
+	for (auto& it : environment)
+	{
+		html += "<tr><th>" + EscapeHtml(it.first) + "</th><td>" + EscapeHtml(it.second) + "</td></tr>\n";
+	}
+	html += "</table>\n";
+
+	html += "<table class=\"latency\">\n<tr><th>Allocator</th><th>Score</th><th>Memory overhead, mb</th><th>Time, sec</th></tr>\n";
+	for (auto& result : results)
+	{
+		char buffer[256];
+		snprintf(buffer, sizeof(buffer), "<td>%.2f</td><td>%.2f</td><td>%.2f</td></tr>\n", result.m_globalScore, result.m_globalMemoryOverhead, result.m_globalTime);
+		html += "<tr><td>" + EscapeHtml(result.m_allocator) + "</td>" + buffer;
+	}
+	html += "</table>\n";
+
+	std::string errors;
+	for (auto& result : results)
+	{
+		for (const std::string& error : result.m_errors)
+		{
+			errors += "<li>" + EscapeHtml(result.m_allocator) + ": " + EscapeHtml(error) + "</li>\n";
+		}
+	}
+	if (!errors.empty())
+	{
+		html += "<h3>Errors</h3>\n<ul class=\"errors\">\n" + errors + "</ul>\n";
+	}
+
+	return html + "<hr/>\n";
+}
+
+inline bool WriteHtmlReport(std::vector<Result>& results, const TestMatrix& matrix, const RunEnvironment& environment, const char* path)
+{
+	std::string contents;
+	std::string sections;
+
+	for (const std::string& size : GetReportSizes(results, matrix))
+	{
+		const std::string html = GetSizeHtml(results, matrix, size);
+		if (!html.empty())
+		{
+			contents += "<li><a href=\"#size_" + GetReportAnchor(size) + "\">" + EscapeHtml(size) + "</a></li>";
+			sections += html;
+		}
+	}
+
+	// the rest of the sections in their order, with the anchors they set
+	const std::pair<const char*, std::string> others[] =
+	{
+		{ "scaling", GetScalingHtml(results) },
+		{ "churn", GetChurnHtml(results) },
+		{ "fragmentation", GetFragmentationHtml(results) },
+		{ "latency", GetLatencyHtml(results, matrix) },
+		{ "counters", GetPerfCountersHtml(results, matrix) },
+	};
+	for (auto& section : others)
+	{
+		if (!section.second.empty())
+		{
+			contents += std::string("<li><a href=\"#") + section.first + "\">" + section.first + "</a></li>";
+			sections += section.second;
+		}
+	}
+
+	std::string html =
+		"<!DOCTYPE html>\n"
+		"<html>\n"
+		"<head>\n"
+		"<meta charset=\"utf-8\">\n"
+		"<title>Results</title>\n"
+		"<style>\n"
+		"body { font-family: sans-serif; font-size: 14px; }\n"
+		".contents li { display: inline; margin-right: 12px; }\n"
+		".charts { display: flex; flex-wrap: wrap; }\n"
+		".chart { margin: 5px; }\n"
+		".chart text { font-size: 11px; fill: #333; }\n"
+		".chart .title { font-size: 13px; font-weight: bold; }\n"
+		".chart .grid { stroke: #e0e0e0; }\n"
+		".chart .axis { stroke: #333; }\n"
+		".environment th { text-align: left; padding: 2px 8px; }\n"
+		".latency td, .latency th { padding: 2px 8px; text-align: right; }\n"
+		".latency td:first-child, .latency th:first-child { text-align: left; }\n"
+		".errors { color: #b00; }\n"
+		"pre { font-size: 11px; }\n"
+		"</style>\n"
+		"</head>\n"
+		"<body>\n"
+		"<h1>Results</h1>\n";
+
+	html += GetSummaryHtml(results, environment);
+	html += "<ul class=\"contents\">" + contents + "</ul>\n<hr/>\n";
+	html += sections;
+	html +=
+		"</body>\n"
+		"</html>\n";
+
+	std::ofstream file{ path };
+	file << html;
+	return file.good();
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include "AllocatorTraits.h"
+#include "Platform.h"
+
+// Large blocks mapped straight from the OS, a mapping per block rounded up to the pages.
+// The blocks start at a page boundary, so Owns rejects the other addresses before looking the mappings up.
+class MmapAllocator
+{
+public:
+	MmapAllocator() = default;
+	MmapAllocator(const MmapAllocator&) = delete;
+	MmapAllocator& operator=(const MmapAllocator&) = delete;
+
+	~MmapAllocator()
+	{
+		for (auto& mapping : m_mappings)
+		{
+			Platform::UnmapPages(mapping.second.m_base, mapping.second.m_size);
+		}
+	}
+
+	void* Allocate(size_t size, size_t alignment)
+	{
+		const size_t pageSize = Platform::GetPageSize();
+		// an alignment above the page is found within alignment more bytes
+		const size_t extra = alignment > pageSize ? alignment : 0;
+		const size_t mapped = ((size ? size : 1) + extra + pageSize - 1) & ~(pageSize - 1);
+
+		uint8_t* base = (uint8_t*)Platform::MapPages(mapped);
+		if (!base)
+		{
+			return nullptr;
+		}
+
+		uint8_t* ptr = extra ? (uint8_t*)(((uintptr_t)base + alignment - 1) & ~(uintptr_t)(alignment - 1)) : base;
+		m_mappings[ptr] = { base, mapped };
+		return ptr;
+	}
+
+	void Free(void* ptr)
+	{
+		auto it = m_mappings.find(ptr);
+		if (it != m_mappings.end())
+		{
+			Platform::UnmapPages(it->second.m_base, it->second.m_size);
+			m_mappings.erase(it);
+		}
+	}
+
+	bool Owns(const void* ptr) const
+	{
+		return ((uintptr_t)ptr & (Platform::GetPageSize() - 1)) == 0 && m_mappings.count(ptr) != 0;
+	}
+
+private:
+	struct Mapping
+	{
+		void* m_base;
+		size_t m_size;
+	};
+
+	// the pointer returned by Allocate -> its mapping
+	std::unordered_map<const void*, Mapping> m_mappings;
+};
+
+// Composite of three allocators, each serving the size range it does best on:
+//     HybridAllocator<DenisPerevalov::Oneshotlocator, AntonShatalov::Ololokator, MmapAllocator, 64 * 1024, 1024 * 1024>
+// Allocate routes by the size against the bounds, which are template arguments, so the dispatch is two compares
+// the compiler can see through. The blocks carry nothing more than the backends put in them: Free asks the medium and
+// the large backends if they own the address (Owns, AllocatorTraits.h) and leaves the rest to the small one,
+// so the small backend needs no Owns and gets every pointer the others don't know. The sized Free routes by the size
+// like Allocate and skips the lookups. The medium backend must own all the blocks up to MEDIUM_MAX_SIZE,
+// Ololokator does up to its largest pool of 128mb.
+template<typename TSmall, typename TMedium, typename TLarge, size_t SMALL_MAX_SIZE, size_t MEDIUM_MAX_SIZE>
+class HybridAllocator
+{
+	static_assert(SMALL_MAX_SIZE < MEDIUM_MAX_SIZE, "the size ranges must follow each other");
+	static_assert(HasOwns<TMedium>::value && HasOwns<TLarge>::value, "Free finds the medium and the large blocks with Owns");
+
+public:
+	inline void* Allocate(size_t size, size_t alignment)
+	{
+		if (size <= SMALL_MAX_SIZE)
+		{
+			return m_small.Allocate(size, alignment);
+		}
+		if (size <= MEDIUM_MAX_SIZE)
+		{
+			return m_medium.Allocate(size, alignment);
+		}
+		return m_large.Allocate(size, alignment);
+	}
+
+	inline void Free(void* ptr)
+	{
+		if (!ptr)
+		{
+			return;
+		}
+
+		if (m_medium.Owns(ptr))
+		{
+			m_medium.Free(ptr);
+		}
+		else if (m_large.Owns(ptr))
+		{
+			m_large.Free(ptr);
+		}
+		else
+		{
+			m_small.Free(ptr);
+		}
+	}
+
+	// size is the one passed to Allocate, see AllocatorTraits.h
+	inline void Free(void* ptr, size_t size)
+	{
+		if (size <= SMALL_MAX_SIZE)
+		{
+			FreeBlock(m_small, ptr, size);
+		}
+		else if (size <= MEDIUM_MAX_SIZE)
+		{
+			FreeBlock(m_medium, ptr, size);
+		}
+		else
+		{
+			FreeBlock(m_large, ptr, size);
+		}
+	}
+
+private:
+	TSmall m_small;
+	TMedium m_medium;
+	TLarge m_large;
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include "Platform.h"
+
+// Log-linear (HDR-style) histogram of per-operation latencies in cycle counter ticks.
+// Values below 2^SUB_BUCKET_BITS are stored exactly, larger ones keep SUB_BUCKET_BITS significant bits,
+// so the relative error of any percentile is below 1 / 2^(SUB_BUCKET_BITS - 1) (~6%).
+class LatencyHistogram
+{
+public:
+	static const int SUB_BUCKET_BITS = 5;
+	static const uint64_t SUB_BUCKET_COUNT = 1ull << SUB_BUCKET_BITS;
+	static const uint64_t SUB_BUCKET_HALF = SUB_BUCKET_COUNT >> 1;
+	static const size_t BUCKETS_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_HALF + SUB_BUCKET_HALF;
+
+	LatencyHistogram()
+	{
+		Clear();
+	}
+
+	inline void Record(uint64_t value)
+	{
+		m_counts[GetBucketIndex(value)]++;
+		m_totalCount++;
+		m_max = value > m_max ? value : m_max;
+	}
+
+	void Merge(const LatencyHistogram& other)
+	{
+		for (size_t i = 0; i < BUCKETS_COUNT; i++)
+		{
+			m_counts[i] += other.m_counts[i];
+		}
+		m_totalCount += other.m_totalCount;
+		m_max = other.m_max > m_max ? other.m_max : m_max;
+	}
+
+	void Clear()
+	{
+		memset(m_counts, 0, sizeof(m_counts));
+		m_totalCount = 0;
+		m_max = 0;
+	}
+
+	// Highest value equivalent to the bucket containing the percentile, percentile is in [0, 100]
+	uint64_t GetPercentile(double percentile) const
+	{
+		if (m_totalCount == 0)
+		{
+			return 0;
+		}
+
+		uint64_t countAtPercentile = (uint64_t)(percentile / 100.0 * (double)m_totalCount + 0.5);
+		countAtPercentile = countAtPercentile > 0 ? countAtPercentile : 1;
+
+		uint64_t count = 0;
+		for (size_t i = 0; i < BUCKETS_COUNT; i++)
+		{
+			count += m_counts[i];
+			if (count >= countAtPercentile)
+			{
+				const uint64_t highest = GetBucketHighestValue(i);
+				return highest < m_max ? highest : m_max;
+			}
+		}
+
+		return m_max;
+	}
+
+	uint64_t GetMax() const
+	{
+		return m_max;
+	}
+
+	uint64_t GetTotalCount() const
+	{
+		return m_totalCount;
+	}
+
+	uint64_t GetBucketCount(size_t index) const
+	{
+		return m_counts[index];
+	}
+
+	// Restores a histogram recorded elsewhere, e.g. in another process, bucket by bucket
+	void AddBucketCount(size_t index, uint64_t count, uint64_t max)
+	{
+		m_counts[index] += count;
+		m_totalCount += count;
+		m_max = max > m_max ? max : m_max;
+	}
+
+	static inline size_t GetBucketIndex(uint64_t value)
+	{
+		if (value < SUB_BUCKET_COUNT)
+		{
+			return (size_t)value;
+		}
+
+		// keep SUB_BUCKET_BITS significant bits, the mantissa is in [SUB_BUCKET_HALF, SUB_BUCKET_COUNT)
+		const int shift = GetHighestBit(value) - SUB_BUCKET_BITS + 1;
+		return (size_t)shift * SUB_BUCKET_HALF + (size_t)(value >> shift);
+	}
+
+	static inline uint64_t GetBucketHighestValue(size_t index)
+	{
+		if (index < SUB_BUCKET_COUNT)
+		{
+			return index;
+		}
+
+		const int shift = (int)(index / SUB_BUCKET_HALF) - 1;
+		const uint64_t mantissa = index % SUB_BUCKET_HALF + SUB_BUCKET_HALF;
+		return ((mantissa + 1) << shift) - 1;
+	}
+
+private:
+	static inline int GetHighestBit(uint64_t value)
+	{
+		unsigned long index = 0;
+		_BitScanReverse64(&index, value);
+		return (int)index;
+	}
+
+	uint64_t m_counts[BUCKETS_COUNT];
+	uint64_t m_totalCount;
+	uint64_t m_max;
+};
+
+// Latencies of both operations of the allocator
+struct LatencyStats
+{
+	LatencyHistogram m_allocate;
+	LatencyHistogram m_free;
+
+	void Merge(const LatencyStats& other)
+	{
+		m_allocate.Merge(other.m_allocate);
+		m_free.Merge(other.m_free);
+	}
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// Lock policies for sharing a single allocator instance between threads.
+// Any type with Lock()/Unlock() can be used as a policy.
+
+class NoLock
+{
+public:
+	inline void Lock() {}
+	inline void Unlock() {}
+};
+
+class MutexLock
+{
+public:
+	inline void Lock()
+	{
+		m_mutex.lock();
+	}
+
+	inline void Unlock()
+	{
+		m_mutex.unlock();
+	}
+
+private:
+	std::mutex m_mutex;
+};
+
+// Test-and-test-and-set spin lock, yields after a while to survive oversubscription
+class SpinLock
+{
+public:
+	inline void Lock()
+	{
+		uint32_t spins = 0;
+		while (m_locked.exchange(true, std::memory_order_acquire))
+		{
+			while (m_locked.load(std::memory_order_relaxed))
+			{
+				if (++spins > 1024)
+				{
+					std::this_thread::yield();
+					spins = 0;
+				}
+			}
+		}
+	}
+
+	inline void Unlock()
+	{
+		m_locked.store(false, std::memory_order_release);
+	}
+
+private:
+	std::atomic<bool> m_locked{ false };
+};
+
+// Allocator adapter serializing every call to the wrapped allocator with TLock
+template<typename TAllocator, typename TLock = MutexLock>
+class LockedAllocator
+{
+public:
+	inline void* Allocate(size_t size, size_t alignment)
+	{
+		m_lock.Lock();
+		void* ptr = m_allocator.Allocate(size, alignment);
+		m_lock.Unlock();
+		return ptr;
+	}
+
+	inline void Free(void* ptr)
+	{
+		m_lock.Lock();
+		m_allocator.Free(ptr);
+		m_lock.Unlock();
+	}
+
+private:
+	TLock m_lock;
+	TAllocator m_allocator;
+};
@@ -5,9 +5,39 @@
 #include <cassert>
 #include <functional> 
 #include <cctype>
-#include <Windows.h>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <typeinfo>
 #include <fstream>
-#include "psapi.h"
+#include <iostream>
+#include <iomanip>
+#include <deque>
+#include <set>
+#include <limits>
+#include <stdexcept>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "Harness.h"
+#include "AllocatorTraits.h"
+#include "TestCase_ThreadScaling.h"
+#include "TestCase_CrossThreadFree.h"
+#include "TestCase_StressSuite.h"
+#include "TestCase_TraceReplay.h"
+#include "TestCase_Churn.h"
+#include "TestCase_Containers.h"
+#include "TestCase_Pmr.h"
+#include "TestCase_Reallocate.h"
+#include "TestCase_Batch.h"
+#include "TestCase_Alignment.h"
+#include "TestCase_Fragmentation.h"
+#include "ResultsExport.h"
+#include "HtmlReport.h"
+#include "ProcessIsolation.h"
+#include "TestMatrix.h"
 
 #include "DaniilPavlenko.h"
 #include "OlegApanasik.h"
@@ -15,153 +45,306 @@
 #include "AntonShatalov.h"
 #include "AlexeiMikhailov.h"
 #include "DenisPerevalov.h"
+#include "HeaderlessAllocator.h"
+#include "HybridAllocator.h"
+
+// Multithreaded scaling mode, see TestCase_ThreadScaling
+//#define ENABLE_SCALING_TESTS
+// Producer/consumer cross-thread free tests, see TestCase_CrossThreadFree
+//#define ENABLE_CROSS_THREAD_TESTS
+// Ports of larson, xmalloc-test, cache-scratch, cache-thrash and mstress, see TestCase_StressSuite
+//#define ENABLE_STRESS_SUITE
+// Timestamp every Allocate/Free of the performance tests and collect latency histograms, adds overhead to the timings
+//#define ENABLE_LATENCY_HISTOGRAMS
+// Sample the memory footprint in background during the performance tests, see MemoryTimeline.h
+//#define ENABLE_MEMORY_TIMELINE
+// Count cycles, instructions, cache, TLB and branch misses of the performance tests with perf_event_open (Linux)
+//#define ENABLE_PERF_COUNTERS
+// Untimed runs of every test before the measured ones, the measured runs are the iterations count of the test
+#define BENCHMARK_WARMUP_ITERATIONS 1
+// Seed of the pointer shuffles of the shuffle and random tests, fixed so the runs are reproducible
+#define BENCHMARK_SEED 5489u
+// Pin TestCase_MemoryPerformance to this CPU
+//#define BENCHMARK_PIN_CPU 2
+// Run every size range of TestCase_MemoryPerformance in a child process of its own (Linux), see ProcessIsolation.h
+//#define ENABLE_PROCESS_ISOLATION
+// Isolated size ranges running at once on separate CPUs, 0 is one per CPU; they share the memory bandwidth and the RAM
+#define ISOLATION_JOBS 1
+// Growable buffers benchmark of Reallocate, see TestCase_Reallocate
+//#define ENABLE_REALLOCATE_TESTS
+// Blocks of one size allocated and freed in batches with AllocateBatch/FreeBatch against the single calls, see TestCase_Batch
+//#define ENABLE_BATCH_TESTS
+// std::map, list, unordered_map, string and vector on the allocator through StlAllocator, see TestCase_Containers
+//#define ENABLE_CONTAINER_TESTS
+// std::pmr containers on ContestMemoryResource against the standard memory resources, see TestCase_Pmr
+//#define ENABLE_PMR_TESTS
+// Over-aligned requests of 16 ... 4096 bytes checked and compared to the alignment of 8, see TestCase_Alignment
+//#define ENABLE_ALIGNMENT_TESTS
+// Walk the heaps of the allocators with WalkHeap after freeing a random half of the blocks, see TestCase_Fragmentation
+//#define ENABLE_FRAGMENTATION_ANALYSIS
+// Replay a recorded allocation trace on every allocator, see TestCase_TraceReplay
+//#define REPLAY_TRACE_FILE "trace.bin"
 
-struct Timer
+class DefaultMallocAllocator
 {
-	int64_t m_counterStart = 0;
-	int64_t m_counterEnd = 0;
-	int64_t m_counterAcc = 0;
-	double m_pcFrequence = 0.0;
-
-	void Start()
+public:
+	inline void* Allocate(size_t size, size_t alignment)
 	{
-		LARGE_INTEGER li;
-		if (!QueryPerformanceFrequency(&li))
+		m_size += size;
+#ifndef _WIN32
+		// malloc aligns by 16, the larger alignments go to posix_memalign, its blocks are released by free too
+		if (alignment > 16)
 		{
+			void* ptr = nullptr;
+			return posix_memalign(&ptr, alignment, size) == 0 ? ptr : nullptr;
 		}
-
-		m_pcFrequence = double(li.QuadPart) / 1000.0;
-
-		QueryPerformanceCounter(&li);
-		m_counterStart = li.QuadPart;
+#endif
+		return malloc(size);
 	}
 
-	void Stop()
+	inline void Free(void* ptr)
 	{
-		LARGE_INTEGER li;
-		QueryPerformanceCounter(&li);
-		m_counterEnd = li.QuadPart;
+		free(ptr);
+	}
 
-		m_counterAcc += m_counterEnd - m_counterStart;
+	inline void* Reallocate(void* ptr, size_t newSize)
+	{
+		m_size += newSize;
+		return realloc(ptr, newSize);
 	}
 
-	int64_t ResultMs() const
+	size_t GetOccupiedSpace() const
 	{
-		return int64_t(double(m_counterEnd - m_counterStart) / m_pcFrequence);
+		return m_size;
 	}
 
-	int64_t ResultAccumulatedMs() const
+private:
+	size_t m_size = 0;
+};
+
+// The winners of the size regimes behind one allocator, see HybridAllocator.h: DenisPerevalov up to 64kb, which covers
+// the small and the medium ranges (on Linux the address look up of AntonShatalov makes the medium range slow),
+// AntonShatalov up to 1mb and a mapping per block above, which leaves the large and the random ranges to the OS
+class HybridContestAllocator : public HybridAllocator<DenisPerevalov::Oneshotlocator, AntonShatalov::Ololokator, MmapAllocator, 64 * 1024, 1024 * 1024>
+{
+};
+
+template<typename TAllocator>
+class TestCase_MemoryPerformance
+{
+	static float m_globalScore;
+	static float m_globalMemoryOverhead;
+	static float m_globalTime;
+
+public:
+	static Result RunTests(const TestMatrix& matrix)
 	{
-		if (m_pcFrequence == 0.0)
+		Result result(Platform::DemangleTypeName(typeid(TAllocator).name()));
+		for (const SizeRange& size : matrix.m_sizes)
 		{
-			return 0;
+			RunSizeTests(result, size, matrix);
 		}
-		return int64_t((double)m_counterAcc / m_pcFrequence);
+
+		//RunSanityTests();
+
+		PrintResult(result, matrix);
+		return result;
 	}
 
-	void Clear()
+	// Every size range runs in a child process of its own, up to jobs of them at once, see ProcessIsolation.h
+	static Result RunIsolatedTests(const TestMatrix& matrix, size_t jobs)
 	{
-		m_counterStart = 0;
-		m_counterEnd = 0;
-		m_counterAcc = 0;
-		m_pcFrequence = 0.0;
-	}
-};
+		Result result(Platform::DemangleTypeName(typeid(TAllocator).name()));
 
-size_t GetTotalUsedVirtualMemory()
-{
-	PROCESS_MEMORY_COUNTERS_EX pmc;
-	GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&pmc, sizeof(pmc));
-	SIZE_T virtualMemUsedByMe = pmc.PrivateUsage;
+		std::vector<IsolatedCell> cells;
+		for (const SizeRange& size : matrix.m_sizes)
+		{
+			cells.push_back({ size.m_name, [&size, &matrix](Result& cellResult) { RunSizeTests(cellResult, size, matrix); } });
+		}
+		RunIsolated(cells, result, jobs);
 
-	MEMORYSTATUSEX statex;
+		PrintResult(result, matrix);
+		return result;
+	}
 
-	statex.dwLength = sizeof(statex);
+	// Runs the tests of one size range into the result and adds their totals to it
+	static void RunSizeTests(Result& result, const SizeRange& size, const TestMatrix& matrix)
+	{
+		const float score = m_globalScore;
+		const float memoryOverhead = m_globalMemoryOverhead;
+		const float time = m_globalTime;
 
-	GlobalMemoryStatusEx(&statex);
+		const std::string& name = size.m_name;
+		result.m_results[name] = RunPerformanceTests(size.m_minSize, size.m_maxSize, matrix.GetIterations(size), size.m_allocations,
+			&result.m_latency[name], &result.m_memory[name], &result.m_counters[name], &result.m_statistics[name], matrix.m_patterns, size.m_distribution);
 
-	MEMORYSTATUSEX memInfo;
-	memInfo.dwLength = sizeof(MEMORYSTATUSEX);
-	GlobalMemoryStatusEx(&memInfo);
-	DWORDLONG virtualMemUsed = memInfo.ullTotalVirtual - memInfo.ullAvailVirtual;
+		result.m_globalScore += m_globalScore - score;
+		result.m_globalMemoryOverhead += m_globalMemoryOverhead - memoryOverhead;
+		result.m_globalTime += m_globalTime - time;
+	}
 
-	return (size_t)virtualMemUsedByMe;
-}
+	static void PrintResult(Result& result, const TestMatrix& matrix)
+	{
+		printf("%s\n    Score: %.2f,\n    Total memory overhead: %.2fmb,\n    Total time: %.2fsec\n\n", result.m_allocator.c_str(),
+			result.m_globalScore, result.m_globalMemoryOverhead, result.m_globalTime);
 
-typedef std::unordered_map<std::string, std::unordered_map<size_t, std::pair<size_t, float>>> TestResult;
+		for (const std::string& error : result.m_errors)
+		{
+			printf("    %s\n\n", error.c_str());
+		}
 
-struct Result
-{
-	Result(std::string allocator) : m_allocator(allocator) {}
+		PrintStatistics(result, matrix);
 
-	std::string m_allocator;
-	std::unordered_map<std::string, TestResult> m_results;
+#ifdef ENABLE_LATENCY_HISTOGRAMS
+		PrintLatency(result, matrix);
+#endif
 
-	size_t m_globalScore = 0;
-};
+#ifdef ENABLE_MEMORY_TIMELINE
+		PrintMemoryTimeline(result, matrix);
+#endif
 
-class DefaultMallocAllocator
-{
-public:
-	inline void* Allocate(size_t size, size_t alignment)
-	{
-		m_size += size;
-		return malloc(size);
+#ifdef ENABLE_PERF_COUNTERS
+		PrintPerfCounters(result, matrix);
+#endif
 	}
 
-	inline void Free(void* ptr)
+	static void RunSanityTests()
 	{
-		free(ptr);
+		const std::string allocatorName = Platform::DemangleTypeName(typeid(TAllocator).name());
+
+		printf("\n\n%s\n", allocatorName.c_str());
+		printf("Can allocate huge block: %d\n", SanityCanAllocHugeBlock());
+		printf("Is stack based: %d\n", !SanityCheckIsStack());
+		printf("Sanity check passed: %d\n", SanityCheck());
 	}
 
-	size_t GetOccupiedSpace() const
+	// Spread of the repetitions of the largest allocations count
+	static void PrintStatistics(Result& result, const TestMatrix& matrix)
 	{
-		return m_size;
+		printf("    Time of a repetition, ms (median [95%% CI]):\n");
+		for (const SizeRange& size : matrix.m_sizes)
+		{
+			printf("        %-7s", size.m_name.c_str());
+			for (int pattern = 0; pattern < PatternsCount; pattern++)
+			{
+				const char* test = GetPatternName(pattern);
+				const std::unordered_map<size_t, SampleStatistics>& points = result.m_statistics[size.m_name][test];
+				auto largest = std::max_element(points.begin(), points.end(),
+					[](const std::pair<const size_t, SampleStatistics>& a, const std::pair<const size_t, SampleStatistics>& b) { return a.first < b.first; });
+				if (largest != points.end())
+				{
+					printf(" %s: %.2f [%.2f, %.2f]", test, largest->second.m_median, largest->second.m_low, largest->second.m_high);
+				}
+			}
+			printf("\n");
+		}
+		printf("\n");
 	}
 
-private:
-	size_t m_size = 0;
-};
-
-template<typename TAllocator>
-class TestCase_MemoryPerformance
-{
-	static float m_globalScore;
-	static float m_globalMemoryOverhead;
-	static float m_globalTime;
-
-public:
-	static Result RunTests()
+	static void PrintLatency(Result& result, const TestMatrix& matrix)
 	{
-		const std::string allocatorName = typeid(TAllocator).name();
+		const double nsPerTick = 1000000000.0 / Platform::GetCycleCounterFrequency();
 
-		Result result(allocatorName);
-		result.m_results["small"] = RunPerformanceTests(1, 32, 20, 1000000);
-		result.m_results["medium"] = RunPerformanceTests(128, 40000, 10, 50000);
-		result.m_results["large"] = RunPerformanceTests(4000000, 80000000, 200, 800);
-		result.m_results["random"] = RunPerformanceTests(1, 16000000000, 900, 25);
+		printf("    Latency, ns (p50 / p99 / p99.9 / max):\n");
+		for (const SizeRange& sizeRange : matrix.m_sizes)
+		{
+			const char* size = sizeRange.m_name.c_str();
+			for (int pattern = 0; pattern < PatternsCount; pattern++)
+			{
+				const char* test = GetPatternName(pattern);
+				const LatencyStats& stats = result.m_latency[size][test];
+				if (stats.m_allocate.GetTotalCount() == 0)
+				{
+					continue;
+				}
 
-		//RunSanityTests();
+				printf("        %-7s %-8s Allocate: %.0f / %.0f / %.0f / %.0f,  Free: %.0f / %.0f / %.0f / %.0f\n", size, test,
+					stats.m_allocate.GetPercentile(50.0) * nsPerTick, stats.m_allocate.GetPercentile(99.0) * nsPerTick,
+					stats.m_allocate.GetPercentile(99.9) * nsPerTick, stats.m_allocate.GetMax() * nsPerTick,
+					stats.m_free.GetPercentile(50.0) * nsPerTick, stats.m_free.GetPercentile(99.0) * nsPerTick,
+					stats.m_free.GetPercentile(99.9) * nsPerTick, stats.m_free.GetMax() * nsPerTick);
+			}
+		}
+		printf("\n");
+	}
 
-		printf("%s\n    Score: %.2f,\n    Total memory overhead: %.2fmb,\n    Total time: %.2fsec\n\n", allocatorName.c_str(), m_globalScore, m_globalMemoryOverhead, m_globalTime);
+	// Overhead of the largest allocations count: the single snapshot the score uses, the peak and the time-weighted average of the timeline
+	static void PrintMemoryTimeline(Result& result, const TestMatrix& matrix)
+	{
+		printf("    Memory overhead, mb (snapshot / peak / average), peak resident, mb:\n");
+		for (const SizeRange& sizeRange : matrix.m_sizes)
+		{
+			const char* size = sizeRange.m_name.c_str();
+			for (int pattern = 0; pattern < PatternsCount; pattern++)
+			{
+				const char* test = GetPatternName(pattern);
+				const std::vector<MemoryTimeline>& timelines = result.m_memory[size][test];
+				if (timelines.empty() || timelines.back().m_samples.empty())
+				{
+					continue;
+				}
 
-		return result;
+				const MemoryTimeline& timeline = timelines.back();
+				float snapshot = 0.0f;
+				for (auto& it : result.m_results[size][test])
+				{
+					snapshot = it.first == timeline.m_requested ? it.second.second : snapshot;
+				}
+
+				printf("        %-7s %-8s %.2f / %.2f / %.2f, %.2f\n", size, test, snapshot,
+					(double)timeline.GetPeakOverhead() / 1048576.0, timeline.GetAverageOverhead() / 1048576.0,
+					(double)timeline.GetPeakResident() / 1048576.0);
+			}
+		}
+		printf("\n");
 	}
 
-	static void RunSanityTests()
+	static void PrintPerfCounters(Result& result, const TestMatrix& matrix)
 	{
-		const std::string allocatorName = typeid(TAllocator).name();
+		bool bAny = false;
+		for (const SizeRange& sizeRange : matrix.m_sizes)
+		{
+			const char* size = sizeRange.m_name.c_str();
+			for (int pattern = 0; pattern < PatternsCount; pattern++)
+			{
+				const char* test = GetPatternName(pattern);
+				const PerfCounterStats& stats = result.m_counters[size][test];
+				if (stats.m_operations == 0)
+				{
+					continue;
+				}
 
-		printf("\n\n%s\n", allocatorName.c_str());
-		printf("Can allocate huge block: %d\n", SanityCanAllocHugeBlock());
-		printf("Is stack based: %d\n", !SanityCheckIsStack());
-		printf("Sanity check passed: %d\n", SanityCheck());
+				if (!bAny)
+				{
+					printf("    Hardware counters per Allocate/Free:\n");
+					bAny = true;
+				}
+
+				printf("        %-7s %-8s", size, test);
+				for (int i = 0; i < Platform::PerfCountersCount; i++)
+				{
+					if (stats.m_bAvailable[i])
+					{
+						printf(" %s: %.2f", Platform::GetPerfCounterName(i), stats.GetPerOperation(i));
+					}
+				}
+				printf("\n");
+			}
+		}
+
+		printf(bAny ? "\n" : "    Hardware counters aren't available\n\n");
 	}
 
-	static TestResult RunPerformanceTests(const size_t MinSize = 1, const size_t MaxSize = 32, const size_t IterationsCount = 10, const size_t AllocationsCount = 1000000)
+	static TestResult RunPerformanceTests(const size_t MinSize = 1, const size_t MaxSize = 32, const size_t IterationsCount = 10, const size_t AllocationsCount = 1000000,
+		[[maybe_unused]] std::unordered_map<std::string, LatencyStats>* latency = nullptr, [[maybe_unused]] std::unordered_map<std::string, std::vector<MemoryTimeline>>* timelines = nullptr,
+		[[maybe_unused]] std::unordered_map<std::string, PerfCounterStats>* counters = nullptr, TestStatistics* statistics = nullptr, unsigned patterns = (1u << PatternsCount) - 1,
+		const SizeDistribution& distribution = SizeDistribution())
 	{
 		std::default_random_engine rd(128648432u);
-		
+
+		SizeDistribution sizes = distribution;
+		sizes.Prepare(MinSize, MaxSize);
+
 		TestResult result;
 
 		const size_t step = AllocationsCount / 5;
@@ -177,72 +360,210 @@ public:
 			size_t totalAllocatedSize = 0;
 			for (size_t i = 0; i < allocCount; ++i)
 			{
-				sizesToAllocate[i] = rd() % MaxSize + MinSize;
+				sizesToAllocate[i] = sizes.Draw(rd);
 				totalAllocatedSize += sizesToAllocate[i];
 			}
 
-			Timer simpleTest;
-			size_t memoryOverhead1 = 0;
+			// per EPattern, the patterns not selected stay untouched
+			Timer tests[PatternsCount];
+			size_t memoryOverheads[PatternsCount] = {};
+			float factors[PatternsCount];
+			LatencyStats* latencies[PatternsCount] = {};
+			// every iteration overwrites the timeline, the last one is kept
+			MemoryTimeline* patternTimelines[PatternsCount] = {};
+			std::vector<double> samples[PatternsCount];
 
-			Timer shuffleTest;
-			size_t memoryOverhead2 = 0;
+			for (int pattern = 0; pattern < PatternsCount; pattern++)
+			{
+				factors[pattern] = 1.0f;
+				if (!(patterns & (1u << pattern)))
+				{
+					continue;
+				}
 
-			Timer randomTest;
-			size_t memoryOverhead3 = 0;
+#ifdef ENABLE_LATENCY_HISTOGRAMS
+				if (latency)
+				{
+					latencies[pattern] = &(*latency)[GetPatternName(pattern)];
+				}
+#endif
 
-			float factorSimple = 1.0f;
-			float factorShuffle = 1.0f;
-			float factorRandom = 1.0f;
+#ifdef ENABLE_MEMORY_TIMELINE
+				if (timelines)
+				{
+					patternTimelines[pattern] = &(*timelines)[GetPatternName(pattern)].emplace_back();
+				}
+#endif
+			}
 
-			for (size_t i = 0; i < IterationsCount; i++)
+#ifdef ENABLE_PERF_COUNTERS
+			Platform::PerfCounterGroup patternCounters[PatternsCount];
+
+			bool bCounters = counters != nullptr;
+			for (int pattern = 0; pattern < PatternsCount; pattern++)
 			{
-				factorSimple = TestPerformanceSimple(sizesToAllocate, simpleTest, memoryOverhead1);
-				factorShuffle = TestPerformanceShuffle(sizesToAllocate, shuffleTest, memoryOverhead2);
-				factorRandom = TestPerformanceRandom(sizesToAllocate, randomTest, memoryOverhead3);
+				bCounters = bCounters && (!(patterns & (1u << pattern)) || patternCounters[pattern].Open());
 			}
 
-			result["simple"][totalAllocatedSize] = { simpleTest.ResultAccumulatedMs(), (float)((double)memoryOverhead1 / 1048576.0) };
-			result["shuffle"][totalAllocatedSize] = { shuffleTest.ResultAccumulatedMs(), (float)((double)memoryOverhead2 / 1048576.0) };
-			result["random"][totalAllocatedSize] = { randomTest.ResultAccumulatedMs(), (float)((double)memoryOverhead3 / 1048576.0) };
+			for (int pattern = 0; pattern < PatternsCount && bCounters; pattern++)
+			{
+				tests[pattern].m_counters = patternCounters[pattern].IsOpen() ? &patternCounters[pattern] : nullptr;
+			}
+#endif
+
+			// every repetition of the step shuffles the same way
+			const uint32_t seed = BENCHMARK_SEED + index;
+
+			for (size_t i = 0; i < BENCHMARK_WARMUP_ITERATIONS; i++)
+			{
+				Timer warmup;
+				size_t warmupOverhead = 0;
+				for (int pattern = 0; pattern < PatternsCount; pattern++)
+				{
+					if (patterns & (1u << pattern))
+					{
+						TestPerformance(pattern, sizesToAllocate, warmup, warmupOverhead, nullptr, nullptr, seed);
+					}
+				}
+			}
 
-			//printf(" %.2f %.2f %.2f \n", factorSimple, factorShuffle, factorRandom);
+			for (size_t i = 0; i < IterationsCount; i++)
+			{
+				for (int pattern = 0; pattern < PatternsCount; pattern++)
+				{
+					if (!(patterns & (1u << pattern)))
+					{
+						continue;
+					}
+
+					const int64_t before = tests[pattern].m_counterAcc;
+					factors[pattern] = TestPerformance(pattern, sizesToAllocate, tests[pattern], memoryOverheads[pattern], latencies[pattern], patternTimelines[pattern], seed);
+					samples[pattern].push_back(tests[pattern].ResultAccumulatedMsSince(before));
+				}
+			}
 
 			float totalAllocatedSizeMb = (float)((double)totalAllocatedSize / 1048576.0);
 
-			m_globalMemoryOverhead += (float)((double)memoryOverhead1 / 1048576.0);
-			m_globalMemoryOverhead += (float)((double)memoryOverhead2 / 1048576.0);
-			m_globalMemoryOverhead += (float)((double)memoryOverhead3 / 1048576.0);
+			for (int pattern = 0; pattern < PatternsCount; pattern++)
+			{
+				if (!(patterns & (1u << pattern)))
+				{
+					continue;
+				}
 
-			m_globalTime += simpleTest.ResultAccumulatedMs() * 0.001f;
-			m_globalTime += shuffleTest.ResultAccumulatedMs() * 0.001f;
-			m_globalTime += randomTest.ResultAccumulatedMs() * 0.001f;
+				const char* name = GetPatternName(pattern);
+				if (statistics)
+				{
+					(*statistics)[name][totalAllocatedSize] = SampleStatistics::Compute(samples[pattern]);
+				}
 
-			//printf("Test effectivenes: %.2f %.2f %.2f\n", factorSimple, factorShuffle, factorRandom);
+#ifdef ENABLE_PERF_COUNTERS
+				if (tests[pattern].m_counters)
+				{
+					// every test does allocCount Allocate and allocCount Free calls
+					(*counters)[name].Add(patternCounters[pattern], 2 * (uint64_t)allocCount * (uint64_t)IterationsCount);
+				}
+#endif
 
-			m_globalScore += factorSimple * CalculateScore((float)result["simple"][totalAllocatedSize].first,
-				result["simple"][totalAllocatedSize].second, (float)index, totalAllocatedSizeMb);
+				const float memoryOverheadMb = (float)((double)memoryOverheads[pattern] / 1048576.0);
+				result[name][totalAllocatedSize] = { tests[pattern].ResultAccumulatedMs(), memoryOverheadMb };
 
-			m_globalScore += factorShuffle * CalculateScore((float)result["shuffle"][totalAllocatedSize].first,
-				result["shuffle"][totalAllocatedSize].second, (float)index, totalAllocatedSizeMb);
+				//printf("Test effectivenes: %s %.2f\n", name, factors[pattern]);
 
-			m_globalScore += factorRandom * CalculateScore((float)result["random"][totalAllocatedSize].first,
-				result["random"][totalAllocatedSize].second, (float)index, totalAllocatedSizeMb);
+				m_globalMemoryOverhead += memoryOverheadMb;
+				m_globalTime += tests[pattern].ResultAccumulatedMs() * 0.001f;
+				// the points under the timer resolution of a small custom range don't score, as in the exported results
+				if (result[name][totalAllocatedSize].first > 0)
+				{
+					m_globalScore += factors[pattern] * CalculateScore((float)result[name][totalAllocatedSize].first,
+						result[name][totalAllocatedSize].second, (float)index, totalAllocatedSizeMb);
+				}
+			}
 		}
 
 		return result;
 	}
 
+	static float TestPerformance(int pattern, const std::vector<size_t>& sizesToAllocate, Timer& timer, size_t& memoryOverhead, LatencyStats* latency,
+		MemoryTimeline* timeline, uint32_t seed)
+	{
+		switch (pattern)
+		{
+		case PatternShuffle:
+			return TestPerformanceShuffle(sizesToAllocate, timer, memoryOverhead, latency, timeline, seed);
+		case PatternRandom:
+			return TestPerformanceRandom(sizesToAllocate, timer, memoryOverhead, latency, timeline, seed);
+		default:
+			return TestPerformanceSimple(sizesToAllocate, timer, memoryOverhead, latency, timeline);
+		}
+	}
+
 	static float CalculateScore(float ms, float memoryOverhead, float step, float allocationSize)
 	{
-		return (float)(((1500.0 * (step / 5.0)) / ms) * (allocationSize / (allocationSize + memoryOverhead)));
+		return ::CalculateScore(ms, memoryOverhead, step, allocationSize);
 	}
 
-	static float TestPerformanceRandom(const std::vector<size_t>& sizesToAllocate, Timer& timer, size_t& memoryOverhead)
+	static inline void* Allocate(TAllocator& allocator, size_t size, size_t alignment, [[maybe_unused]] LatencyStats* latency)
+	{
+#ifdef ENABLE_LATENCY_HISTOGRAMS
+		if (latency)
+		{
+			const uint64_t start = Platform::ReadCycleCounter();
+			void* ptr = allocator.Allocate(size, alignment);
+			latency->m_allocate.Record(Platform::ReadCycleCounter() - start);
+			return ptr;
+		}
+#endif
+		return allocator.Allocate(size, alignment);
+	}
+
+	// size is passed to the allocators with the sized Free (AllocatorTraits.h)
+	static inline void Free(TAllocator& allocator, void* ptr, size_t size, [[maybe_unused]] LatencyStats* latency)
+	{
+#ifdef ENABLE_LATENCY_HISTOGRAMS
+		if (latency)
+		{
+			const uint64_t start = Platform::ReadCycleCounter();
+			FreeBlock(allocator, ptr, size);
+			latency->m_free.Record(Platform::ReadCycleCounter() - start);
+			return;
+		}
+#endif
+		FreeBlock(allocator, ptr, size);
+	}
+
+	// The sizes of the blocks in the order of the pointers shuffled with seed, the same permutation as std::shuffle of the pointers;
+	// only the allocators with the sized Free need them, the others get an empty vector
+	static std::vector<size_t> GetShuffledSizes(const std::vector<size_t>& sizesToAllocate, size_t count, uint32_t seed)
+	{
+		std::vector<size_t> sizes;
+		if constexpr (HasSizedFree<TAllocator>::value)
+		{
+			sizes = sizesToAllocate;
+			std::mt19937 g(seed);
+			std::shuffle(sizes.begin(), sizes.begin() + count, g);
+		}
+		return sizes;
+	}
+
+	static inline size_t GetSize(const std::vector<size_t>& sizes, size_t i)
+	{
+		return sizes.empty() ? 0 : sizes[i];
+	}
+
+	static float TestPerformanceRandom(const std::vector<size_t>& sizesToAllocate, Timer& timer, size_t& memoryOverhead, LatencyStats* latency = nullptr,
+		MemoryTimeline* timeline = nullptr, uint32_t seed = BENCHMARK_SEED)
 	{
 		size_t totalShouldAllocate = 0;
 		size_t totalAllocated = 0;
 		std::vector<void*> ptrs;
 		ptrs.resize(sizesToAllocate.size());
+		MemorySampler sampler;
+		if (timeline)
+		{
+			sampler.Start(*timeline);
+		}
+
 		size_t beforeTest = GetTotalUsedVirtualMemory();
 
 		for (size_t i = 0; i < sizesToAllocate.size(); ++i)
@@ -257,7 +578,7 @@ public:
 			size_t border = sizesToAllocate.size() / 4;
 			for (size_t i = 0; i < border * 2; ++i)
 			{
-				ptrs[i] = allocator.Allocate(sizesToAllocate[i], 1);
+				ptrs[i] = Allocate(allocator, sizesToAllocate[i], 1, latency);
 
 				totalShouldAllocate += sizesToAllocate[i];
 				if (ptrs[i])
@@ -267,21 +588,21 @@ public:
 			}
 			timer.Stop();
 
-			std::random_device rd;
-			std::mt19937 g(rd());
+			std::mt19937 g(seed);
 			std::shuffle(ptrs.begin(), ptrs.end() - (size_t)border * 3, g);
+			const std::vector<size_t> sizes = GetShuffledSizes(sizesToAllocate, ptrs.size() - (size_t)border * 3, seed);
 
 			timer.Start();
 
 			for (size_t i = 0; i < border; ++i)
 			{
-				allocator.Free(ptrs[i]);
+				Free(allocator, ptrs[i], GetSize(sizes, i), latency);
 				ptrs[i] = nullptr;
 			}
 
 			for (size_t i = border * 2; i < sizesToAllocate.size(); ++i)
 			{
-				ptrs[i] = allocator.Allocate(sizesToAllocate[i], 1);
+				ptrs[i] = Allocate(allocator, sizesToAllocate[i], 1, latency);
 				totalShouldAllocate += sizesToAllocate[i];
 
 				if (ptrs[i])
@@ -298,15 +619,23 @@ public:
 
 			for (size_t i = border; i < sizesToAllocate.size(); ++i)
 			{
-				allocator.Free(ptrs[i]);
+				Free(allocator, ptrs[i], GetSize(sizes, i), latency);
 			}
 		}
 		timer.Stop();
 
+		if (timeline)
+		{
+			sampler.Stop();
+			timeline->m_requested = totalAllocated;
+			timeline->m_snapshotOverhead = memoryOverhead;
+		}
+
 		return (float)((double)totalAllocated / (double)totalShouldAllocate);
 	}
 
-	static float TestPerformanceShuffle(const std::vector<size_t>& sizesToAllocate, Timer& timer, size_t& memoryOverhead)
+	static float TestPerformanceShuffle(const std::vector<size_t>& sizesToAllocate, Timer& timer, size_t& memoryOverhead, LatencyStats* latency = nullptr,
+		MemoryTimeline* timeline = nullptr, uint32_t seed = BENCHMARK_SEED)
 	{
 		size_t totalShouldAllocate = 0;
 		size_t totalAllocated = 0;
@@ -318,13 +647,19 @@ public:
 		}
 		bool bSuccess = true;
 
+		MemorySampler sampler;
+		if (timeline)
+		{
+			sampler.Start(*timeline);
+		}
+
 		size_t beforeTest = GetTotalUsedVirtualMemory();
 		timer.Start();
 		{
 			TAllocator allocator;
 			for (size_t i = 0; i < sizesToAllocate.size(); ++i)
 			{
-				ptrs[i] = allocator.Allocate(sizesToAllocate[i], 4);
+				ptrs[i] = Allocate(allocator, sizesToAllocate[i], 4, latency);
 
 				totalShouldAllocate += sizesToAllocate[i];
 				if (ptrs[i])
@@ -340,22 +675,30 @@ public:
 				memoryOverhead = GetTotalUsedVirtualMemory() - beforeTest - totalAllocated;
 			}
 
-			std::random_device rd;
-			std::mt19937 g(rd());
+			std::mt19937 g(seed);
 			std::shuffle(ptrs.begin(), ptrs.end(), g);
+			const std::vector<size_t> sizes = GetShuffledSizes(sizesToAllocate, ptrs.size(), seed);
 
 			timer.Start();
 			for (size_t i = 0; i < sizesToAllocate.size(); ++i)
 			{
-				allocator.Free(ptrs[i]);
+				Free(allocator, ptrs[i], GetSize(sizes, i), latency);
 			}
 		}
 		timer.Stop();
 
+		if (timeline)
+		{
+			sampler.Stop();
+			timeline->m_requested = totalAllocated;
+			timeline->m_snapshotOverhead = memoryOverhead;
+		}
+
 		return (float)((double)totalAllocated / (double)totalShouldAllocate);
 	}
 
-	static float TestPerformanceSimple(const std::vector<size_t>& sizesToAllocate, Timer& timer, size_t& memoryOverhead)
+	static float TestPerformanceSimple(const std::vector<size_t>& sizesToAllocate, Timer& timer, size_t& memoryOverhead, LatencyStats* latency = nullptr,
+		MemoryTimeline* timeline = nullptr)
 	{
 		size_t totalShouldAllocate = 0;
 		size_t totalAllocated = 0;
@@ -367,6 +710,12 @@ public:
 			ptrs[i] = nullptr;
 		}
 		float factor = 1.0f;
+		MemorySampler sampler;
+		if (timeline)
+		{
+			sampler.Start(*timeline);
+		}
+
 		size_t beforeTest = GetTotalUsedVirtualMemory();
 
 		timer.Start();
@@ -375,7 +724,7 @@ public:
 
 			for (size_t i = 0; i < sizesToAllocate.size(); ++i)
 			{
-				ptrs[i] = allocator.Allocate(sizesToAllocate[i], 1);
+				ptrs[i] = Allocate(allocator, sizesToAllocate[i], 1, latency);
 
 				if (ptrs[i])
 				{
@@ -395,11 +744,18 @@ public:
 			timer.Start();
 			for (size_t i = 0; i < sizesToAllocate.size(); ++i)
 			{
-				allocator.Free(ptrs[i]);
+				Free(allocator, ptrs[i], sizesToAllocate[i], latency);
 			}
 		}
 		timer.Stop();
 
+		if (timeline)
+		{
+			sampler.Stop();
+			timeline->m_requested = totalAllocated;
+			timeline->m_snapshotOverhead = memoryOverhead;
+		}
+
 		return (float)((double)totalAllocated / (double)totalShouldAllocate);
 	}
 
@@ -518,252 +874,324 @@ float TestCase_MemoryPerformance<TAllocator>::m_globalMemoryOverhead = 0.0f;
 template<typename TAllocator>
 float TestCase_MemoryPerformance<TAllocator>::m_globalTime = 0.0f;
 
-std::string GetJsData(std::string allocSize, std::string testName, std::vector<Result> results, bool bTime)
+template<typename TAllocator>
+void RunAllocatorTests(std::vector<Result>& results, const TestMatrix& matrix, [[maybe_unused]] bool bPerThreadInstances = true)
+{
+	{
+#ifdef BENCHMARK_PIN_CPU
+		// released before the multithreaded tests, their threads would inherit it
+		Platform::ScopedCpuPin pin(BENCHMARK_PIN_CPU);
+#endif
+#ifdef ENABLE_PROCESS_ISOLATION
+		results.push_back(TestCase_MemoryPerformance<TAllocator>::RunIsolatedTests(matrix, ISOLATION_JOBS));
+#else
+		results.push_back(TestCase_MemoryPerformance<TAllocator>::RunTests(matrix));
+#endif
+	}
+
+#ifdef ENABLE_REALLOCATE_TESTS
+	TestCase_Reallocate<TAllocator>::RunTests(results.back());
+#endif
+
+#ifdef ENABLE_BATCH_TESTS
+	TestCase_Batch<TAllocator>::RunTests(results.back());
+#endif
+
+#ifdef ENABLE_CONTAINER_TESTS
+	TestCase_Containers<TAllocator>::RunTests(results.back(), BENCHMARK_SEED);
+#endif
+
+#ifdef ENABLE_PMR_TESTS
+	TestCase_Pmr<TAllocator>::RunTests(results.back(), BENCHMARK_SEED);
+#endif
+
+#ifdef ENABLE_ALIGNMENT_TESTS
+	TestCase_Alignment<TAllocator>::RunTests(results.back(), BENCHMARK_SEED);
+#endif
+
+#ifdef ENABLE_FRAGMENTATION_ANALYSIS
+	TestCase_Fragmentation<TAllocator>::RunTests(results.back(), matrix, BENCHMARK_SEED);
+#endif
+
+#ifdef ENABLE_SCALING_TESTS
+	TestCase_ThreadScaling<TAllocator>::RunTests(results.back(), bPerThreadInstances);
+#endif
+
+#ifdef ENABLE_CROSS_THREAD_TESTS
+	TestCase_CrossThreadFree<TAllocator>::RunTests(results.back(), matrix, bPerThreadInstances);
+#endif
+
+#ifdef ENABLE_STRESS_SUITE
+	TestCase_StressSuite<TAllocator>::RunTests(results.back(), bPerThreadInstances);
+#endif
+
+#ifdef REPLAY_TRACE_FILE
+	TestCase_TraceReplay<TAllocator>::RunTests(results.back(), REPLAY_TRACE_FILE);
+#endif
+}
+
+// Runs before all the other tests of all the allocators, see TestCase_Churn
+template<typename TAllocator>
+void RunChurnTests(std::vector<Result>& results, const TestMatrix& matrix)
+{
+#ifdef BENCHMARK_PIN_CPU
+	Platform::ScopedCpuPin pin(BENCHMARK_PIN_CPU);
+#endif
+	results.push_back(TestCase_Churn<TAllocator>::RunIsolatedTests(matrix, BENCHMARK_SEED));
+}
+
+struct AllocatorEntry
+{
+	const char* m_name;
+	void (*m_run)(std::vector<Result>& results, const TestMatrix& matrix);
+	void (*m_runChurn)(std::vector<Result>& results, const TestMatrix& matrix);
+};
+
+// Allocators selectable with --allocators, in the order they run
+const std::vector<AllocatorEntry>& GetAllocators()
+{
+	static const std::vector<AllocatorEntry> allocators =
+	{
+		{ "DefaultMalloc", [](std::vector<Result>& results, const TestMatrix& matrix) { RunAllocatorTests<DefaultMallocAllocator>(results, matrix); },
+			[](std::vector<Result>& results, const TestMatrix& matrix) { RunChurnTests<DefaultMallocAllocator>(results, matrix); } },
+		// Keeps its state in function-local statics, so separate instances can't be used from different threads
+		{ "AlexeiMikhailov", [](std::vector<Result>& results, const TestMatrix& matrix) { RunAllocatorTests<AlexeiMikhailov::Allocator>(results, matrix, false); },
+			[](std::vector<Result>& results, const TestMatrix& matrix) { RunChurnTests<AlexeiMikhailov::Allocator>(results, matrix); } },
+		{ "OlegApanasik", [](std::vector<Result>& results, const TestMatrix& matrix) { RunAllocatorTests<OlegApanasik::TMemoryAllocator>(results, matrix); },
+			[](std::vector<Result>& results, const TestMatrix& matrix) { RunChurnTests<OlegApanasik::TMemoryAllocator>(results, matrix); } },
+		{ "DaniilPavlenko", [](std::vector<Result>& results, const TestMatrix& matrix) { RunAllocatorTests<DaniilPavlenko::FastAllocator>(results, matrix); },
+			[](std::vector<Result>& results, const TestMatrix& matrix) { RunChurnTests<DaniilPavlenko::FastAllocator>(results, matrix); } },
+		{ "AntonShatalov", [](std::vector<Result>& results, const TestMatrix& matrix) { RunAllocatorTests<AntonShatalov::Ololokator>(results, matrix); },
+			[](std::vector<Result>& results, const TestMatrix& matrix) { RunChurnTests<AntonShatalov::Ololokator>(results, matrix); } },
+		{ "AlexeyAntropov", [](std::vector<Result>& results, const TestMatrix& matrix) { RunAllocatorTests<AlexeyAntropov::Sailor::Memory::HeapAllocator>(results, matrix); },
+			[](std::vector<Result>& results, const TestMatrix& matrix) { RunChurnTests<AlexeyAntropov::Sailor::Memory::HeapAllocator>(results, matrix); } },
+		{ "DenisPerevalov", [](std::vector<Result>& results, const TestMatrix& matrix) { RunAllocatorTests<DenisPerevalov::Oneshotlocator>(results, matrix); },
+			[](std::vector<Result>& results, const TestMatrix& matrix) { RunChurnTests<DenisPerevalov::Oneshotlocator>(results, matrix); } },
+		// Size classes without block headers, freed with the sized Free by the harness
+		{ "Headerless", [](std::vector<Result>& results, const TestMatrix& matrix) { RunAllocatorTests<HeaderlessAllocator>(results, matrix); },
+			[](std::vector<Result>& results, const TestMatrix& matrix) { RunChurnTests<HeaderlessAllocator>(results, matrix); } },
+		// Routes the sizes to DenisPerevalov, AntonShatalov and mmap, frees by address range
+		{ "Hybrid", [](std::vector<Result>& results, const TestMatrix& matrix) { RunAllocatorTests<HybridContestAllocator>(results, matrix); },
+			[](std::vector<Result>& results, const TestMatrix& matrix) { RunChurnTests<HybridContestAllocator>(results, matrix); } },
+	};
+	return allocators;
+}
+
+// Every sample of every timeline as "allocator,size,test,requested_mb,ms,committed_mb,resident_mb", false if there are none
+bool WriteMemoryTimelineCsv(std::vector<Result>& results, const char* path)
 {
-	std::string res;
+	std::string csv = "allocator,size,test,requested_mb,ms,committed_mb,resident_mb\n";
+	bool bAny = false;
 
-	res += "[";
-	res += "['Total allocated size'";
 	for (auto& result : results)
 	{
-		res += ",'" + result.m_allocator + "'";
+		for (auto& size : result.m_memory)
+		{
+			for (auto& test : size.second)
+			{
+				for (const MemoryTimeline& timeline : test.second)
+				{
+					for (const MemorySample& sample : timeline.m_samples)
+					{
+						char buffer[256];
+						snprintf(buffer, sizeof(buffer), ",%.3f,%.3f,%.3f,%.3f\n", (double)timeline.m_requested / 1048576.0,
+							sample.m_ms, (double)sample.m_committed / 1048576.0, (double)sample.m_resident / 1048576.0);
+						csv += "\"" + result.m_allocator + "\"," + size.first + "," + test.first + buffer;
+						bAny = true;
+					}
+				}
+			}
+		}
 	}
-	res += "]";
 
-	for (auto& r : results[0].m_results[allocSize][testName])
+	if (!bAny)
 	{
-		char startString[1024];
-		snprintf(startString, sizeof(startString), ",\n['%.2fmb'", (float)((double)(r.first / 1024) / 1024.0));
-		res += std::string(startString);
+		return false;
+	}
 
-		for (auto& result : results)
+	std::ofstream file{ path };
+	file << csv;
+	return true;
+}
+
+// Every window of every churn run as "allocator,size,lifetime,steps,mops,live_mb,footprint_mb,overhead_mb", false if there are none
+bool WriteChurnCsv(std::vector<Result>& results, const char* path)
+{
+	std::string csv = "allocator,size,lifetime,steps,mops,live_mb,footprint_mb,overhead_mb\n";
+	bool bAny = false;
+
+	for (auto& result : results)
+	{
+		for (auto& size : result.m_churn)
 		{
-			char buffer[1024];
-			if (bTime)
+			for (auto& lifetime : size.second)
 			{
-				snprintf(buffer, sizeof(buffer), ",%llu", result.m_results[allocSize][testName][r.first].first);
+				for (const ChurnPoint& point : lifetime.second)
+				{
+					char buffer[256];
+					snprintf(buffer, sizeof(buffer), ",%zu,%.3f,%.3f,%.3f,%.3f\n", point.m_steps, point.m_opsPerSec * 0.000001,
+						(double)point.m_liveBytes / 1048576.0, (double)point.m_footprint / 1048576.0, (double)point.GetOverhead() / 1048576.0);
+					csv += "\"" + result.m_allocator + "\"," + size.first + "," + lifetime.first + buffer;
+					bAny = true;
+				}
 			}
-			else
+		}
+	}
+
+	if (!bAny)
+	{
+		return false;
+	}
+
+	std::ofstream file{ path };
+	file << csv;
+	return true;
+}
+
+// Heap maps of every allocator and size range analyzed by TestCase_Fragmentation, false if there are none
+bool WriteHeapMaps(std::vector<Result>& results, const char* path)
+{
+	std::string text;
+	for (auto& result : results)
+	{
+		for (auto& size : result.m_fragmentation)
+		{
+			text += result.m_allocator + " " + size.first + ":\n";
+			for (const std::string& map : size.second.m_heapMaps)
 			{
-				snprintf(buffer, sizeof(buffer), ",%.2f", result.m_results[allocSize][testName][r.first].second);
+				text += "    " + map + "\n";
 			}
-			res += std::string(buffer);
+			text += "\n";
 		}
-
-		res += "]";
 	}
 
-	res += "]";
+	if (text.empty())
+	{
+		return false;
+	}
 
-	return res;
+	std::ofstream file{ path };
+	file << text;
+	return true;
 }
 
-int main()
+int main(int argc, char** argv)
 {
+	TestMatrix matrix = TestMatrix::GetDefault();
+	std::string error;
+	if (!ParseTestMatrix(argc, argv, matrix, error))
+	{
+		printf("%s\n\n%s", error.c_str(), GetTestMatrixUsage());
+		return 2;
+	}
+
+	if (matrix.m_bHelp)
+	{
+		printf("Usage: %s [options]\n\n%s", argv[0], GetTestMatrixUsage());
+		return 0;
+	}
+
+	if (matrix.m_bListAllocators)
+	{
+		printf("Allocators:\n");
+		for (const AllocatorEntry& allocator : GetAllocators())
+		{
+			printf("    %s\n", allocator.m_name);
+		}
+
+		printf("Size ranges:\n");
+		for (const SizeRange& size : matrix.m_sizes)
+		{
+			printf("    %s:%zu:%zu:%zu:%zu %s\n", size.m_name.c_str(), size.m_minSize, size.m_maxSize, size.m_allocations, matrix.GetIterations(size),
+				size.m_distribution.GetType() == SizeUniform ? "uniform" : size.m_distribution.GetDescription().c_str());
+		}
+		return 0;
+	}
+
+	for (const std::string& name : matrix.m_allocators)
+	{
+		bool bFound = false;
+		for (const AllocatorEntry& allocator : GetAllocators())
+		{
+			bFound = bFound || TestMatrix::EqualsNoCase(name, allocator.m_name);
+		}
+
+		if (!bFound)
+		{
+			printf("Unknown allocator \"%s\", see --list\n", name.c_str());
+			return 2;
+		}
+	}
+
 	printf("Starting...\n");
 
+	// the churn of every allocator runs first, its child processes are forked before the other tests grow the driver heap
+	std::vector<Result> churnResults;
+	for (const AllocatorEntry& allocator : GetAllocators())
+	{
+		if (matrix.m_churnLifetimes && matrix.HasAllocator(allocator.m_name))
+		{
+			allocator.m_runChurn(churnResults, matrix);
+		}
+	}
+
 	std::vector<Result> results;
+	for (const AllocatorEntry& allocator : GetAllocators())
+	{
+		if (matrix.HasAllocator(allocator.m_name))
+		{
+			allocator.m_run(results, matrix);
+		}
+	}
+
+	for (const Result& churn : churnResults)
+	{
+		for (Result& result : results)
+		{
+			if (result.m_allocator == churn.m_allocator)
+			{
+				DeserializeResult(SerializeResult(churn), result);
+			}
+		}
+	}
+
+	WriteMemoryTimelineCsv(results, "memory_timeline.csv");
+	WriteChurnCsv(results, "churn.csv");
+	WriteHeapMaps(results, "heap_map.txt");
+
+	RunEnvironment environment = GetRunEnvironment();
+	std::string modes;
+#ifdef ENABLE_LATENCY_HISTOGRAMS
+	modes += " latency";
+#endif
+#ifdef ENABLE_MEMORY_TIMELINE
+	modes += " memory-timeline";
+#endif
+#ifdef ENABLE_PERF_COUNTERS
+	modes += " perf-counters";
+#endif
+	// the instrumented modes slow the tests down, their timings aren't comparable with the plain runs
+	environment.emplace_back("modes", modes.empty() ? "plain" : modes.substr(1));
+
+	std::string sizes;
+	for (const SizeRange& size : matrix.m_sizes)
+	{
+		sizes += " " + size.m_name + ":" + std::to_string(size.m_minSize) + ":" + std::to_string(size.m_maxSize) + ":" +
+			std::to_string(size.m_allocations) + ":" + std::to_string(matrix.GetIterations(size));
+		sizes += size.m_distribution.GetType() == SizeUniform ? std::string() : "/" + size.m_distribution.GetDescription();
+	}
+	environment.emplace_back("sizes", sizes.substr(1));
+
+	std::string patterns;
+	for (int pattern = 0; pattern < PatternsCount; pattern++)
+	{
+		patterns += matrix.HasPattern(pattern) ? std::string(" ") + GetPatternName(pattern) : std::string();
+	}
+	environment.emplace_back("patterns", patterns.substr(1));
 
-	results.push_back(TestCase_MemoryPerformance<DefaultMallocAllocator>::RunTests());
-	results.push_back(TestCase_MemoryPerformance<AlexeiMikhailov::Allocator>::RunTests());
-	results.push_back(TestCase_MemoryPerformance<OlegApanasik::TMemoryAllocator>::RunTests());
-	results.push_back(TestCase_MemoryPerformance<DaniilPavlenko::FastAllocator>::RunTests());
-	results.push_back(TestCase_MemoryPerformance<AntonShatalov::Ololokator>::RunTests());
-	results.push_back(TestCase_MemoryPerformance<AlexeyAntropov::Sailor::Memory::HeapAllocator>::RunTests());
-	results.push_back(TestCase_MemoryPerformance<DenisPerevalov::Oneshotlocator>::RunTests());
-
-	std::string emplace;
-
-	emplace += "var smallSimple = " + GetJsData("small", "simple", results, true) + ";\n";
-	emplace += "var smallShuffle = " + GetJsData("small", "shuffle", results, true) + ";\n";
-	emplace += "var smallRandom = " + GetJsData("small", "random", results, true) + ";\n";
-
-	emplace += "var mediumSimple = " + GetJsData("medium", "simple", results, true) + ";\n";
-	emplace += "var mediumShuffle = " + GetJsData("medium", "shuffle", results, true) + ";\n";
-	emplace += "var mediumRandom = " + GetJsData("medium", "random", results, true) + ";\n";
-
-	emplace += "var largeSimple = " + GetJsData("large", "simple", results, true) + ";\n";
-	emplace += "var largeShuffle = " + GetJsData("large", "shuffle", results, true) + ";\n";
-	emplace += "var largeRandom = " + GetJsData("large", "random", results, true) + ";\n";
-
-	emplace += "var randomSimple = " + GetJsData("random", "simple", results, true) + ";\n";
-	emplace += "var randomShuffle = " + GetJsData("random", "shuffle", results, true) + ";\n";
-	emplace += "var randomRandom = " + GetJsData("random", "random", results, true) + ";\n";
-
-	emplace += "var smallSimpleMemory = " + GetJsData("small", "simple", results, false) + ";\n";
-	emplace += "var smallShuffleMemory = " + GetJsData("small", "shuffle", results, false) + ";\n";
-	emplace += "var smallRandomMemory = " + GetJsData("small", "random", results, false) + ";\n";
-
-	emplace += "var mediumSimpleMemory = " + GetJsData("medium", "simple", results, false) + ";\n";
-	emplace += "var mediumShuffleMemory = " + GetJsData("medium", "shuffle", results, false) + ";\n";
-	emplace += "var mediumRandomMemory = " + GetJsData("medium", "random", results, false) + ";\n";
-
-	emplace += "var largeSimpleMemory = " + GetJsData("large", "simple", results, false) + ";\n";
-	emplace += "var largeShuffleMemory = " + GetJsData("large", "shuffle", results, false) + ";\n";
-	emplace += "var largeRandomMemory = " + GetJsData("large", "random", results, false) + ";\n";
-
-	emplace += "var randomSimpleMemory = " + GetJsData("random", "simple", results, false) + ";\n";
-	emplace += "var randomShuffleMemory = " + GetJsData("random", "shuffle", results, false) + ";\n";
-	emplace += "var randomRandomMemory = " + GetJsData("random", "random", results, false) + ";\n";
-
-	std::string html =
-		"<!DOCTYPE html>\n"
-		"<html>\n"
-		"<head>\n"
-		"<meta charset = \"utf-8\">\n"
-		"<title>Results</title>\n"
-		"<script src = \"https://www.google.com/jsapi\"></script>\n"
-		"<script>\n";
-
-	html += emplace;
-	html +=
-		"  google.load(\"visualization\", \"1\", {packages:[\"corechart\"]});"
-		"  google.setOnLoadCallback(drawCharts);"
-		"  function to_float(str_mb) {"
-		"     return parseFloat(str_mb.substring(0, str_mb.length - 2));"
-		"  }"
-		"	function d_sort(d) {"
-		"  d.sort(function(x, y) {"
-		"      let a = to_float(x[0]);"
-		"      let b = to_float(y[0]);"
-		"      if (a < b) return -1;"
-		"      if (a > b) return 1;"
-		"      return 0;"
-		"  });"
-		"  return d;"
-		"}"
-		"function drawChart(d, div_id, title) {"
-		"  var data = google.visualization.arrayToDataTable(d_sort(d));"
-		"  var options = {"
-		"      title: title,"
-		"      hAxis: {title: 'Total allocated'},"
-		"      vAxis: {title: 'Ms'}"
-		"  };"
-		"  var chart = new google.visualization.AreaChart(document.getElementById(div_id));"
-		"  chart.draw(data, options);"
-		"}"
-		"function drawBars(d, div_id, title) {"
-		"var data = google.visualization.arrayToDataTable(d_sort(d));"
-		"var options = {"
-		"	title: title,"
-		"	hAxis : {title: 'Total allocated'},"
-		"	vAxis : {title: 'Mb'}"
-		"};"
-		"var chart = new google.visualization.ColumnChart(document.getElementById(div_id));"
-		"chart.draw(data, options);"
-		"}"
-		"  function drawCharts() {"
-		"   drawChart(smallSimple,\"smallSimple\", \"Simple consumed time\");"
-		"   drawChart(smallShuffle,\"smallShuffle\", \"Shuffle consumed time\");"
-		"   drawChart(smallRandom, \"smallRandom\", \"Random consumed time\");"
-		"   drawChart(mediumSimple,\"mediumSimple\", \"Simple consumed time\");"
-		"   drawChart(mediumShuffle,\"mediumShuffle\", \"Shuffle consumed time\");"
-		"   drawChart(mediumRandom,\"mediumRandom\", \"Random consumed time\");"
-		"   drawChart(largeSimple, \"largeSimple\",  \"Simple consumed time\");"
-		"   drawChart(largeShuffle,\"largeShuffle\", \"Shuffle consumed time\");"
-		"   drawChart(largeRandom, \"largeRandom\",  \"Random consumed time\");"
-		"   drawChart(randomSimple, \"randomSimple\", \"Simple consumed time\");"
-		"   drawChart(randomShuffle,\"randomShuffle\",\"Shuffle consumed time\");"
-		"   drawChart(randomRandom, \"randomRandom\", \"Random consumed time\");"
-		"	drawBars(smallSimpleMemory, \"smallSimpleMemory\", \"Simple memory overhead\");"
-		"	drawBars(smallShuffleMemory, \"smallShuffleMemory\", \"Shuffle memory overhead\");"
-		"	drawBars(smallRandomMemory, \"smallRandomMemory\", \"Random memory overhead\");"
-		"	drawBars(mediumSimpleMemory, \"mediumSimpleMemory\", \"Simple memory overhead\");"
-		"	drawBars(mediumShuffleMemory, \"mediumShuffleMemory\", \"Shuffle memory overhead\");"
-		"	drawBars(mediumRandomMemory, \"mediumRandomMemory\", \"Random memory overhead\");"
-		"	drawBars(largeSimpleMemory, \"largeSimpleMemory\", \"Simple memory overhead\");"
-		"	drawBars(largeShuffleMemory, \"largeShuffleMemory\", \"Shuffle memory overhead\");"
-		"	drawBars(largeRandomMemory, \"largeRandomMemory\", \"Random memory overhead\");"
-		"	drawBars(randomSimpleMemory, \"randomSimpleMemory\", \"Simple memory overhead\");"
-		"	drawBars(randomShuffleMemory, \"randomShuffleMemory\", \"Shuffle memory overhead\");"
-		"	drawBars(randomRandomMemory, \"randomRandomMemory\", \"Random memory overhead\");"
-		"   }"
-		" </script>\n"
-		"<style>"
-		".container {"
-		"    display: flex;"
-		"}"
-		".timegraph {"
-		"    flex: 1;"
-		"    width: 50%;"
-		"    padding: 5px;"
-		"    margin: 5px;"
-		"    height: 200px;"
-		"}"
-		".memgraph {"
-		"    flex: 1;"
-		"    width: 40%;"
-		"    padding: 5px;"
-		"    margin: 5px;"
-		"    height: 200px;"
-		"}"
-		"}"
-		"</style>"
-		"</head>\n"
-		"<body>\n"
-		"<hr/>\n"
-		"<h2>Small allocations [1,32] bytes</h2>\n"
-		"<div class=\"container\">"
-		"<div id=\"smallSimple\" class=\"timegraph\"></div>"
-		"<div id=\"smallSimpleMemory\" class=\"memgraph\"></div>"
-		"</div>"
-		"<div class=\"container\">"
-		"<div id=\"smallShuffle\" class=\"timegraph\"></div>"
-		"<div id=\"smallShuffleMemory\" class=\"memgraph\"></div>"
-		"</div>"
-		"<div class=\"container\">"
-		"<div id=\"smallRandom\" class=\"timegraph\"></div>"
-		"<div id=\"smallRandomMemory\" class=\"memgraph\"></div>"
-		"</div>"
-		"<hr/>"
-		"<h2>Medium allocations [128,40000] bytes</h2>"
-		"<div class=\"container\">"
-		"<div id=\"mediumSimple\" class=\"timegraph\"></div>"
-		"<div id=\"mediumSimpleMemory\" class=\"memgraph\"></div>"
-		"</div>"
-		"<div class=\"container\">"
-		"<div id=\"mediumShuffle\" class=\"timegraph\"></div>"
-		"<div id=\"mediumShuffleMemory\" class=\"memgraph\"></div>"
-		"</div>"
-		"<div class=\"container\">"
-		"<div id=\"mediumRandom\" class=\"timegraph\"></div>"
-		"<div id=\"mediumRandomMemory\" class=\"memgraph\"></div>"
-		"</div>"
-		"<hr/>"
-		"<h2>Large allocations [4000000,800000000] bytes</h2>"
-		"<div class=\"container\">"
-		"<div id=\"largeSimple\" class=\"timegraph\"></div>"
-		"<div id=\"largeSimpleMemory\" class=\"memgraph\"></div>"
-		"</div>"
-		"<div class=\"container\">"
-		"<div id=\"largeShuffle\" class=\"timegraph\"></div>"
-		"<div id=\"largeShuffleMemory\" class=\"memgraph\"></div>"
-		"</div>"
-		"<div class=\"container\">"
-		"<div id=\"largeRandom\" class=\"timegraph\"></div>"
-		"<div id=\"largeRandomMemory\" class=\"memgraph\"></div>"
-		"</div>"
-		"<hr/>"
-		"<h2>Random allocations</h2>"
-		"<div class=\"container\">"
-		"<div id=\"randomSimple\" class=\"timegraph\"></div>"
-		"<div id=\"randomSimpleMemory\" class=\"memgraph\"></div>"
-		"</div>"
-		"<div class=\"container\">"
-		"<div id=\"randomShuffle\" class=\"timegraph\"></div>"
-		"<div id=\"randomShuffleMemory\" class=\"memgraph\"></div>"
-		"</div>"
-		"<div class=\"container\">"
-		"<div id=\"randomRandom\" class=\"timegraph\"></div>"
-		"<div id=\"randomRandomMemory\" class=\"memgraph\"></div>"
-		"</div>"
-		"<hr/>\n"
-		"</body>\n"
-		"</html>\n";
-
-	std::ofstream htmlResult{ "results.html" };
-	htmlResult << html;
-	htmlResult.close();
+	WriteHtmlReport(results, matrix, environment, "results.html");
+	WriteResultsJson(results, environment, "results.json");
+	WriteResultsCsv(results, environment, "results.csv");
 
 	return 0;
 }
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "Platform.h"
+
+// Memory footprint of the process sampled during a test by MemorySampler.
+// Both counters are stored above the baseline taken before the test, so a sample is the footprint of the test itself.
+struct MemorySample
+{
+	double m_ms = 0.0;
+	size_t m_committed = 0;
+	size_t m_resident = 0;
+};
+
+struct MemoryTimeline
+{
+	std::vector<MemorySample> m_samples;
+	// Bytes the test asked the allocator for, the overhead is the footprint above them
+	size_t m_requested = 0;
+	// Overhead the test measured itself, a short peak can fall between two samples
+	size_t m_snapshotOverhead = 0;
+
+	size_t GetPeakCommitted() const
+	{
+		size_t peak = 0;
+		for (const MemorySample& sample : m_samples)
+		{
+			peak = (std::max)(peak, sample.m_committed);
+		}
+		return peak;
+	}
+
+	size_t GetPeakResident() const
+	{
+		size_t peak = 0;
+		for (const MemorySample& sample : m_samples)
+		{
+			peak = (std::max)(peak, sample.m_resident);
+		}
+		return peak;
+	}
+
+	size_t GetPeakOverhead() const
+	{
+		const size_t peak = GetPeakCommitted();
+		return (std::max)(peak > m_requested ? peak - m_requested : 0, m_snapshotOverhead);
+	}
+
+	// Every sample holds until the next one, the samples below m_requested count as no overhead
+	double GetAverageOverhead() const
+	{
+		if (m_samples.size() < 2)
+		{
+			return m_samples.empty() ? 0.0 : (double)GetPeakOverhead();
+		}
+
+		double weighted = 0.0;
+		for (size_t i = 0; i + 1 < m_samples.size(); i++)
+		{
+			const MemorySample& sample = m_samples[i];
+			const size_t overhead = sample.m_committed > m_requested ? sample.m_committed - m_requested : 0;
+			weighted += (double)overhead * (m_samples[i + 1].m_ms - sample.m_ms);
+		}
+
+		const double duration = m_samples.back().m_ms - m_samples.front().m_ms;
+		return duration > 0.0 ? weighted / duration : 0.0;
+	}
+};
+
+// Background thread recording the committed and private resident memory of the process at a fixed interval.
+// The procfs reads take a core while the test runs, so the timings with the sampler on aren't comparable with the scores.
+class MemorySampler
+{
+public:
+	static const int DEFAULT_INTERVAL_US = 1000;
+	// A minute of samples at the default interval, so the sampler doesn't allocate while the test runs
+	static const size_t RESERVED_SAMPLES = 65536;
+
+	MemorySampler(int intervalUs = DEFAULT_INTERVAL_US) : m_intervalUs(intervalUs) {}
+
+	MemorySampler(const MemorySampler&) = delete;
+	MemorySampler& operator=(const MemorySampler&) = delete;
+
+	~MemorySampler()
+	{
+		Stop();
+	}
+
+	// The baseline is taken after the thread is started, its stack and the samples buffer aren't in the footprint
+	void Start(MemoryTimeline& timeline)
+	{
+		Stop();
+
+		m_timeline = &timeline;
+		m_timeline->m_samples.clear();
+		m_timeline->m_samples.reserve(RESERVED_SAMPLES);
+
+		m_bRunning.store(true);
+		m_bStarted.store(false);
+		m_thread = std::thread([this]()
+			{
+				while (!m_bStarted.load(std::memory_order_acquire))
+				{
+					std::this_thread::yield();
+				}
+
+				while (m_bRunning.load(std::memory_order_relaxed))
+				{
+					Sample();
+					std::this_thread::sleep_for(std::chrono::microseconds(m_intervalUs));
+				}
+			});
+
+		m_baselineCommitted = Platform::GetCommittedMemory();
+		m_baselineResident = Platform::GetPrivateResidentMemory();
+		m_start = Platform::QueryTimerCounter();
+		m_bStarted.store(true, std::memory_order_release);
+	}
+
+	// Takes the last sample, so even the tests shorter than the interval have the start and the end points
+	void Stop()
+	{
+		if (!m_thread.joinable())
+		{
+			return;
+		}
+
+		m_bRunning.store(false);
+		m_bStarted.store(true);
+		m_thread.join();
+		Sample();
+	}
+
+private:
+	void Sample()
+	{
+		const size_t committed = Platform::GetCommittedMemory();
+		const size_t resident = Platform::GetPrivateResidentMemory();
+
+		MemorySample sample;
+		sample.m_ms = (double)(Platform::QueryTimerCounter() - m_start) * 1000.0 / (double)Platform::QueryTimerFrequency();
+		sample.m_committed = committed > m_baselineCommitted ? committed - m_baselineCommitted : 0;
+		sample.m_resident = resident > m_baselineResident ? resident - m_baselineResident : 0;
+		m_timeline->m_samples.push_back(sample);
+	}
+
+	int m_intervalUs;
+	MemoryTimeline* m_timeline = nullptr;
+	size_t m_baselineCommitted = 0;
+	size_t m_baselineResident = 0;
+	int64_t m_start = 0;
+	std::atomic<bool> m_bRunning{ false };
+	std::atomic<bool> m_bStarted{ false };
+	std::thread m_thread;
+};
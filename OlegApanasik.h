@@ -49,10 +49,29 @@ namespace OlegApanasik
             _occupiedMemoryPositions.pop_back();
             return memory_piece;
         }
+        size_t ReserveMemoryPieces(void** out_memory_pieces, const size_t& in_count)
+        {
+            const size_t free_count = _occupiedMemoryPositions.size();
+            const size_t count = in_count < free_count ? in_count : free_count;
+            for (size_t i = 0; i < count; i++)
+            {
+                out_memory_pieces[i] = _data + _occupiedMemoryPositions[free_count - 1 - i] + sizeof(Header);
+            }
+            _occupiedMemoryPositions.resize(free_count - count);
+            return count;
+        }
         void FreeMemoryPiece(size_t& in_mem_block_position)
         {
             _occupiedMemoryPositions.push_back(in_mem_block_position);
         }
+        void FreeMemoryPieces(void* const* in_memory_pieces, const size_t& in_count)
+        {
+            for (size_t i = 0; i < in_count; i++)
+            {
+                const Header* header = reinterpret_cast<const Header*>(static_cast<char*>(in_memory_pieces[i]) - sizeof(Header));
+                _occupiedMemoryPositions.push_back(header->_memBlockPosition);
+            }
+        }
         bool IsFree() const
         {
             return !_occupiedMemoryPositions.empty();
@@ -187,6 +206,29 @@ namespace OlegApanasik
             }
             return memory_allocation_block;
         }
+        size_t AllocateBatch(size_t in_memory_allocation_size, size_t in_count, void** out_memory_allocation_blocks)
+        {
+            const size_t align_size = align(in_memory_allocation_size);
+            const size_t bucket_index = getBucketIndex(align_size);
+            size_t allocated_count = 0;
+            while (allocated_count < in_count)
+            {
+                TMemoryBlockAllocator* mem_block = findFreeBlock(bucket_index, align_size);
+                if (!mem_block)
+                {
+                    mem_block = requestMemoryFromOS(bucket_index, align_size);
+                    const size_t mem_block_index = _memBuckets[bucket_index].size();
+                    _freeMemBuckets[bucket_index].emplace_back(mem_block_index);
+                    _memBuckets[bucket_index].emplace_back(mem_block);
+                }
+                allocated_count += mem_block->ReserveMemoryPieces(out_memory_allocation_blocks + allocated_count, in_count - allocated_count);
+                if (!mem_block->IsFree())
+                {
+                    RemoveBlockFromBucket(bucket_index, _memBuckets[bucket_index].size());
+                }
+            }
+            return allocated_count;
+        }
         void Reserve()
         {
             ReserveBuckets(_memoryBucketSize - 1, 2);
@@ -202,6 +244,28 @@ namespace OlegApanasik
                 }
             }
         }
+        template<typename TVisitor>
+        void WalkHeap(TVisitor& visitor) const
+        {
+            for (const auto& mem_bucket : _memBuckets)
+            {
+                for (const TMemoryBlockAllocator* mem_block : mem_bucket)
+                {
+                    const size_t stride = mem_block->_memPieceSize + sizeof(Header);
+                    visitor.Region(mem_block->_data, stride * mem_block->_memBlockSize);
+                    // the positions vector holds the free pieces
+                    std::vector<bool> free_pieces(mem_block->_memBlockSize, false);
+                    for (const size_t position : mem_block->_occupiedMemoryPositions)
+                    {
+                        free_pieces[position / stride] = true;
+                    }
+                    for (size_t index = 0; index < mem_block->_memBlockSize; index++)
+                    {
+                        visitor.Block(mem_block->_data + index * stride + sizeof(Header), mem_block->_memPieceSize, free_pieces[index]);
+                    }
+                }
+            }
+        }
         void Free(void* in_data)
         {
             Header* header = reinterpret_cast<Header*>(static_cast<char*>(in_data) - sizeof(Header));
@@ -215,6 +279,32 @@ namespace OlegApanasik
             }
             mem_block->FreeMemoryPiece(mem_block_position);
         }
+        void FreeBatch(void** in_data, size_t in_count)
+        {
+            for (size_t index = 0; index < in_count;)
+            {
+                const Header* header = reinterpret_cast<const Header*>(static_cast<char*>(in_data[index]) - sizeof(Header));
+                const size_t mem_block_index = header->_memBlockIndex;
+                const size_t mem_piece_size = header->_memPieceSize;
+                size_t end = index + 1;
+                for (; end < in_count; end++)
+                {
+                    const Header* next = reinterpret_cast<const Header*>(static_cast<char*>(in_data[end]) - sizeof(Header));
+                    if (next->_memBlockIndex != mem_block_index || next->_memPieceSize != mem_piece_size)
+                    {
+                        break;
+                    }
+                }
+                const size_t bucket_index = getBucketIndex(mem_piece_size);
+                TMemoryBlockAllocator* mem_block = _memBuckets[bucket_index][mem_block_index];
+                if (!mem_block->IsFree())
+                {
+                    _freeMemBuckets[bucket_index].emplace_back(mem_block_index);
+                }
+                mem_block->FreeMemoryPieces(in_data + index, end - index);
+                index = end;
+            }
+        }
     private:
         void RemoveBlockFromBucket(const size_t& in_bucket_index, const size_t& in_mem_block_index)
         {
@@ -0,0 +1,712 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <string>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <intrin.h>
+#include "psapi.h"
+#else
+#include <time.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <cxxabi.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
+// Platform layer of the contest harness.
+// Everything that touches the OS (clocks, process memory counters, compiler intrinsics) lives here,
+// so the tests themselves stay the same on Windows and Linux.
+
+#ifndef _MSC_VER
+
+// MSVC intrinsics used by the participants, implemented with GCC/Clang builtins.
+
+inline unsigned char _BitScanForward(unsigned long* index, uint32_t mask)
+{
+	if (mask == 0)
+	{
+		return 0;
+	}
+	*index = (unsigned long)__builtin_ctz(mask);
+	return 1;
+}
+
+inline unsigned char _BitScanForward64(unsigned long* index, uint64_t mask)
+{
+	if (mask == 0)
+	{
+		return 0;
+	}
+	*index = (unsigned long)__builtin_ctzll(mask);
+	return 1;
+}
+
+inline unsigned char _BitScanReverse(unsigned long* index, uint32_t mask)
+{
+	if (mask == 0)
+	{
+		return 0;
+	}
+	*index = 31ul - (unsigned long)__builtin_clz(mask);
+	return 1;
+}
+
+inline unsigned char _BitScanReverse64(unsigned long* index, uint64_t mask)
+{
+	if (mask == 0)
+	{
+		return 0;
+	}
+	*index = 63ul - (unsigned long)__builtin_clzll(mask);
+	return 1;
+}
+
+inline unsigned int __lzcnt(uint32_t value)
+{
+	return value ? (unsigned int)__builtin_clz(value) : 32u;
+}
+
+inline uint64_t __lzcnt64(uint64_t value)
+{
+	return value ? (uint64_t)__builtin_clzll(value) : 64u;
+}
+
+#define sprintf_s snprintf
+
+#endif
+
+namespace Platform
+{
+	// Monotonic tick counter, see QueryTimerFrequency for the tick length.
+	inline int64_t QueryTimerCounter()
+	{
+#ifdef _WIN32
+		LARGE_INTEGER li;
+		QueryPerformanceCounter(&li);
+		return li.QuadPart;
+#else
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+		return (int64_t)ts.tv_sec * 1000000000ll + (int64_t)ts.tv_nsec;
+#endif
+	}
+
+	// Ticks per second of QueryTimerCounter.
+	inline int64_t QueryTimerFrequency()
+	{
+#ifdef _WIN32
+		LARGE_INTEGER li;
+		if (!QueryPerformanceFrequency(&li))
+		{
+			return 0;
+		}
+		return li.QuadPart;
+#else
+		return 1000000000ll;
+#endif
+	}
+
+	// Cheap per-operation timestamp: TSC on x86, the monotonic timer elsewhere.
+	inline uint64_t ReadCycleCounter()
+	{
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return (uint64_t)QueryTimerCounter();
+#endif
+	}
+
+	// Ticks per second of ReadCycleCounter, calibrated against the monotonic timer once.
+	inline double GetCycleCounterFrequency()
+	{
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+		static const double frequency = []()
+		{
+			const int64_t timerFrequency = QueryTimerFrequency();
+			const int64_t timerStart = QueryTimerCounter();
+			const uint64_t cyclesStart = ReadCycleCounter();
+
+			int64_t timerEnd = timerStart;
+			while (timerEnd - timerStart < timerFrequency / 50)
+			{
+				timerEnd = QueryTimerCounter();
+			}
+			const uint64_t cyclesEnd = ReadCycleCounter();
+
+			return (double)(cyclesEnd - cyclesStart) * (double)timerFrequency / (double)(timerEnd - timerStart);
+		}();
+		return frequency;
+#else
+		return (double)QueryTimerFrequency();
+#endif
+	}
+
+#ifndef _WIN32
+	// Reads a small procfs file into the buffer, returns the number of bytes read.
+	inline size_t ReadProcFile(const char* path, char* buffer, size_t bufferSize)
+	{
+		int fd = open(path, O_RDONLY);
+		if (fd < 0)
+		{
+			return 0;
+		}
+
+		size_t total = 0;
+		while (total + 1 < bufferSize)
+		{
+			ssize_t bytes = read(fd, buffer + total, bufferSize - total - 1);
+			if (bytes <= 0)
+			{
+				break;
+			}
+			total += (size_t)bytes;
+		}
+		close(fd);
+
+		buffer[total] = '\0';
+		return total;
+	}
+
+	// Returns the value of "<key> <n> kB" line in smaps-like file in bytes.
+	inline size_t FindKbField(const char* text, const char* key)
+	{
+		const char* line = strstr(text, key);
+		if (!line)
+		{
+			return 0;
+		}
+		return (size_t)strtoull(line + strlen(key), nullptr, 10) * 1024;
+	}
+#endif
+
+	// Private memory committed by the process.
+	// On Windows that's PrivateUsage, on Linux that's the private writable address space (statm data),
+	// both count the pages once they are reserved for the process even if they were never touched.
+	// That's what the scores are computed from, so they stay comparable between the platforms.
+	inline size_t GetCommittedMemory()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS_EX pmc;
+		GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&pmc, sizeof(pmc));
+		return (size_t)pmc.PrivateUsage;
+#else
+		char buffer[256];
+		if (!ReadProcFile("/proc/self/statm", buffer, sizeof(buffer)))
+		{
+			return 0;
+		}
+
+		unsigned long long pages[6] = {};
+		sscanf(buffer, "%llu %llu %llu %llu %llu %llu", &pages[0], &pages[1], &pages[2], &pages[3], &pages[4], &pages[5]);
+
+		// size resident shared text lib data
+		return (size_t)pages[5] * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+	}
+
+	// Private memory the process really touched (private dirty + clean pages on Linux, private working set on Windows).
+	inline size_t GetPrivateResidentMemory()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS_EX pmc;
+		GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&pmc, sizeof(pmc));
+		return (size_t)pmc.WorkingSetSize;
+#else
+		char buffer[4096];
+		if (ReadProcFile("/proc/self/smaps_rollup", buffer, sizeof(buffer)))
+		{
+			return FindKbField(buffer, "Private_Dirty:") + FindKbField(buffer, "Private_Clean:");
+		}
+
+		// Old kernels don't have smaps_rollup: fall back to resident minus shared pages
+		if (!ReadProcFile("/proc/self/statm", buffer, sizeof(buffer)))
+		{
+			return 0;
+		}
+
+		unsigned long long size = 0, resident = 0, shared = 0;
+		sscanf(buffer, "%llu %llu %llu", &size, &resident, &shared);
+
+		return (size_t)(resident - shared) * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+	}
+
+	inline size_t GetPageSize()
+	{
+#ifdef _WIN32
+		static const size_t pageSize = []()
+		{
+			SYSTEM_INFO info;
+			GetSystemInfo(&info);
+			return (size_t)info.dwPageSize;
+		}();
+		return pageSize;
+#else
+		static const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+		return pageSize;
+#endif
+	}
+
+	// Committed read-write pages straight from the OS, size is a multiple of GetPageSize(); nullptr if they can't be mapped
+	inline void* MapPages(size_t size)
+	{
+#ifdef _WIN32
+		return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+		void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		return ptr == MAP_FAILED ? nullptr : ptr;
+#endif
+	}
+
+	// Releases the pages of a MapPages call, ptr and size are the ones of the call
+	inline void UnmapPages(void* ptr, size_t size)
+	{
+#ifdef _WIN32
+		(void)size;
+		VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+		munmap(ptr, size);
+#endif
+	}
+
+	// Read-only memory mapping of a whole file, used to stream traces that don't fit in RAM.
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		~MappedFile()
+		{
+			Close();
+		}
+
+		bool Open(const char* path)
+		{
+			Close();
+#ifdef _WIN32
+			m_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (m_file == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+			{
+				Close();
+				return false;
+			}
+			m_size = (size_t)size.QuadPart;
+
+			m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!m_mapping)
+			{
+				Close();
+				return false;
+			}
+
+			m_data = (const uint8_t*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+			if (!m_data)
+			{
+				Close();
+				return false;
+			}
+#else
+			m_file = open(path, O_RDONLY);
+			if (m_file < 0)
+			{
+				return false;
+			}
+
+			struct stat st;
+			if (fstat(m_file, &st) != 0 || st.st_size == 0)
+			{
+				Close();
+				return false;
+			}
+			m_size = (size_t)st.st_size;
+
+			void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+			if (data == MAP_FAILED)
+			{
+				Close();
+				return false;
+			}
+			m_data = (const uint8_t*)data;
+			madvise(data, m_size, MADV_SEQUENTIAL);
+#endif
+			return true;
+		}
+
+		void Close()
+		{
+#ifdef _WIN32
+			if (m_data)
+			{
+				UnmapViewOfFile(m_data);
+			}
+			if (m_mapping)
+			{
+				CloseHandle(m_mapping);
+			}
+			if (m_file != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(m_file);
+			}
+			m_mapping = nullptr;
+			m_file = INVALID_HANDLE_VALUE;
+#else
+			if (m_data)
+			{
+				munmap((void*)m_data, m_size);
+			}
+			if (m_file >= 0)
+			{
+				close(m_file);
+			}
+			m_file = -1;
+#endif
+			m_data = nullptr;
+			m_size = 0;
+		}
+
+		// Drops the already consumed pages [0, offset) from the working set, they are backed by the file anyway
+		void Release(size_t offset)
+		{
+			offset = (std::min)(offset, m_size);
+#ifdef _WIN32
+			const size_t granularity = 64 * 1024;
+#else
+			const size_t granularity = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+			offset -= offset % granularity;
+			if (offset == 0)
+			{
+				return;
+			}
+#ifdef _WIN32
+			VirtualUnlock((void*)m_data, offset);
+#else
+			madvise((void*)m_data, offset, MADV_DONTNEED);
+#endif
+		}
+
+		const uint8_t* GetData() const
+		{
+			return m_data;
+		}
+
+		size_t GetSize() const
+		{
+			return m_size;
+		}
+
+	private:
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		HANDLE m_file = INVALID_HANDLE_VALUE;
+		HANDLE m_mapping = nullptr;
+#else
+		int m_file = -1;
+#endif
+	};
+
+	enum EPerfCounter
+	{
+		PerfCycles,
+		PerfInstructions,
+		PerfL1dMisses,
+		PerfLlcMisses,
+		PerfDtlbMisses,
+		PerfBranchMisses,
+		PerfCountersCount
+	};
+
+	inline const char* GetPerfCounterName(int counter)
+	{
+		static const char* names[PerfCountersCount] = { "cycles", "instructions", "L1d-misses", "LLC-misses", "dTLB-misses", "branch-misses" };
+		return names[counter];
+	}
+
+	// Hardware counters of the calling thread counted in user space only, with perf_event_open on Linux.
+	// The counters are opened as one group, so they run together and are multiplexed together if the PMU is short of them.
+	// A counter the CPU or the VM doesn't have is skipped, the whole group is unavailable without the cycles counter
+	// (no PMU, perf_event_paranoid above 2, Windows).
+	class PerfCounterGroup
+	{
+	public:
+		PerfCounterGroup() = default;
+		PerfCounterGroup(const PerfCounterGroup&) = delete;
+		PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+		~PerfCounterGroup()
+		{
+			Close();
+		}
+
+		bool Open()
+		{
+			Close();
+#ifndef _WIN32
+			static const uint32_t types[PerfCountersCount] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+				PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE };
+			static const uint64_t configs[PerfCountersCount] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+				PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+				PERF_COUNT_HW_CACHE_MISSES,
+				PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+				PERF_COUNT_HW_BRANCH_MISSES };
+
+			for (int i = 0; i < PerfCountersCount; i++)
+			{
+				perf_event_attr attr;
+				memset(&attr, 0, sizeof(attr));
+				attr.size = sizeof(attr);
+				attr.type = types[i];
+				attr.config = configs[i];
+				attr.disabled = m_leader < 0 ? 1 : 0;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+				const int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, m_leader, 0);
+				if (fd < 0)
+				{
+					if (m_leader < 0)
+					{
+						return false;
+					}
+					continue;
+				}
+
+				if (m_leader < 0)
+				{
+					m_leader = fd;
+				}
+				m_fds[i] = fd;
+				m_order[m_count++] = i;
+			}
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		void Close()
+		{
+#ifndef _WIN32
+			for (int i = 0; i < PerfCountersCount; i++)
+			{
+				if (m_fds[i] >= 0)
+				{
+					close(m_fds[i]);
+				}
+				m_fds[i] = -1;
+			}
+			m_leader = -1;
+			m_count = 0;
+#endif
+		}
+
+		bool IsOpen() const
+		{
+			return m_leader >= 0;
+		}
+
+		bool HasCounter(int counter) const
+		{
+			return m_fds[counter] >= 0;
+		}
+
+		// The counts keep accumulating between Enable and Disable until the group is reopened
+		inline void Enable()
+		{
+#ifndef _WIN32
+			if (m_leader >= 0)
+			{
+				ioctl(m_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+			}
+#endif
+		}
+
+		inline void Disable()
+		{
+#ifndef _WIN32
+			if (m_leader >= 0)
+			{
+				ioctl(m_leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+			}
+#endif
+		}
+
+		// Counts since Open, scaled up by enabled / running time if the group was multiplexed. Missing counters are 0.
+		bool Read(uint64_t (&values)[PerfCountersCount]) const
+		{
+			memset(values, 0, sizeof(values));
+#ifndef _WIN32
+			if (m_leader < 0)
+			{
+				return false;
+			}
+
+			// nr, time_enabled, time_running, values
+			uint64_t buffer[3 + PerfCountersCount];
+			if (read(m_leader, buffer, sizeof(buffer)) < (ssize_t)(3 * sizeof(uint64_t)))
+			{
+				return false;
+			}
+
+			const double scale = buffer[2] > 0 ? (double)buffer[1] / (double)buffer[2] : 1.0;
+			for (uint64_t i = 0; i < buffer[0] && i < (uint64_t)m_count; i++)
+			{
+				values[m_order[i]] = (uint64_t)((double)buffer[3 + i] * scale);
+			}
+			return true;
+#else
+			return false;
+#endif
+		}
+
+	private:
+		int m_fds[PerfCountersCount] = { -1, -1, -1, -1, -1, -1 };
+		// counter of every value in the group read
+		int m_order[PerfCountersCount] = {};
+		int m_count = 0;
+		int m_leader = -1;
+	};
+
+	// Pins the calling thread to a single CPU for the lifetime of the object and restores the previous affinity after.
+	// The threads started meanwhile inherit the pinning on Linux, so multithreaded tests must run outside of it.
+	class ScopedCpuPin
+	{
+	public:
+		ScopedCpuPin(int cpu)
+		{
+#ifdef _WIN32
+			m_previous = SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu);
+			m_bPinned = m_previous != 0;
+#else
+			if (sched_getaffinity(0, sizeof(m_previous), &m_previous) != 0)
+			{
+				return;
+			}
+
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpu, &set);
+			m_bPinned = sched_setaffinity(0, sizeof(set), &set) == 0;
+#endif
+		}
+
+		ScopedCpuPin(const ScopedCpuPin&) = delete;
+		ScopedCpuPin& operator=(const ScopedCpuPin&) = delete;
+
+		~ScopedCpuPin()
+		{
+			if (!m_bPinned)
+			{
+				return;
+			}
+#ifdef _WIN32
+			SetThreadAffinityMask(GetCurrentThread(), m_previous);
+#else
+			sched_setaffinity(0, sizeof(m_previous), &m_previous);
+#endif
+		}
+
+		bool IsPinned() const
+		{
+			return m_bPinned;
+		}
+
+	private:
+		bool m_bPinned = false;
+#ifdef _WIN32
+		DWORD_PTR m_previous = 0;
+#else
+		cpu_set_t m_previous;
+#endif
+	};
+
+	// CPU model as the OS reports it, empty if unknown.
+	inline std::string GetCpuName()
+	{
+#ifdef _WIN32
+		char name[256] = {};
+		DWORD size = sizeof(name);
+		if (RegGetValueA(HKEY_LOCAL_MACHINE, "HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0", "ProcessorNameString",
+			RRF_RT_REG_SZ, nullptr, name, &size) != ERROR_SUCCESS)
+		{
+			return std::string();
+		}
+		return name;
+#else
+		char buffer[4096];
+		if (!ReadProcFile("/proc/cpuinfo", buffer, sizeof(buffer)))
+		{
+			return std::string();
+		}
+
+		const char* line = strstr(buffer, "model name");
+		const char* value = line ? strchr(line, ':') : nullptr;
+		if (!value)
+		{
+			return std::string();
+		}
+
+		value += strspn(value, ": \t");
+		return std::string(value, strcspn(value, "\n"));
+#endif
+	}
+
+	// OS name and version.
+	inline std::string GetOsName()
+	{
+#ifdef _WIN32
+		return "Windows";
+#else
+		utsname name;
+		if (uname(&name) != 0)
+		{
+			return "Linux";
+		}
+		return std::string(name.sysname) + " " + name.release;
+#endif
+	}
+
+	// Human readable type name, MSVC produces it from typeid directly, GCC and Clang need demangling.
+	inline std::string DemangleTypeName(const char* name)
+	{
+#ifdef _MSC_VER
+		return name;
+#else
+		int status = 0;
+		char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+		if (status != 0 || !demangled)
+		{
+			return name;
+		}
+
+		std::string res = demangled;
+		free(demangled);
+		return res;
+#endif
+	}
+}
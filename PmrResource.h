@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <unordered_set>
+#include "AllocatorTraits.h"
+
+// std::pmr::memory_resource over a contest allocator, so the std::pmr containers can run on any of the entrants:
+//     ContestMemoryResource<AntonShatalov::Ololokator> resource;
+//     std::pmr::map<int, std::pmr::string> map(&resource);
+// The resource owns its allocator instance, which is released with it, and is equal only to itself.
+// The contest allocators are asked for the alignment of 8 the harness uses; a larger alignment is honoured by the resource:
+// it allocates alignment + 8 more bytes, aligns the block within them past the first 8 and keeps the pointer the allocator
+// returned just below the aligned one, do_deallocate gets the alignment back and frees that pointer.
+// Some allocators don't align their blocks at all, a block of theirs that misses even an alignment up to 8 takes the same way
+// and is remembered, so do_deallocate tells it from the others.
+// do_deallocate passes the size to the allocators with the sized Free (AllocatorTraits.h), the blocks are all allocated with 8.
+template<typename TAllocator>
+class ContestMemoryResource : public std::pmr::memory_resource
+{
+public:
+	static const size_t NATIVE_ALIGNMENT = 8;
+
+	TAllocator& GetAllocator()
+	{
+		return m_allocator;
+	}
+
+protected:
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		bytes = bytes ? bytes : 1;
+		if (alignment <= NATIVE_ALIGNMENT)
+		{
+			void* ptr = m_allocator.Allocate(bytes, NATIVE_ALIGNMENT);
+			if (!ptr)
+			{
+				throw std::bad_alloc();
+			}
+			if ((uintptr_t)ptr % alignment == 0)
+			{
+				return ptr;
+			}
+
+			FreeBlock(m_allocator, ptr, bytes);
+			void* aligned = AllocateAligned(bytes, NATIVE_ALIGNMENT);
+			m_realigned.insert(aligned);
+			return aligned;
+		}
+
+		return AllocateAligned(bytes, alignment);
+	}
+
+	void do_deallocate(void* ptr, size_t bytes, size_t alignment) override
+	{
+		bytes = bytes ? bytes : 1;
+		if (alignment <= NATIVE_ALIGNMENT)
+		{
+			if (m_realigned.empty() || m_realigned.erase(ptr) == 0)
+			{
+				FreeBlock(m_allocator, ptr, bytes);
+				return;
+			}
+			alignment = NATIVE_ALIGNMENT;
+		}
+
+		FreeBlock(m_allocator, ((void**)ptr)[-1], GetAlignedSize(bytes, alignment));
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+
+private:
+	static size_t GetAlignedSize(size_t bytes, size_t alignment)
+	{
+		return bytes + alignment + sizeof(void*);
+	}
+
+	// The block pointer goes to the sizeof(void*) bytes below the aligned one, which are within the block whatever its alignment
+	void* AllocateAligned(size_t bytes, size_t alignment)
+	{
+		void* block = m_allocator.Allocate(GetAlignedSize(bytes, alignment), NATIVE_ALIGNMENT);
+		if (!block)
+		{
+			throw std::bad_alloc();
+		}
+
+		const uintptr_t aligned = ((uintptr_t)block + sizeof(void*) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+		((void**)aligned)[-1] = block;
+		return (void*)aligned;
+	}
+
+	TAllocator m_allocator;
+	// the blocks of the alignments up to 8 which AllocateAligned made, the allocators aligning their blocks leave it empty
+	std::unordered_set<void*> m_realigned;
+};
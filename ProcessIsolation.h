@@ -0,0 +1,391 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Harness.h"
+
+#ifndef _WIN32
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Runs the cells of the tests in child processes, so the heap state, glibc arenas and the memory left behind
+// by one allocator don't change the numbers of the next one. Every cell is forked from the driver, fills a Result
+// of its own and sends it back through a pipe in the text format of SerializeResult, the driver merges them.
+// Several cells can run at once, each pinned to its own CPU. A cell that crashes is reported in Result::m_errors.
+// Windows has no fork, the cells run in the driver process one by one there.
+
+struct IsolatedCell
+{
+	std::string m_name;
+	std::function<void(Result&)> m_run;
+};
+
+// One record per line: G totals, R result point, S repetitions, C hardware counters, L latency histogram,
+// T memory timeline followed by its P samples, N churn window, E error. Names never contain spaces.
+inline std::string SerializeResult(const Result& result)
+{
+	std::string text;
+	char buffer[512];
+
+	snprintf(buffer, sizeof(buffer), "G %.9g %.9g %.9g\n", result.m_globalScore, result.m_globalMemoryOverhead, result.m_globalTime);
+	text += buffer;
+
+	for (auto& size : result.m_results)
+	{
+		for (auto& test : size.second)
+		{
+			for (auto& point : test.second)
+			{
+				snprintf(buffer, sizeof(buffer), "R %s %s %zu %zu %.9g\n", size.first.c_str(), test.first.c_str(),
+					point.first, point.second.first, point.second.second);
+				text += buffer;
+			}
+		}
+	}
+
+	for (auto& size : result.m_statistics)
+	{
+		for (auto& test : size.second)
+		{
+			for (auto& point : test.second)
+			{
+				snprintf(buffer, sizeof(buffer), "S %s %s %zu %.17g %.17g %.17g %zu\n", size.first.c_str(), test.first.c_str(), point.first,
+					point.second.m_median, point.second.m_low, point.second.m_high, point.second.m_count);
+				text += buffer;
+			}
+		}
+	}
+
+	for (auto& size : result.m_counters)
+	{
+		for (auto& test : size.second)
+		{
+			const PerfCounterStats& stats = test.second;
+			text += "C " + size.first + " " + test.first + " " + std::to_string(stats.m_operations);
+			for (int i = 0; i < Platform::PerfCountersCount; i++)
+			{
+				text += " " + std::to_string(stats.m_values[i]) + " " + (stats.m_bAvailable[i] ? "1" : "0");
+			}
+			text += "\n";
+		}
+	}
+
+	for (auto& size : result.m_latency)
+	{
+		for (auto& test : size.second)
+		{
+			const LatencyHistogram* histograms[] = { &test.second.m_allocate, &test.second.m_free };
+			for (int operation = 0; operation < 2; operation++)
+			{
+				const LatencyHistogram& histogram = *histograms[operation];
+				if (histogram.GetTotalCount() == 0)
+				{
+					continue;
+				}
+
+				text += "L " + size.first + " " + test.first + " " + std::to_string(operation) + " " + std::to_string(histogram.GetMax());
+				for (size_t i = 0; i < LatencyHistogram::BUCKETS_COUNT; i++)
+				{
+					if (histogram.GetBucketCount(i))
+					{
+						text += " " + std::to_string(i) + " " + std::to_string(histogram.GetBucketCount(i));
+					}
+				}
+				text += "\n";
+			}
+		}
+	}
+
+	for (auto& size : result.m_memory)
+	{
+		for (auto& test : size.second)
+		{
+			for (const MemoryTimeline& timeline : test.second)
+			{
+				snprintf(buffer, sizeof(buffer), "T %s %s %zu %zu\n", size.first.c_str(), test.first.c_str(), timeline.m_requested, timeline.m_snapshotOverhead);
+				text += buffer;
+
+				for (const MemorySample& sample : timeline.m_samples)
+				{
+					snprintf(buffer, sizeof(buffer), "P %.17g %zu %zu\n", sample.m_ms, sample.m_committed, sample.m_resident);
+					text += buffer;
+				}
+			}
+		}
+	}
+
+	for (auto& size : result.m_churn)
+	{
+		for (auto& lifetime : size.second)
+		{
+			for (const ChurnPoint& point : lifetime.second)
+			{
+				snprintf(buffer, sizeof(buffer), "N %s %s %zu %.17g %zu %zu %zu\n", size.first.c_str(), lifetime.first.c_str(), point.m_steps,
+					point.m_opsPerSec, point.m_liveBytes, point.m_footprint, point.m_failed);
+				text += buffer;
+			}
+		}
+	}
+
+	for (const std::string& error : result.m_errors)
+	{
+		text += "E " + error + "\n";
+	}
+
+	return text;
+}
+
+// Merges the serialized result of a cell into the result, the totals are added up
+inline void DeserializeResult(const std::string& text, Result& result)
+{
+	std::istringstream lines(text);
+	std::string line;
+	MemoryTimeline* timeline = nullptr;
+
+	while (std::getline(lines, line))
+	{
+		if (line.size() < 2)
+		{
+			continue;
+		}
+
+		std::istringstream fields(line.substr(2));
+		std::string size;
+		std::string test;
+
+		switch (line[0])
+		{
+		case 'G':
+		{
+			float score = 0.0f, memoryOverhead = 0.0f, time = 0.0f;
+			fields >> score >> memoryOverhead >> time;
+			result.m_globalScore += score;
+			result.m_globalMemoryOverhead += memoryOverhead;
+			result.m_globalTime += time;
+			break;
+		}
+		case 'R':
+		{
+			size_t allocated = 0, ms = 0;
+			float overhead = 0.0f;
+			fields >> size >> test >> allocated >> ms >> overhead;
+			result.m_results[size][test][allocated] = { ms, overhead };
+			break;
+		}
+		case 'S':
+		{
+			size_t allocated = 0;
+			SampleStatistics statistics;
+			fields >> size >> test >> allocated >> statistics.m_median >> statistics.m_low >> statistics.m_high >> statistics.m_count;
+			result.m_statistics[size][test][allocated] = statistics;
+			break;
+		}
+		case 'C':
+		{
+			fields >> size >> test;
+			PerfCounterStats& stats = result.m_counters[size][test];
+			fields >> stats.m_operations;
+			for (int i = 0; i < Platform::PerfCountersCount; i++)
+			{
+				int bAvailable = 0;
+				fields >> stats.m_values[i] >> bAvailable;
+				stats.m_bAvailable[i] = bAvailable != 0;
+			}
+			break;
+		}
+		case 'L':
+		{
+			int operation = 0;
+			uint64_t max = 0;
+			fields >> size >> test >> operation >> max;
+
+			LatencyStats& stats = result.m_latency[size][test];
+			LatencyHistogram& histogram = operation == 0 ? stats.m_allocate : stats.m_free;
+
+			size_t index = 0;
+			uint64_t count = 0;
+			while (fields >> index >> count)
+			{
+				if (index < LatencyHistogram::BUCKETS_COUNT)
+				{
+					histogram.AddBucketCount(index, count, max);
+				}
+			}
+			break;
+		}
+		case 'T':
+			fields >> size >> test;
+			timeline = &result.m_memory[size][test].emplace_back();
+			fields >> timeline->m_requested >> timeline->m_snapshotOverhead;
+			break;
+		case 'P':
+			if (timeline)
+			{
+				MemorySample sample;
+				fields >> sample.m_ms >> sample.m_committed >> sample.m_resident;
+				timeline->m_samples.push_back(sample);
+			}
+			break;
+		case 'N':
+		{
+			ChurnPoint point;
+			fields >> size >> test >> point.m_steps >> point.m_opsPerSec >> point.m_liveBytes >> point.m_footprint >> point.m_failed;
+			result.m_churn[size][test].push_back(point);
+			break;
+		}
+		case 'E':
+			result.m_errors.push_back(line.substr(2));
+			break;
+		}
+	}
+}
+
+// Runs the cells into the result, up to jobs of them at once, 0 jobs is one per CPU
+inline void RunIsolated(const std::vector<IsolatedCell>& cells, Result& result, size_t jobs)
+{
+	const size_t cpus = (std::max)((size_t)std::thread::hardware_concurrency(), (size_t)1);
+	jobs = jobs == 0 ? cpus : jobs;
+
+#ifndef _WIN32
+	struct Child
+	{
+		pid_t m_pid;
+		int m_fd;
+		size_t m_cell;
+		size_t m_slot;
+		std::string m_output;
+	};
+
+	std::vector<Child> children;
+	std::vector<bool> slots(jobs, false);
+	size_t next = 0;
+
+	while (next < cells.size() || !children.empty())
+	{
+		while (children.size() < jobs && next < cells.size())
+		{
+			const size_t cell = next++;
+			const size_t slot = (size_t)(std::find(slots.begin(), slots.end(), false) - slots.begin());
+
+			int fds[2];
+			if (pipe(fds) != 0)
+			{
+				result.m_errors.push_back(cells[cell].m_name + ": can't create a pipe, ran in the driver process");
+				cells[cell].m_run(result);
+				continue;
+			}
+
+			fflush(stdout);
+			const pid_t pid = fork();
+			if (pid == 0)
+			{
+				close(fds[0]);
+				std::unique_ptr<Platform::ScopedCpuPin> pin;
+				if (jobs > 1)
+				{
+					pin.reset(new Platform::ScopedCpuPin((int)(slot % cpus)));
+				}
+
+				Result cellResult(result.m_allocator);
+				cells[cell].m_run(cellResult);
+
+				const std::string text = SerializeResult(cellResult);
+				size_t written = 0;
+				while (written < text.size())
+				{
+					const ssize_t bytes = write(fds[1], text.data() + written, text.size() - written);
+					if (bytes <= 0)
+					{
+						_exit(1);
+					}
+					written += (size_t)bytes;
+				}
+				close(fds[1]);
+				_exit(0);
+			}
+
+			close(fds[1]);
+			if (pid < 0)
+			{
+				close(fds[0]);
+				result.m_errors.push_back(cells[cell].m_name + ": can't fork, ran in the driver process");
+				cells[cell].m_run(result);
+				continue;
+			}
+
+			slots[slot] = true;
+			children.push_back({ pid, fds[0], cell, slot, std::string() });
+		}
+
+		if (children.empty())
+		{
+			continue;
+		}
+
+		// the pipes are drained while the children run, so a large result never blocks its child
+		std::vector<pollfd> fds(children.size());
+		for (size_t i = 0; i < children.size(); i++)
+		{
+			fds[i].fd = children[i].m_fd;
+			fds[i].events = POLLIN;
+			fds[i].revents = 0;
+		}
+
+		if (poll(fds.data(), fds.size(), -1) < 0)
+		{
+			continue;
+		}
+
+		for (size_t i = children.size(); i-- > 0;)
+		{
+			if (!fds[i].revents)
+			{
+				continue;
+			}
+
+			Child& child = children[i];
+			char buffer[65536];
+			const ssize_t bytes = read(child.m_fd, buffer, sizeof(buffer));
+			if (bytes > 0)
+			{
+				child.m_output.append(buffer, (size_t)bytes);
+				continue;
+			}
+
+			close(child.m_fd);
+			int status = 0;
+			waitpid(child.m_pid, &status, 0);
+
+			if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+			{
+				DeserializeResult(child.m_output, result);
+			}
+			else if (WIFSIGNALED(status))
+			{
+				result.m_errors.push_back(cells[child.m_cell].m_name + ": the child process was killed by signal " + std::to_string(WTERMSIG(status)));
+			}
+			else
+			{
+				result.m_errors.push_back(cells[child.m_cell].m_name + ": the child process exited with code " + std::to_string(WEXITSTATUS(status)));
+			}
+
+			slots[child.m_slot] = false;
+			children.erase(children.begin() + i);
+		}
+	}
+#else
+	for (const IsolatedCell& cell : cells)
+	{
+		cell.m_run(result);
+	}
+#endif
+}
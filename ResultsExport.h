@@ -0,0 +1,219 @@
+#pragma once
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "Harness.h"
+
+// Machine-readable results of a run: results.json and results.csv with a row per allocator, size, test and allocated size.
+// The CSV is what CompareResults.cpp reads, the environment goes to its "# key: value" header lines.
+
+typedef std::vector<std::pair<std::string, std::string>> RunEnvironment;
+
+// A single measured point of TestResult with its score computed the same way TestCase_MemoryPerformance does
+struct ResultRow
+{
+	std::string m_allocator;
+	std::string m_size;
+	std::string m_test;
+	size_t m_allocatedBytes = 0;
+	size_t m_ms = 0;
+	float m_overheadMb = 0.0f;
+	float m_score = 0.0f;
+	// repetitions of the point, m_count is 0 for the tests that don't repeat
+	SampleStatistics m_repetitions;
+};
+
+inline RunEnvironment GetRunEnvironment()
+{
+	RunEnvironment environment;
+
+	char timestamp[64];
+	const time_t now = time(nullptr);
+	strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+	environment.emplace_back("timestamp", timestamp);
+
+	environment.emplace_back("os", Platform::GetOsName());
+	environment.emplace_back("cpu", Platform::GetCpuName());
+	environment.emplace_back("hardware_threads", std::to_string(std::thread::hardware_concurrency()));
+
+#if defined(__clang__)
+	environment.emplace_back("compiler", std::string("clang ") + __clang_version__);
+#elif defined(__GNUC__)
+	environment.emplace_back("compiler", std::string("gcc ") + __VERSION__);
+#elif defined(_MSC_VER)
+	environment.emplace_back("compiler", "msvc " + std::to_string(_MSC_FULL_VER));
+#endif
+
+#if defined(__OPTIMIZE__) || (defined(_MSC_VER) && defined(NDEBUG))
+	environment.emplace_back("build", "optimized");
+#else
+	environment.emplace_back("build", "unoptimized");
+#endif
+
+	return environment;
+}
+
+// Rows sorted by allocator order, size, test and allocated size, so two runs diff line by line
+inline std::vector<ResultRow> GetResultRows(std::vector<Result>& results)
+{
+	std::vector<ResultRow> rows;
+	for (auto& result : results)
+	{
+		std::map<std::string, TestResult*> sizes;
+		for (auto& size : result.m_results)
+		{
+			sizes[size.first] = &size.second;
+		}
+
+		for (auto& size : sizes)
+		{
+			std::map<std::string, std::map<size_t, std::pair<size_t, float>>> tests;
+			for (auto& test : *size.second)
+			{
+				tests[test.first].insert(test.second.begin(), test.second.end());
+			}
+
+			for (auto& test : tests)
+			{
+				// the score grows with the step 1..5 of the allocations count, a single point is the last step
+				size_t rank = 0;
+				for (auto& point : test.second)
+				{
+					rank++;
+
+					ResultRow row;
+					row.m_allocator = result.m_allocator;
+					row.m_size = size.first;
+					row.m_test = test.first;
+					row.m_allocatedBytes = point.first;
+					row.m_ms = point.second.first;
+					row.m_overheadMb = point.second.second;
+
+					const float step = 5.0f * (float)rank / (float)test.second.size();
+					const float allocatedMb = (float)((double)point.first / 1048576.0);
+					row.m_score = row.m_ms > 0 ? CalculateScore((float)row.m_ms, row.m_overheadMb, step, allocatedMb) : 0.0f;
+
+					auto sizeStatistics = result.m_statistics.find(size.first);
+					if (sizeStatistics != result.m_statistics.end())
+					{
+						auto testStatistics = sizeStatistics->second.find(test.first);
+						if (testStatistics != sizeStatistics->second.end() && testStatistics->second.count(point.first))
+						{
+							row.m_repetitions = testStatistics->second.at(point.first);
+						}
+					}
+
+					rows.push_back(row);
+				}
+			}
+		}
+	}
+
+	return rows;
+}
+
+inline std::string EscapeJson(const std::string& value)
+{
+	std::string res;
+	for (char c : value)
+	{
+		if (c == '"' || c == '\\')
+		{
+			res += '\\';
+			res += c;
+		}
+		else if ((unsigned char)c < 0x20)
+		{
+			char buffer[8];
+			snprintf(buffer, sizeof(buffer), "\\u%04x", (unsigned)c);
+			res += buffer;
+		}
+		else
+		{
+			res += c;
+		}
+	}
+	return res;
+}
+
+inline std::string EscapeCsv(const std::string& value)
+{
+	std::string res = "\"";
+	for (char c : value)
+	{
+		res += c;
+		if (c == '"')
+		{
+			res += '"';
+		}
+	}
+	return res + "\"";
+}
+
+inline bool WriteResultsJson(std::vector<Result>& results, const RunEnvironment& environment, const char* path)
+{
+	std::string json = "{\n  \"environment\": {";
+	for (size_t i = 0; i < environment.size(); i++)
+	{
+		json += (i ? ",\n    \"" : "\n    \"") + EscapeJson(environment[i].first) + "\": \"" + EscapeJson(environment[i].second) + "\"";
+	}
+	json += "\n  },\n  \"allocators\": [";
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		char buffer[256];
+		snprintf(buffer, sizeof(buffer), "\", \"score\": %.4f, \"memory_overhead_mb\": %.4f, \"time_sec\": %.4f }",
+			results[i].m_globalScore, results[i].m_globalMemoryOverhead, results[i].m_globalTime);
+		json += (i ? ",\n    { \"allocator\": \"" : "\n    { \"allocator\": \"") + EscapeJson(results[i].m_allocator) + buffer;
+	}
+	json += "\n  ],\n  \"results\": [";
+
+	const std::vector<ResultRow> rows = GetResultRows(results);
+	for (size_t i = 0; i < rows.size(); i++)
+	{
+		const ResultRow& row = rows[i];
+
+		char buffer[512];
+		snprintf(buffer, sizeof(buffer), "\"allocated_bytes\": %zu, \"time_ms\": %zu, \"overhead_mb\": %.4f, \"score\": %.4f, "
+			"\"repetitions\": %zu, \"median_ms\": %.4f, \"ci_low_ms\": %.4f, \"ci_high_ms\": %.4f }",
+			row.m_allocatedBytes, row.m_ms, row.m_overheadMb, row.m_score,
+			row.m_repetitions.m_count, row.m_repetitions.m_median, row.m_repetitions.m_low, row.m_repetitions.m_high);
+
+		json += i ? ",\n    { " : "\n    { ";
+		json += "\"allocator\": \"" + EscapeJson(row.m_allocator) + "\", \"size\": \"" + EscapeJson(row.m_size) +
+			"\", \"test\": \"" + EscapeJson(row.m_test) + "\", " + buffer;
+	}
+	json += "\n  ]\n}\n";
+
+	std::ofstream file{ path };
+	file << json;
+	return file.good();
+}
+
+inline bool WriteResultsCsv(std::vector<Result>& results, const RunEnvironment& environment, const char* path)
+{
+	std::string csv;
+	for (auto& it : environment)
+	{
+		csv += "# " + it.first + ": " + it.second + "\n";
+	}
+	csv += "allocator,size,test,allocated_bytes,time_ms,overhead_mb,score,repetitions,median_ms,ci_low_ms,ci_high_ms\n";
+
+	for (const ResultRow& row : GetResultRows(results))
+	{
+		char buffer[512];
+		snprintf(buffer, sizeof(buffer), ",%zu,%zu,%.4f,%.4f,%zu,%.4f,%.4f,%.4f\n", row.m_allocatedBytes, row.m_ms, row.m_overheadMb, row.m_score,
+			row.m_repetitions.m_count, row.m_repetitions.m_median, row.m_repetitions.m_low, row.m_repetitions.m_high);
+		csv += EscapeCsv(row.m_allocator) + "," + EscapeCsv(row.m_size) + "," + EscapeCsv(row.m_test) + buffer;
+	}
+
+	std::ofstream file{ path };
+	file << csv;
+	return file.good();
+}
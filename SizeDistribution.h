@@ -0,0 +1,279 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "AllocationTrace.h"
+
+// Distribution of the allocation sizes of a size range of TestCase_MemoryPerformance.
+//
+// Uniform is the contest one, MinSize + rand() % MaxSize. The others stay within [MinSize, MaxSize]:
+//     log-normal: exp(N(ln median, sigma)), most blocks around the median with a long tail of large ones;
+//     Zipf:       the size classes of the range (8, 10, 12, 14, 16, 20, 24 ... quarter steps of the powers of two)
+//                 ranked from the smallest, class k with the probability ~ 1 / k^exponent, the size is uniform within the class;
+//     histogram:  the sizes and weights of a text file or of the Allocate records of an allocation trace (AllocationTrace.h).
+// A histogram file has a "SIZE WEIGHT" or "LOW-HIGH WEIGHT" line per bucket, separated by spaces or a comma,
+// the sizes of a LOW-HIGH bucket are uniform; # comments and the lines not starting with a digit are skipped.
+// All of them draw from the engine of the test, so the sizes are the same in every run.
+
+enum ESizeDistribution
+{
+	SizeUniform,
+	SizeLogNormal,
+	SizeZipf,
+	SizeHistogram
+};
+
+class SizeDistribution
+{
+public:
+	struct Bucket
+	{
+		size_t m_low;
+		size_t m_high;
+		double m_weight;
+	};
+
+	static SizeDistribution LogNormal(double median, double sigma)
+	{
+		SizeDistribution distribution;
+		distribution.m_type = SizeLogNormal;
+		distribution.m_median = median;
+		distribution.m_sigma = sigma;
+		return distribution;
+	}
+
+	static SizeDistribution Zipf(double exponent)
+	{
+		SizeDistribution distribution;
+		distribution.m_type = SizeZipf;
+		distribution.m_exponent = exponent;
+		return distribution;
+	}
+
+	// Reads a histogram file or an allocation trace, false with the error set if there are no sizes in it
+	static bool LoadHistogram(const std::string& path, SizeDistribution& distribution, std::string& error)
+	{
+		distribution = SizeDistribution();
+		distribution.m_type = SizeHistogram;
+		distribution.m_path = path;
+
+		AllocationTraceReader trace;
+		if (trace.Open(path.c_str()))
+		{
+			std::map<uint64_t, uint64_t> counts;
+			TraceRecord record;
+			while (trace.Next(record))
+			{
+				if (record.m_opcode == ETraceOpcode::Allocate && record.m_size > 0)
+				{
+					counts[record.m_size]++;
+				}
+				trace.ReleaseConsumed();
+			}
+
+			for (auto& it : counts)
+			{
+				distribution.m_buckets.push_back({ (size_t)it.first, (size_t)it.first, (double)it.second });
+			}
+		}
+		else
+		{
+			std::ifstream file(path);
+			if (!file)
+			{
+				error = "Can't read the histogram " + path;
+				return false;
+			}
+
+			std::string line;
+			while (std::getline(file, line))
+			{
+				if (line.empty() || !isdigit((unsigned char)line[0]))
+				{
+					continue;
+				}
+
+				char* end = nullptr;
+				Bucket bucket;
+				bucket.m_low = (size_t)strtoull(line.c_str(), &end, 10);
+				bucket.m_high = *end == '-' ? (size_t)strtoull(end + 1, &end, 10) : bucket.m_low;
+				while (*end == ' ' || *end == '\t' || *end == ',')
+				{
+					end++;
+				}
+				bucket.m_weight = strtod(end, nullptr);
+
+				if (bucket.m_low > 0 && bucket.m_high >= bucket.m_low && bucket.m_weight > 0.0)
+				{
+					distribution.m_buckets.push_back(bucket);
+				}
+			}
+		}
+
+		if (distribution.m_buckets.empty())
+		{
+			error = "No sizes in the histogram " + path;
+			return false;
+		}
+		return true;
+	}
+
+	ESizeDistribution GetType() const
+	{
+		return m_type;
+	}
+
+	const std::vector<Bucket>& GetBuckets() const
+	{
+		return m_buckets;
+	}
+
+	// "lognormal:MEDIAN:SIGMA", "zipf:EXPONENT" or "histogram:PATH" as the test matrix takes it, empty for the uniform one
+	std::string GetDescription() const
+	{
+		char buffer[64];
+		switch (m_type)
+		{
+		case SizeLogNormal:
+			snprintf(buffer, sizeof(buffer), "lognormal:%g:%g", m_median, m_sigma);
+			return buffer;
+		case SizeZipf:
+			snprintf(buffer, sizeof(buffer), "zipf:%g", m_exponent);
+			return buffer;
+		case SizeHistogram:
+			return "histogram:" + m_path;
+		default:
+			return std::string();
+		}
+	}
+
+	// Builds the tables of the range, must be called before Draw
+	void Prepare(size_t minSize, size_t maxSize)
+	{
+		m_minSize = minSize;
+		m_maxSize = maxSize;
+		m_ranges.clear();
+		m_cumulative.clear();
+
+		if (m_type == SizeZipf)
+		{
+			size_t previous = 0;
+			size_t rank = 0;
+			for (size_t size : GetSizeClasses(maxSize))
+			{
+				if (size >= minSize && previous < maxSize)
+				{
+					rank++;
+					m_ranges.push_back({ (std::max)(previous + 1, minSize), (std::min)(size, maxSize), 1.0 / pow((double)rank, m_exponent) });
+				}
+				previous = size;
+			}
+		}
+		else if (m_type == SizeHistogram)
+		{
+			for (const Bucket& bucket : m_buckets)
+			{
+				if (bucket.m_high >= minSize && bucket.m_low <= maxSize)
+				{
+					// the part of the bucket within the range keeps its share of the weight
+					const size_t low = (std::max)(bucket.m_low, minSize);
+					const size_t high = (std::min)(bucket.m_high, maxSize);
+					const double share = (double)(high - low + 1) / (double)(bucket.m_high - bucket.m_low + 1);
+					m_ranges.push_back({ low, high, bucket.m_weight * share });
+				}
+			}
+		}
+
+		double total = 0.0;
+		for (const Bucket& range : m_ranges)
+		{
+			total += range.m_weight;
+			m_cumulative.push_back(total);
+		}
+	}
+
+	// False if a histogram has no sizes within the range
+	bool IsEmpty() const
+	{
+		return (m_type == SizeZipf || m_type == SizeHistogram) && m_ranges.empty();
+	}
+
+	template<typename TEngine>
+	size_t Draw(TEngine& engine) const
+	{
+		switch (m_type)
+		{
+		case SizeLogNormal:
+		{
+			std::lognormal_distribution<double> lognormal(log(m_median), m_sigma);
+			// the tail beyond the range is redrawn, a clamp would pile it up at the bounds
+			double size = 0.0;
+			for (int i = 0; i < 16; i++)
+			{
+				size = lognormal(engine);
+				if (size >= (double)m_minSize && size < (double)m_maxSize + 1.0)
+				{
+					break;
+				}
+			}
+			return (std::min)((std::max)((size_t)size, m_minSize), m_maxSize);
+		}
+		case SizeZipf:
+		case SizeHistogram:
+		{
+			if (m_ranges.empty())
+			{
+				return m_minSize;
+			}
+
+			std::uniform_real_distribution<double> uniform(0.0, m_cumulative.back());
+			const size_t index = (size_t)(std::upper_bound(m_cumulative.begin(), m_cumulative.end(), uniform(engine)) - m_cumulative.begin());
+			const Bucket& range = m_ranges[(std::min)(index, m_ranges.size() - 1)];
+			return range.m_low + (size_t)(engine() % (range.m_high - range.m_low + 1));
+		}
+		default:
+			return engine() % m_maxSize + m_minSize;
+		}
+	}
+
+	// 1 ... 8, then 4 classes per power of two up to the first class not below maxSize
+	static std::vector<size_t> GetSizeClasses(size_t maxSize)
+	{
+		std::vector<size_t> classes;
+		for (size_t size = 1; size <= 8; size++)
+		{
+			classes.push_back(size);
+		}
+
+		for (size_t base = 8; classes.back() < maxSize; base *= 2)
+		{
+			for (size_t quarter = 1; quarter <= 4; quarter++)
+			{
+				classes.push_back(base + base / 4 * quarter);
+			}
+		}
+		return classes;
+	}
+
+private:
+	ESizeDistribution m_type = SizeUniform;
+	double m_median = 32.0;
+	double m_sigma = 1.0;
+	double m_exponent = 1.0;
+	std::string m_path;
+	std::vector<Bucket> m_buckets;
+
+	size_t m_minSize = 1;
+	size_t m_maxSize = 32;
+	// the classes or the histogram buckets within the range and their cumulative weights
+	std::vector<Bucket> m_ranges;
+	std::vector<double> m_cumulative;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include "AllocatorTraits.h"
+
+// Bytes requested through the StlAllocator copies sharing it
+struct StlAllocatorStats
+{
+	size_t m_liveBytes = 0;
+	size_t m_peakBytes = 0;
+	size_t m_allocations = 0;
+};
+
+// std::allocator-compatible adapter over a contest allocator instance, so the standard containers run on it:
+//     std::map<int, int, std::less<int>, StlAllocator<std::pair<const int, int>, TAllocator>> map(StlAllocator<...>(allocator));
+// The copies and the rebound copies share the instance and are equal if they do, it must outlive the containers.
+// The alignment passed to Allocate is the one of T, not less than the 8 bytes the harness uses,
+// deallocate passes the size to the allocators with the sized Free unless T is over-aligned.
+// With stats the requested bytes are counted, which costs a few additions per call.
+template<typename T, typename TAllocator>
+class StlAllocator
+{
+public:
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	template<typename U>
+	struct rebind
+	{
+		typedef StlAllocator<U, TAllocator> other;
+	};
+
+	explicit StlAllocator(TAllocator& allocator, StlAllocatorStats* stats = nullptr) noexcept
+		: m_allocator(&allocator)
+		, m_stats(stats)
+	{
+	}
+
+	template<typename U>
+	StlAllocator(const StlAllocator<U, TAllocator>& other) noexcept
+		: m_allocator(other.m_allocator)
+		, m_stats(other.m_stats)
+	{
+	}
+
+	T* allocate(size_t count)
+	{
+		const size_t size = count * sizeof(T);
+		void* ptr = m_allocator->Allocate(size, (std::max)(alignof(T), (size_t)8));
+		if (!ptr)
+		{
+			throw std::bad_alloc();
+		}
+
+		if (m_stats)
+		{
+			m_stats->m_liveBytes += size;
+			m_stats->m_peakBytes = (std::max)(m_stats->m_peakBytes, m_stats->m_liveBytes);
+			m_stats->m_allocations++;
+		}
+		return (T*)ptr;
+	}
+
+	void deallocate(T* ptr, size_t count) noexcept
+	{
+		if (m_stats)
+		{
+			m_stats->m_liveBytes -= count * sizeof(T);
+		}
+		if constexpr (alignof(T) <= 8)
+		{
+			FreeBlock(*m_allocator, ptr, count * sizeof(T));
+		}
+		else
+		{
+			m_allocator->Free(ptr);
+		}
+	}
+
+	TAllocator& GetAllocator() const
+	{
+		return *m_allocator;
+	}
+
+	template<typename U>
+	bool operator==(const StlAllocator<U, TAllocator>& other) const noexcept
+	{
+		return m_allocator == other.m_allocator;
+	}
+
+	template<typename U>
+	bool operator!=(const StlAllocator<U, TAllocator>& other) const noexcept
+	{
+		return m_allocator != other.m_allocator;
+	}
+
+private:
+	template<typename, typename>
+	friend class StlAllocator;
+
+	TAllocator* m_allocator;
+	StlAllocatorStats* m_stats;
+};
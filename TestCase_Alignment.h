@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "Harness.h"
+#include "ProcessIsolation.h"
+
+// Over-aligned requests: cache line and SIMD buffers of 16, 32 and 64 bytes alignment among small blocks, 4kb aligned IO buffers
+// among page sized ones. Every group runs first with the alignment of 8, the baseline, then with each of its alignments
+// on the same sizes: the blocks are allocated, the footprint is sampled and they are freed in a shuffled order.
+// Every returned pointer is checked, the time and the memory overhead are compared to the baseline,
+// so an allocator that ignores the alignment shows up as misaligned and one that honors it shows what it costs.
+template<typename TAllocator>
+class TestCase_Alignment
+{
+public:
+	struct AlignmentStats
+	{
+		Timer m_timer;
+		size_t m_allocations = 0;
+		size_t m_misaligned = 0;
+		size_t m_failed = 0;
+		size_t m_requested = 0;
+		size_t m_memoryOverhead = 0;
+		// time of every iteration, exported as the repetitions of the result
+		std::vector<double> m_roundMs;
+	};
+
+	static void RunTests(Result& result, uint32_t seed)
+	{
+		const size_t errorsCount = result.m_errors.size();
+		RunGroup(result, "aligned_small", 16, 512, 200000, { 8, 16, 32, 64 }, seed);
+		RunGroup(result, "aligned_page", 512, 16384, 10000, { 8, 4096 }, seed);
+
+		printf("%s alignment:\n", result.m_allocator.c_str());
+		PrintGroup(result, "aligned_small", { 8, 16, 32, 64 });
+		PrintGroup(result, "aligned_page", { 8, 4096 });
+		for (size_t i = errorsCount; i < result.m_errors.size(); i++)
+		{
+			printf("    %s\n", result.m_errors[i].c_str());
+		}
+		printf("\n");
+	}
+
+	// Every alignment runs in a child process of its own, an allocator that crashes on a large one still gets the others;
+	// the misaligned pointers and the failed allocations are reported in Result::m_errors
+	static void RunGroup(Result& result, const char* name, size_t minSize, size_t maxSize, size_t allocationsCount,
+		const std::vector<size_t>& alignments, uint32_t seed, size_t iterationsCount = 5)
+	{
+		std::default_random_engine rd(128648432u);
+		std::vector<size_t> sizes(allocationsCount);
+		for (size_t& size : sizes)
+		{
+			size = rd() % (maxSize - minSize + 1) + minSize;
+		}
+
+		std::vector<size_t> order(allocationsCount);
+		for (size_t i = 0; i < allocationsCount; i++)
+		{
+			order[i] = i;
+		}
+		std::shuffle(order.begin(), order.end(), std::mt19937(seed));
+
+		std::vector<IsolatedCell> cells;
+		for (size_t alignment : alignments)
+		{
+			const std::string test = std::string(name) + " " + GetTestName(alignment);
+			cells.push_back({ test, [&, alignment, test](Result& cellResult)
+			{
+				AlignmentStats stats;
+				RunAlignment(sizes, order, alignment, iterationsCount, stats);
+
+				const float memoryOverheadMb = (float)((double)stats.m_memoryOverhead / 1048576.0);
+				cellResult.m_results[name][GetTestName(alignment)][stats.m_requested] = { stats.m_timer.ResultAccumulatedMs(), memoryOverheadMb };
+				cellResult.m_statistics[name][GetTestName(alignment)][stats.m_requested] = SampleStatistics::Compute(stats.m_roundMs);
+				if (stats.m_misaligned)
+				{
+					cellResult.m_errors.push_back(test + ": " + std::to_string(stats.m_misaligned) + " of " + std::to_string(stats.m_allocations) + " pointers are misaligned");
+				}
+				if (stats.m_failed)
+				{
+					cellResult.m_errors.push_back(test + ": " + std::to_string(stats.m_failed) + " allocations failed");
+				}
+			} });
+		}
+		RunIsolated(cells, result, 1);
+	}
+
+	// The first alignment is the baseline of the others
+	static void PrintGroup(Result& result, const char* name, const std::vector<size_t>& alignments)
+	{
+		const std::pair<size_t, float>* baseline = nullptr;
+		for (size_t alignment : alignments)
+		{
+			auto& points = result.m_results[name][GetTestName(alignment)];
+			if (points.empty())
+			{
+				printf("    %-14s align %-5zu FAILED\n", name, alignment);
+				continue;
+			}
+
+			const std::pair<size_t, float>& point = points.begin()->second;
+			if (!baseline)
+			{
+				baseline = &point;
+				printf("    %-14s align %-5zu %zums, memory overhead %.2fmb\n", name, alignment, point.first, point.second);
+				continue;
+			}
+
+			printf("    %-14s align %-5zu %zums (x%.2f), memory overhead %.2fmb (%+.2fmb)\n", name, alignment, point.first,
+				baseline->first ? (double)point.first / (double)baseline->first : 0.0, point.second, point.second - baseline->second);
+		}
+	}
+
+	static void RunAlignment(const std::vector<size_t>& sizes, const std::vector<size_t>& order, size_t alignment, size_t iterationsCount, AlignmentStats& stats)
+	{
+		std::vector<void*> ptrs(sizes.size(), nullptr);
+
+		const size_t beforeTest = GetTotalUsedVirtualMemory();
+		{
+			TAllocator allocator;
+
+			for (size_t iteration = 0; iteration < iterationsCount; iteration++)
+			{
+				const int64_t before = stats.m_timer.m_counterAcc;
+				stats.m_timer.Start();
+				for (size_t i = 0; i < sizes.size(); i++)
+				{
+					ptrs[i] = allocator.Allocate(sizes[i], alignment);
+				}
+				stats.m_timer.Stop();
+
+				const size_t used = GetTotalUsedVirtualMemory();
+				const size_t footprint = used > beforeTest ? used - beforeTest : 0;
+				size_t requested = 0;
+				for (size_t i = 0; i < sizes.size(); i++)
+				{
+					if (!ptrs[i])
+					{
+						stats.m_failed++;
+						continue;
+					}
+
+					stats.m_misaligned += ((uintptr_t)ptrs[i] & (alignment - 1)) ? 1 : 0;
+					requested += sizes[i];
+				}
+				stats.m_allocations += sizes.size();
+				stats.m_requested = (std::max)(stats.m_requested, requested);
+				stats.m_memoryOverhead = (std::max)(stats.m_memoryOverhead, footprint > requested ? footprint - requested : 0);
+
+				stats.m_timer.Start();
+				for (size_t i : order)
+				{
+					if (ptrs[i])
+					{
+						allocator.Free(ptrs[i]);
+					}
+				}
+				stats.m_timer.Stop();
+				stats.m_roundMs.push_back(stats.m_timer.ResultAccumulatedMsSince(before));
+			}
+		}
+	}
+
+private:
+	static std::string GetTestName(size_t alignment)
+	{
+		return "align_" + std::to_string(alignment);
+	}
+};
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "AllocatorTraits.h"
+#include "Harness.h"
+
+// TestPerformanceSimple with blocks of one size allocated and freed in batches, like the nodes of a parsed request
+// created at once and destroyed together: BlocksCount blocks are allocated with AllocateBatchBlocks in batches of BatchSize,
+// then freed with FreeBatchBlocks in the same batches and order. The batch of 1 is the same workload with the single calls,
+// the speedup of a batch is relative to it. Allocators without AllocateBatch/FreeBatch run the loops of the fallback,
+// so their speedup shows what the harness alone saves. Every test runs RoundsCount times on one allocator instance,
+// the footprint is sampled outside the timer when all the blocks are allocated. The results go to Result::m_results["batch"].
+template<typename TAllocator>
+class TestCase_Batch
+{
+public:
+	static const size_t BlocksCount = 256 * 1024;
+	static const size_t RoundsCount = 3;
+
+	struct BatchStats
+	{
+		Timer m_timer;
+		size_t m_memoryOverhead = 0;
+		size_t m_failed = 0;
+		// time of every round, exported as the repetitions of the result
+		std::vector<double> m_roundMs;
+	};
+
+	static void RunTests(Result& result)
+	{
+		printf("%s batch (AllocateBatch %s, FreeBatch %s):\n", result.m_allocator.c_str(), HasAllocateBatch<TAllocator>::value ? "native" : "fallback",
+			HasFreeBatch<TAllocator>::value ? "native" : "fallback");
+
+		static const size_t Sizes[] = { 16, 64, 256 };
+		static const size_t BatchSizes[] = { 1, 64, 1024 };
+		for (size_t size : Sizes)
+		{
+			double singleMs = 0.0;
+			for (size_t batchSize : BatchSizes)
+			{
+				const double ms = RunTest(result, size, batchSize);
+				singleMs = batchSize == 1 ? ms : singleMs;
+				if (batchSize > 1)
+				{
+					printf(", %.2fx of single calls", ms > 0.0 ? singleMs / ms : 0.0);
+				}
+				printf("\n");
+			}
+		}
+		printf("\n");
+	}
+
+	// Prints the result without the line end, returns the time in ms
+	static double RunTest(Result& result, size_t size, size_t batchSize)
+	{
+		BatchStats stats;
+		RunBatches(size, batchSize, stats);
+
+		const std::string name = std::to_string(size) + "b_x" + std::to_string(batchSize);
+		const float memoryOverheadMb = (float)((double)stats.m_memoryOverhead / 1048576.0);
+		result.m_results["batch"][name][size * BlocksCount] = { stats.m_timer.ResultAccumulatedMs(), memoryOverheadMb };
+		result.m_statistics["batch"][name][size * BlocksCount] = SampleStatistics::Compute(stats.m_roundMs);
+
+		const double seconds = stats.m_timer.ResultAccumulatedSec();
+		printf("    %-10s %.2fms, %.2f M blocks/s, memory overhead %.2fmb%s", name.c_str(), seconds * 1000.0,
+			seconds > 0.0 ? (double)(BlocksCount * RoundsCount) / seconds * 0.000001 : 0.0, memoryOverheadMb, stats.m_failed ? ", FAILED ALLOCATIONS" : "");
+		return seconds * 1000.0;
+	}
+
+	static void RunBatches(size_t size, size_t batchSize, BatchStats& stats)
+	{
+		std::vector<void*> ptrs(BlocksCount, nullptr);
+		// allocated blocks of every batch, the failed ones leave holes at their ends
+		std::vector<size_t> counts(BlocksCount / batchSize + 1, 0);
+
+		const size_t beforeTest = GetTotalUsedVirtualMemory();
+		{
+			TAllocator allocator;
+
+			for (size_t round = 0; round < RoundsCount; round++)
+			{
+				size_t allocated = 0;
+				const int64_t before = stats.m_timer.m_counterAcc;
+
+				stats.m_timer.Start();
+				if (batchSize == 1)
+				{
+					for (size_t i = 0; i < BlocksCount; i++)
+					{
+						ptrs[i] = allocator.Allocate(size, 8);
+						allocated += ptrs[i] ? 1 : 0;
+					}
+				}
+				else
+				{
+					for (size_t first = 0, batch = 0; first < BlocksCount; first += batchSize, batch++)
+					{
+						counts[batch] = AllocateBatchBlocks(allocator, size, (std::min)(batchSize, BlocksCount - first), &ptrs[first]);
+						allocated += counts[batch];
+					}
+				}
+				stats.m_timer.Stop();
+
+				stats.m_failed += BlocksCount - allocated;
+				const size_t used = GetTotalUsedVirtualMemory();
+				const size_t footprint = used > beforeTest ? used - beforeTest : 0;
+				stats.m_memoryOverhead = (std::max)(stats.m_memoryOverhead, footprint > allocated * size ? footprint - allocated * size : 0);
+
+				stats.m_timer.Start();
+				if (batchSize == 1)
+				{
+					for (size_t i = 0; i < BlocksCount; i++)
+					{
+						if (ptrs[i])
+						{
+							FreeBlock(allocator, ptrs[i], size);
+						}
+					}
+				}
+				else
+				{
+					for (size_t first = 0, batch = 0; first < BlocksCount; first += batchSize, batch++)
+					{
+						FreeBatchBlocks(allocator, &ptrs[first], counts[batch], size);
+					}
+				}
+				stats.m_timer.Stop();
+				stats.m_roundMs.push_back(stats.m_timer.ResultAccumulatedMsSince(before));
+			}
+		}
+	}
+};
@@ -0,0 +1,372 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "Harness.h"
+#include "ProcessIsolation.h"
+#include "TestMatrix.h"
+
+// Steady-state churn: a live set of W blocks is allocated, then every step frees one of them and allocates a replacement,
+// for churn steps x W steps. The block freed is chosen by the lifetime policy from the age order of the live set:
+//     fifo:        the oldest one, every block lives exactly W steps;
+//     lifo:        the youngest one, a stack;
+//     random:      any of them, the lifetimes are geometric with the mean of W steps;
+//     exponential: the k-th youngest with k ~ Exp(W / 8), most blocks die young while a few live very long.
+// The steps run in windows, the victims and the sizes of a window are computed before its timer starts,
+// so the timed loop is only Free + Allocate. After every window the footprint is sampled, its drift from the first window
+// shows how the heap fragments over time. W is the allocations count of a size range and the sizes follow its distribution.
+// The footprint is the committed memory, so the heap a process keeps after the other tests would absorb the blocks
+// and hide the overhead: every run is a child process forked by main before any other test, while the driver heap is small.
+template<typename TAllocator>
+class TestCase_Churn
+{
+public:
+	static const size_t WINDOWS_COUNT = 20;
+
+	// Every size range and lifetime runs in a child process of its own, one at a time, see ProcessIsolation.h
+	static Result RunIsolatedTests(const TestMatrix& matrix, uint32_t seed)
+	{
+		Result result(Platform::DemangleTypeName(typeid(TAllocator).name()));
+
+		std::vector<IsolatedCell> cells;
+		for (const SizeRange& size : matrix.m_sizes)
+		{
+			for (int lifetime = 0; lifetime < ChurnLifetimesCount; lifetime++)
+			{
+				if (matrix.HasChurnLifetime(lifetime))
+				{
+					cells.push_back({ size.m_name + "/churn_" + GetChurnLifetimeName(lifetime),
+						[&size, &matrix, lifetime, seed](Result& cellResult) { RunTest(cellResult, size, matrix, lifetime, seed); } });
+				}
+			}
+		}
+		RunIsolated(cells, result, 1);
+
+		PrintResult(result, matrix);
+		return result;
+	}
+
+	static void RunTest(Result& result, const SizeRange& size, const TestMatrix& matrix, int lifetime, uint32_t seed)
+	{
+		const size_t liveCount = size.m_allocations;
+		const size_t stepsCount = liveCount * matrix.m_churnSteps;
+
+		std::vector<ChurnPoint>& points = result.m_churn[size.m_name][GetChurnLifetimeName(lifetime)];
+		points.clear();
+
+		Timer timer;
+		RunChurn(size, liveCount, stepsCount, lifetime, seed, timer, points);
+		if (points.empty())
+		{
+			return;
+		}
+
+		size_t peakOverhead = 0;
+		size_t liveBytes = 0;
+		for (const ChurnPoint& point : points)
+		{
+			peakOverhead = (std::max)(peakOverhead, point.GetOverhead());
+			liveBytes = (std::max)(liveBytes, point.m_liveBytes);
+		}
+
+		// the windows of the full steps count are the repetitions, the last one may be shorter
+		std::vector<double> windowsMs;
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			const size_t steps = points[i].m_steps - (i ? points[i - 1].m_steps : 0);
+			if (steps == points.front().m_steps && points[i].m_opsPerSec > 0.0)
+			{
+				windowsMs.push_back((double)(2 * steps) / points[i].m_opsPerSec * 1000.0);
+			}
+		}
+
+		const std::string test = std::string("churn_") + GetChurnLifetimeName(lifetime);
+		const float overheadMb = (float)((double)peakOverhead / 1048576.0);
+		result.m_results[size.m_name][test][liveBytes] = { timer.ResultAccumulatedMs(), overheadMb };
+		result.m_statistics[size.m_name][test][liveBytes] = SampleStatistics::Compute(windowsMs);
+	}
+
+	static void PrintResult(const Result& result, const TestMatrix& matrix)
+	{
+		for (const SizeRange& size : matrix.m_sizes)
+		{
+			const size_t stepsCount = size.m_allocations * matrix.m_churnSteps;
+			printf("%s churn %s, %zu live blocks, %zu steps:\n", result.m_allocator.c_str(), size.m_name.c_str(), size.m_allocations, stepsCount);
+
+			auto sizeIt = result.m_churn.find(size.m_name);
+			for (int lifetime = 0; lifetime < ChurnLifetimesCount; lifetime++)
+			{
+				if (!matrix.HasChurnLifetime(lifetime) || sizeIt == result.m_churn.end() || !sizeIt->second.count(GetChurnLifetimeName(lifetime)))
+				{
+					continue;
+				}
+
+				const std::vector<ChurnPoint>& points = sizeIt->second.at(GetChurnLifetimeName(lifetime));
+				const auto& test = result.m_results.at(size.m_name).at(std::string("churn_") + GetChurnLifetimeName(lifetime));
+				if (points.empty() || test.empty())
+				{
+					continue;
+				}
+
+				// the timer runs only in the windows, their times add up to it without the rounding of the ms in m_results
+				size_t failed = 0;
+				size_t steps = 0;
+				double seconds = 0.0;
+				for (const ChurnPoint& point : points)
+				{
+					failed += point.m_failed;
+					seconds += point.m_opsPerSec > 0.0 ? (double)(2 * (point.m_steps - steps)) / point.m_opsPerSec : 0.0;
+					steps = point.m_steps;
+				}
+
+				const double overheadMb = test.begin()->second.second;
+				const double firstOverheadMb = (double)points.front().GetOverhead() / 1048576.0;
+				const double lastOverheadMb = (double)points.back().GetOverhead() / 1048576.0;
+
+				printf("    %-12s %.2f Mops/s (first window %.2f, last %.2f), overhead %.2fmb -> %.2fmb, peak %.2fmb, drift %+.2fmb%s\n",
+					GetChurnLifetimeName(lifetime), seconds > 0.0 ? (double)(2 * steps) / seconds * 0.000001 : 0.0,
+					points.front().m_opsPerSec * 0.000001, points.back().m_opsPerSec * 0.000001,
+					firstOverheadMb, lastOverheadMb, overheadMb, lastOverheadMb - firstOverheadMb, failed ? ", FAILED ALLOCATIONS" : "");
+			}
+			printf("\n");
+		}
+	}
+
+	// Returns the share of the bytes allocated successfully, like the tests of TestCase_MemoryPerformance
+	static float RunChurn(const SizeRange& range, size_t liveCount, size_t stepsCount, int lifetime, uint32_t seed, Timer& timer, std::vector<ChurnPoint>& points)
+	{
+		if (liveCount == 0 || stepsCount == 0)
+		{
+			return 1.0f;
+		}
+
+		std::default_random_engine rd(seed);
+		SizeDistribution distribution = range.m_distribution;
+		distribution.Prepare(range.m_minSize, range.m_maxSize);
+
+		std::mt19937 policy(seed);
+		LiveSet live(liveCount);
+
+		const size_t windowSteps = (std::max)(stepsCount / WINDOWS_COUNT, (size_t)1);
+		std::vector<uint32_t> victims(windowSteps);
+		std::vector<size_t> sizes(windowSteps);
+		std::vector<void*> ptrs(liveCount, nullptr);
+		std::vector<size_t> blockSizes(liveCount, 0);
+		points.reserve(stepsCount / windowSteps + 1);
+
+		size_t totalShouldAllocate = 0;
+		size_t totalAllocated = 0;
+		size_t liveBytes = 0;
+		// the failures of the fill go to the first window
+		size_t failed = 0;
+
+		const size_t beforeTest = GetTotalUsedVirtualMemory();
+		{
+			TAllocator allocator;
+
+			// the live set is filled outside of the timer, only the steady state is measured
+			for (size_t i = 0; i < liveCount; i++)
+			{
+				blockSizes[i] = distribution.Draw(rd);
+				ptrs[i] = allocator.Allocate(blockSizes[i], 8);
+				totalShouldAllocate += blockSizes[i];
+				if (ptrs[i])
+				{
+					totalAllocated += blockSizes[i];
+					liveBytes += blockSizes[i];
+				}
+				else
+				{
+					failed++;
+				}
+			}
+
+			for (size_t step = 0; step < stepsCount;)
+			{
+				const size_t count = (std::min)(windowSteps, stepsCount - step);
+				for (size_t i = 0; i < count; i++)
+				{
+					victims[i] = live.Replace(PickVictim(lifetime, liveCount, policy));
+					sizes[i] = distribution.Draw(rd);
+				}
+
+				const int64_t before = timer.m_counterAcc;
+				timer.Start();
+				for (size_t i = 0; i < count; i++)
+				{
+					const uint32_t slot = victims[i];
+					if (ptrs[slot])
+					{
+						allocator.Free(ptrs[slot]);
+					}
+					ptrs[slot] = allocator.Allocate(sizes[i], 8);
+				}
+				timer.Stop();
+
+				for (size_t i = 0; i < count; i++)
+				{
+					// replayed outside of the timer, the sizes of the window are still there
+					const uint32_t slot = victims[i];
+					liveBytes -= blockSizes[slot];
+					blockSizes[slot] = ptrs[slot] ? sizes[i] : 0;
+					liveBytes += blockSizes[slot];
+					totalShouldAllocate += sizes[i];
+					totalAllocated += blockSizes[slot];
+					failed += ptrs[slot] ? 0 : 1;
+				}
+				step += count;
+
+				ChurnPoint point;
+				point.m_steps = step;
+				const double ms = timer.ResultAccumulatedMsSince(before);
+				point.m_opsPerSec = ms > 0.0 ? (double)(2 * count) / ms * 1000.0 : 0.0;
+				point.m_liveBytes = liveBytes;
+				const size_t used = GetTotalUsedVirtualMemory();
+				point.m_footprint = used > beforeTest ? used - beforeTest : 0;
+				point.m_failed = failed;
+				points.push_back(point);
+				failed = 0;
+			}
+
+			for (size_t i = 0; i < liveCount; i++)
+			{
+				if (ptrs[i])
+				{
+					allocator.Free(ptrs[i]);
+				}
+			}
+		}
+
+		return totalShouldAllocate ? (float)((double)totalAllocated / (double)totalShouldAllocate) : 1.0f;
+	}
+
+private:
+	// Age rank of the block to free, 0 is the youngest
+	static size_t PickVictim(int lifetime, size_t liveCount, std::mt19937& policy)
+	{
+		switch (lifetime)
+		{
+		case ChurnFifo:
+			return liveCount - 1;
+		case ChurnLifo:
+			return 0;
+		case ChurnExponential:
+		{
+			std::exponential_distribution<double> age(8.0 / (double)liveCount);
+			return (std::min)((size_t)age(policy), liveCount - 1);
+		}
+		default:
+			return std::uniform_int_distribution<size_t>(0, liveCount - 1)(policy);
+		}
+	}
+
+	// The slots of the live blocks in the age order: a Fenwick tree of the occupied positions, a block moves to the next free
+	// position when it's replaced, all of them are packed to the beginning when the positions run out.
+	class LiveSet
+	{
+	public:
+		LiveSet(size_t count) : m_count(count), m_capacity(2 * count), m_tree(2 * count + 1, 0), m_slots(2 * count, 0), m_occupied(2 * count, 0)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				m_slots[i] = (uint32_t)i;
+				m_occupied[i] = 1;
+			}
+			m_next = count;
+			Rebuild();
+		}
+
+		// Frees the block of the given age rank and makes its slot the youngest, returns the slot
+		uint32_t Replace(size_t rank)
+		{
+			const size_t position = Find(m_count - rank);
+			const uint32_t slot = m_slots[position];
+			m_occupied[position] = 0;
+			Add(position, -1);
+
+			if (m_next == m_capacity)
+			{
+				Compact();
+			}
+
+			m_slots[m_next] = slot;
+			m_occupied[m_next] = 1;
+			Add(m_next, 1);
+			m_next++;
+			return slot;
+		}
+
+	private:
+		void Add(size_t position, int delta)
+		{
+			for (size_t i = position + 1; i <= m_capacity; i += i & (~i + 1))
+			{
+				m_tree[i] += delta;
+			}
+		}
+
+		// Position of the k-th occupied one, from 1
+		size_t Find(size_t k) const
+		{
+			size_t bit = 1;
+			while (bit * 2 <= m_capacity)
+			{
+				bit *= 2;
+			}
+
+			size_t position = 0;
+			for (; bit; bit /= 2)
+			{
+				if (position + bit <= m_capacity && (size_t)m_tree[position + bit] < k)
+				{
+					position += bit;
+					k -= (size_t)m_tree[position];
+				}
+			}
+			return position;
+		}
+
+		void Compact()
+		{
+			size_t packed = 0;
+			for (size_t i = 0; i < m_next; i++)
+			{
+				if (m_occupied[i])
+				{
+					m_slots[packed++] = m_slots[i];
+				}
+			}
+
+			std::fill(m_occupied.begin(), m_occupied.end(), 0);
+			std::fill(m_occupied.begin(), m_occupied.begin() + packed, 1);
+			m_next = packed;
+			Rebuild();
+		}
+
+		// Linear construction of the tree from m_occupied
+		void Rebuild()
+		{
+			std::fill(m_tree.begin(), m_tree.end(), 0);
+			for (size_t i = 1; i <= m_capacity; i++)
+			{
+				m_tree[i] += m_occupied[i - 1];
+				const size_t parent = i + (i & (~i + 1));
+				if (parent <= m_capacity)
+				{
+					m_tree[parent] += m_tree[i];
+				}
+			}
+		}
+
+		size_t m_count;
+		size_t m_capacity;
+		size_t m_next = 0;
+		std::vector<int> m_tree;
+		std::vector<uint32_t> m_slots;
+		std::vector<uint8_t> m_occupied;
+	};
+};
@@ -0,0 +1,332 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <list>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Harness.h"
+#include "StlAllocator.h"
+
+// The standard containers on the allocator through StlAllocator, the way most code reaches an allocator:
+//     map, list, unordered_map: a node per element, the keys are random and a random half is erased and inserted again;
+//     string: strings of 16-256 chars appended in pieces of 4-32 chars, then every pair is joined into a new string;
+//     vector: vectors growing by push_back round-robin up to random lengths, then shrunk and grown again.
+// Every workload runs RoundsCount times on one allocator instance. The timer covers the container operations,
+// the footprint is sampled when the containers are the largest, outside the timer, and the overhead is the footprint
+// above the peak of the bytes requested by the containers. The results go to Result::m_results["containers"].
+template<typename TAllocator>
+class TestCase_Containers
+{
+public:
+	static const size_t RoundsCount = 3;
+
+	struct ContainerStats
+	{
+		Timer m_timer;
+		size_t m_operations = 0;
+		size_t m_footprint = 0;
+		StlAllocatorStats m_requested;
+		// time of every round, exported as the repetitions of the result
+		std::vector<double> m_roundMs;
+	};
+
+	template<typename T>
+	using Allocator = StlAllocator<T, TAllocator>;
+
+	typedef std::map<uint64_t, uint64_t, std::less<uint64_t>, Allocator<std::pair<const uint64_t, uint64_t>>> Map;
+	typedef std::list<uint64_t, Allocator<uint64_t>> List;
+	typedef std::unordered_map<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>, Allocator<std::pair<const uint64_t, uint64_t>>> UnorderedMap;
+	typedef std::basic_string<char, std::char_traits<char>, Allocator<char>> String;
+	typedef std::vector<uint32_t, Allocator<uint32_t>> Vector;
+
+	static void RunTests(Result& result, uint32_t seed)
+	{
+		printf("%s containers:\n", result.m_allocator.c_str());
+		RunTest(result, "map", seed, RunMap);
+		RunTest(result, "list", seed, RunList);
+		RunTest(result, "unordered_map", seed, RunUnorderedMap);
+		RunTest(result, "string", seed, RunString);
+		RunTest(result, "vector", seed, RunVector);
+		printf("\n");
+	}
+
+	static void RunTest(Result& result, const char* name, uint32_t seed, void (*workload)(TAllocator&, ContainerStats&, std::mt19937&, size_t))
+	{
+		ContainerStats stats;
+		std::mt19937 random(seed);
+
+		const size_t beforeTest = GetTotalUsedVirtualMemory();
+		{
+			TAllocator allocator;
+			for (size_t round = 0; round < RoundsCount; round++)
+			{
+				const int64_t before = stats.m_timer.m_counterAcc;
+				workload(allocator, stats, random, beforeTest);
+				stats.m_roundMs.push_back(stats.m_timer.ResultAccumulatedMsSince(before));
+			}
+		}
+
+		const size_t overhead = stats.m_footprint > stats.m_requested.m_peakBytes ? stats.m_footprint - stats.m_requested.m_peakBytes : 0;
+		const float memoryOverheadMb = (float)((double)overhead / 1048576.0);
+		const float peakMb = (float)((double)stats.m_requested.m_peakBytes / 1048576.0);
+		const float ms = (float)stats.m_timer.ResultAccumulatedMs();
+		result.m_results["containers"][name][stats.m_requested.m_peakBytes] = { stats.m_timer.ResultAccumulatedMs(), memoryOverheadMb };
+		result.m_statistics["containers"][name][stats.m_requested.m_peakBytes] = SampleStatistics::Compute(stats.m_roundMs);
+
+		const double seconds = stats.m_timer.ResultAccumulatedSec();
+		const float score = ms > 0.0f ? CalculateScore(ms, memoryOverheadMb, 5.0f, peakMb) : 0.0f;
+		printf("    %-14s score %.2f, %.2fms, %.2f Mops/s, footprint %.2fmb for %.2fmb requested in %zu allocations, memory overhead %.2fmb\n",
+			name, score, seconds * 1000.0, seconds > 0.0 ? (double)stats.m_operations / seconds * 0.000001 : 0.0,
+			(double)stats.m_footprint / 1048576.0, peakMb, stats.m_requested.m_allocations, memoryOverheadMb);
+	}
+
+	// 200000 inserts, finds and a random half erased and inserted again
+	static void RunMap(TAllocator& allocator, ContainerStats& stats, std::mt19937& random, size_t beforeTest)
+	{
+		const std::vector<uint64_t> keys = GetKeys(random, 200000);
+		const std::vector<uint64_t> erased = GetHalf(random, keys);
+
+		Map map{ Allocator<std::pair<const uint64_t, uint64_t>>(allocator, &stats.m_requested) };
+
+		stats.m_timer.Start();
+		for (uint64_t key : keys)
+		{
+			map.emplace(key, key);
+		}
+		for (uint64_t key : keys)
+		{
+			stats.m_operations += map.count(key);
+		}
+		stats.m_timer.Stop();
+
+		Sample(stats, beforeTest);
+
+		stats.m_timer.Start();
+		for (uint64_t key : erased)
+		{
+			map.erase(key);
+		}
+		for (uint64_t key : erased)
+		{
+			map.emplace(key, key);
+		}
+		map.clear();
+		stats.m_timer.Stop();
+
+		stats.m_operations += keys.size() + erased.size() * 2;
+	}
+
+	// 200000 push_back, every other one erased and as many push_front, then the list is sorted and destroyed
+	static void RunList(TAllocator& allocator, ContainerStats& stats, std::mt19937& random, size_t beforeTest)
+	{
+		const std::vector<uint64_t> keys = GetKeys(random, 200000);
+
+		List list{ Allocator<uint64_t>(allocator, &stats.m_requested) };
+
+		stats.m_timer.Start();
+		for (uint64_t key : keys)
+		{
+			list.push_back(key);
+		}
+		stats.m_timer.Stop();
+
+		Sample(stats, beforeTest);
+
+		stats.m_timer.Start();
+		size_t erased = 0;
+		for (auto it = list.begin(); it != list.end(); erased++)
+		{
+			it = list.erase(it);
+			if (it != list.end())
+			{
+				++it;
+			}
+		}
+		for (size_t i = 0; i < erased; i++)
+		{
+			list.push_front(keys[i]);
+		}
+		list.sort();
+		list.clear();
+		stats.m_timer.Stop();
+
+		stats.m_operations += keys.size() + erased * 2;
+	}
+
+	// 200000 inserts, finds and a random half erased and inserted again, the table grows from the default buckets count
+	static void RunUnorderedMap(TAllocator& allocator, ContainerStats& stats, std::mt19937& random, size_t beforeTest)
+	{
+		const std::vector<uint64_t> keys = GetKeys(random, 200000);
+		const std::vector<uint64_t> erased = GetHalf(random, keys);
+
+		UnorderedMap map{ 0, std::hash<uint64_t>(), std::equal_to<uint64_t>(), Allocator<std::pair<const uint64_t, uint64_t>>(allocator, &stats.m_requested) };
+
+		stats.m_timer.Start();
+		for (uint64_t key : keys)
+		{
+			map.emplace(key, key);
+		}
+		for (uint64_t key : keys)
+		{
+			stats.m_operations += map.count(key);
+		}
+		stats.m_timer.Stop();
+
+		Sample(stats, beforeTest);
+
+		stats.m_timer.Start();
+		for (uint64_t key : erased)
+		{
+			map.erase(key);
+		}
+		for (uint64_t key : erased)
+		{
+			map.emplace(key, key);
+		}
+		map.clear();
+		stats.m_timer.Stop();
+
+		stats.m_operations += keys.size() + erased.size() * 2;
+	}
+
+	// 50000 strings of 16-256 chars built by appends of 4-32 chars, then joined by pairs
+	static void RunString(TAllocator& allocator, ContainerStats& stats, std::mt19937& random, size_t beforeTest)
+	{
+		static const size_t StringsCount = 50000;
+
+		std::uniform_int_distribution<size_t> lengths(16, 256);
+		std::uniform_int_distribution<size_t> pieces(4, 32);
+		std::vector<size_t> plan;
+		for (size_t i = 0; i < StringsCount; i++)
+		{
+			for (size_t length = lengths(random); length > 0;)
+			{
+				const size_t piece = (std::min)(length, pieces(random));
+				plan.push_back(piece);
+				length -= piece;
+			}
+			plan.push_back(0);
+		}
+		const std::string text(32, 'x');
+
+		const Allocator<char> charAllocator(allocator, &stats.m_requested);
+		std::vector<String, Allocator<String>> strings{ Allocator<String>(charAllocator) };
+		std::vector<String, Allocator<String>> joined{ Allocator<String>(charAllocator) };
+
+		stats.m_timer.Start();
+		strings.emplace_back(charAllocator);
+		for (size_t piece : plan)
+		{
+			if (piece == 0)
+			{
+				strings.emplace_back(charAllocator);
+				continue;
+			}
+			strings.back().append(text.data(), piece);
+		}
+		strings.pop_back();
+
+		for (size_t i = 0; i + 1 < strings.size(); i += 2)
+		{
+			joined.emplace_back(strings[i] + strings[i + 1]);
+		}
+		stats.m_timer.Stop();
+
+		Sample(stats, beforeTest);
+
+		stats.m_timer.Start();
+		strings.clear();
+		joined.clear();
+		strings.shrink_to_fit();
+		joined.shrink_to_fit();
+		stats.m_timer.Stop();
+
+		stats.m_operations += plan.size() + StringsCount / 2;
+	}
+
+	// 1000 vectors growing by push_back round-robin up to 1-4096 elements, then shrunk to half and grown back
+	static void RunVector(TAllocator& allocator, ContainerStats& stats, std::mt19937& random, size_t beforeTest)
+	{
+		static const size_t VectorsCount = 1000;
+
+		std::uniform_int_distribution<size_t> lengths(1, 4096);
+		std::vector<size_t> targets(VectorsCount);
+		for (size_t& target : targets)
+		{
+			target = lengths(random);
+		}
+
+		const Allocator<uint32_t> elementAllocator(allocator, &stats.m_requested);
+		std::vector<Vector, Allocator<Vector>> vectors(VectorsCount, Vector(elementAllocator), Allocator<Vector>(elementAllocator));
+
+		stats.m_timer.Start();
+		size_t pushes = Grow(vectors, targets);
+		stats.m_timer.Stop();
+
+		Sample(stats, beforeTest);
+
+		stats.m_timer.Start();
+		for (Vector& vector : vectors)
+		{
+			vector.resize(vector.size() / 2);
+			vector.shrink_to_fit();
+		}
+		pushes += Grow(vectors, targets);
+		vectors.clear();
+		stats.m_timer.Stop();
+
+		stats.m_operations += pushes;
+	}
+
+private:
+	static std::vector<uint64_t> GetKeys(std::mt19937& random, size_t count)
+	{
+		std::vector<uint64_t> keys(count);
+		for (uint64_t& key : keys)
+		{
+			key = ((uint64_t)random() << 32) | random();
+		}
+		return keys;
+	}
+
+	static std::vector<uint64_t> GetHalf(std::mt19937& random, const std::vector<uint64_t>& keys)
+	{
+		std::vector<uint64_t> half = keys;
+		std::shuffle(half.begin(), half.end(), random);
+		half.resize(half.size() / 2);
+		return half;
+	}
+
+	// push_back to every vector shorter than its target in turn, returns the pushes count
+	template<typename TVectors>
+	static size_t Grow(TVectors& vectors, const std::vector<size_t>& targets)
+	{
+		size_t pushes = 0;
+		for (bool bGrowing = true; bGrowing;)
+		{
+			bGrowing = false;
+			for (size_t v = 0; v < vectors.size(); v++)
+			{
+				if (vectors[v].size() < targets[v])
+				{
+					vectors[v].push_back((uint32_t)v);
+					pushes++;
+					bGrowing = true;
+				}
+			}
+		}
+		return pushes;
+	}
+
+	static void Sample(ContainerStats& stats, size_t beforeTest)
+	{
+		const size_t used = GetTotalUsedVirtualMemory();
+		stats.m_footprint = (std::max)(stats.m_footprint, used > beforeTest ? used - beforeTest : (size_t)0);
+	}
+};
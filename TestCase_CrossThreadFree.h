@@ -0,0 +1,324 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include "Harness.h"
+#include "LockedAllocator.h"
+#include "TestMatrix.h"
+
+// Bounded lock-free single producer / single consumer queue
+template<typename T>
+class SpscRingBuffer
+{
+public:
+	// capacity is rounded up to the power of two
+	SpscRingBuffer(size_t capacity)
+	{
+		size_t size = 1;
+		while (size < capacity)
+		{
+			size <<= 1;
+		}
+
+		m_items.resize(size);
+		m_mask = size - 1;
+	}
+
+	inline bool TryPush(const T& item)
+	{
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) > m_mask)
+		{
+			return false;
+		}
+
+		m_items[tail & m_mask] = item;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	inline bool TryPop(T& item)
+	{
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		item = m_items[head & m_mask];
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	std::vector<T> m_items;
+	size_t m_mask = 0;
+
+	alignas(64) std::atomic<size_t> m_head{ 0 };
+	alignas(64) std::atomic<size_t> m_tail{ 0 };
+};
+
+// Cross-thread free stress test: producers Allocate and pass the pointers through SpscRingBuffer to consumers,
+// which Free them. Every producer has its own consumer, the pairs run on 1, 2, 4 ... hardware_concurrency / 2.
+// The sizes are the size ranges of the matrix, a producer allocates a fifth of the allocations count of the range,
+// the ring holds up to 16mb of the largest blocks. The timer stops when the last thread finishes,
+// the peak memory is sampled by a thread of its own outside of the measured threads.
+// The allocator is either shared by all the threads ("shared") or there is one instance per pair ("per-pair"),
+// in both cases behind TLock, so only the allocators that are safe to free from another thread can use NoLock.
+template<typename TAllocator, typename TLock = MutexLock>
+class TestCase_CrossThreadFree
+{
+public:
+	typedef LockedAllocator<TAllocator, TLock> SharedAllocator;
+
+	static const size_t RING_BYTES = 16 * 1024 * 1024;
+	static const size_t MAX_RING_CAPACITY = 1024;
+
+	static void RunTests(Result& result, const TestMatrix& matrix, bool bPerPair = true)
+	{
+		for (const SizeRange& size : matrix.m_sizes)
+		{
+			const size_t allocationsPerProducer = (std::max)(size.m_allocations / 5, (size_t)1);
+			const size_t ringCapacity = (std::min)((std::max)(RING_BYTES / (std::max)(size.m_maxSize, (size_t)1), (size_t)2), MAX_RING_CAPACITY);
+			MergeInto(result.m_scaling[size.m_name], RunProducerConsumerTests(size.m_minSize, size.m_maxSize, allocationsPerProducer, ringCapacity, bPerPair));
+		}
+
+		printf("%s producer/consumer:\n", result.m_allocator.c_str());
+		for (const SizeRange& size : matrix.m_sizes)
+		{
+			PrintProducerConsumer(size.m_name.c_str(), result.m_scaling[size.m_name]);
+		}
+		printf("\n");
+	}
+
+	// Returns "producer-consumer/shared" and "producer-consumer/per-pair" curves, m_threads counts both producers and consumers
+	static ScalingResult RunProducerConsumerTests(const size_t MinSize = 1, const size_t MaxSize = 32, const size_t AllocationsPerProducer = 200000,
+		const size_t RingCapacity = 1024, bool bPerPair = true, size_t maxPairs = 0)
+	{
+		if (maxPairs == 0)
+		{
+			maxPairs = (std::max)((size_t)std::thread::hardware_concurrency() / 2, (size_t)1);
+		}
+
+		std::vector<size_t> pairsCounts;
+		for (size_t pairs = 1; pairs < maxPairs; pairs <<= 1)
+		{
+			pairsCounts.push_back(pairs);
+		}
+		pairsCounts.push_back(maxPairs);
+
+		std::vector<std::vector<size_t>> sizesToAllocate(maxPairs);
+		for (size_t p = 0; p < maxPairs; p++)
+		{
+			std::default_random_engine rd(128648432u + (uint32_t)p);
+
+			sizesToAllocate[p].resize(AllocationsPerProducer);
+			for (size_t i = 0; i < AllocationsPerProducer; ++i)
+			{
+				sizesToAllocate[p][i] = rd() % MaxSize + MinSize;
+			}
+		}
+
+		ScalingResult result;
+
+		for (int mode = 0; mode < 2; mode++)
+		{
+			const bool bShared = mode == 0;
+			if (!bShared && !bPerPair)
+			{
+				continue;
+			}
+
+			std::vector<ScalingPoint>& points = result[bShared ? "producer-consumer/shared" : "producer-consumer/per-pair"];
+
+			for (size_t pairs : pairsCounts)
+			{
+				Timer timer;
+				size_t peakMemory = 0;
+				RunPairs(pairs, sizesToAllocate, RingCapacity, bShared, timer, peakMemory);
+
+				const double opsCount = 2.0 * (double)AllocationsPerProducer * (double)pairs;
+				const double seconds = timer.ResultAccumulatedSec();
+
+				ScalingPoint point;
+				point.m_threads = pairs * 2;
+				point.m_ms = timer.ResultAccumulatedMs();
+				point.m_opsPerSec = seconds > 0.0 ? opsCount / seconds : 0.0;
+				point.m_peakMemoryMb = (float)((double)peakMemory / 1048576.0);
+				points.push_back(point);
+			}
+
+			for (ScalingPoint& point : points)
+			{
+				const double ideal = points[0].m_opsPerSec * (double)point.m_threads / (double)points[0].m_threads;
+				point.m_efficiency = ideal > 0.0 ? point.m_opsPerSec / ideal : 0.0;
+			}
+		}
+
+		return result;
+	}
+
+	static void PrintProducerConsumer(const char* sizeName, ScalingResult& scaling)
+	{
+		static const char* keys[] = { "producer-consumer/shared", "producer-consumer/per-pair" };
+
+		for (const char* key : keys)
+		{
+			auto it = scaling.find(key);
+			if (it == scaling.end())
+			{
+				continue;
+			}
+
+			printf("    %-7s %-26s", sizeName, key);
+			for (const ScalingPoint& point : it->second)
+			{
+				printf(" %3zu: %7.2f Mops/s, peak %.2fmb", point.m_threads, point.m_opsPerSec * 0.000001, point.m_peakMemoryMb);
+			}
+			printf("\n");
+		}
+	}
+
+private:
+
+	static void MergeInto(ScalingResult& to, const ScalingResult& from)
+	{
+		for (auto& it : from)
+		{
+			to[it.first] = it.second;
+		}
+	}
+
+	static void Produce(SharedAllocator& allocator, const std::vector<size_t>& sizesToAllocate, SpscRingBuffer<void*>& ring)
+	{
+		for (size_t i = 0; i < sizesToAllocate.size(); ++i)
+		{
+			void* ptr = allocator.Allocate(sizesToAllocate[i], 1);
+			if (ptr)
+			{
+				// the buffer is really used by both threads
+				*(uint8_t*)ptr = (uint8_t)i;
+			}
+
+			while (!ring.TryPush(ptr))
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	static size_t Consume(SharedAllocator& allocator, size_t count, SpscRingBuffer<void*>& ring)
+	{
+		size_t checksum = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			void* ptr = nullptr;
+			while (!ring.TryPop(ptr))
+			{
+				std::this_thread::yield();
+			}
+
+			if (ptr)
+			{
+				checksum += *(uint8_t*)ptr;
+				allocator.Free(ptr);
+			}
+		}
+
+		return checksum;
+	}
+
+	static void RunPairs(size_t pairsCount, const std::vector<std::vector<size_t>>& sizesToAllocate, size_t ringCapacity, bool bShared,
+		Timer& timer, size_t& peakMemory)
+	{
+		std::vector<std::unique_ptr<SharedAllocator>> allocators(bShared ? 1 : pairsCount);
+		for (auto& allocator : allocators)
+		{
+			allocator.reset(new SharedAllocator());
+		}
+
+		std::vector<std::unique_ptr<SpscRingBuffer<void*>>> rings(pairsCount);
+		for (auto& ring : rings)
+		{
+			ring.reset(new SpscRingBuffer<void*>(ringCapacity));
+		}
+
+		std::atomic<size_t> ready{ 0 };
+		std::atomic<size_t> checksum{ 0 };
+		std::atomic<bool> bGo{ false };
+		// the timer counter when every thread finished, the test ends at the latest one
+		std::vector<int64_t> finishCounters(pairsCount * 2, 0);
+
+		std::vector<std::thread> threads;
+		threads.reserve(pairsCount * 2);
+
+		for (size_t p = 0; p < pairsCount; p++)
+		{
+			SharedAllocator* allocator = allocators[bShared ? 0 : p].get();
+			SpscRingBuffer<void*>* ring = rings[p].get();
+			const std::vector<size_t>* sizes = &sizesToAllocate[p];
+			int64_t* producerFinish = &finishCounters[2 * p];
+			int64_t* consumerFinish = &finishCounters[2 * p + 1];
+
+			threads.emplace_back([&, allocator, ring, sizes, producerFinish]()
+				{
+					ready.fetch_add(1);
+					while (!bGo.load(std::memory_order_acquire))
+					{
+						std::this_thread::yield();
+					}
+
+					Produce(*allocator, *sizes, *ring);
+					*producerFinish = Platform::QueryTimerCounter();
+				});
+
+			threads.emplace_back([&, allocator, ring, sizes, consumerFinish]()
+				{
+					ready.fetch_add(1);
+					while (!bGo.load(std::memory_order_acquire))
+					{
+						std::this_thread::yield();
+					}
+
+					checksum.fetch_add(Consume(*allocator, sizes->size(), *ring));
+					*consumerFinish = Platform::QueryTimerCounter();
+				});
+		}
+
+		while (ready.load() < threads.size())
+		{
+			std::this_thread::yield();
+		}
+
+		const size_t beforeTest = GetTotalUsedVirtualMemory();
+		size_t peakUsage = beforeTest;
+		std::atomic<bool> bSampling{ true };
+		std::thread sampler([&]()
+			{
+				while (bSampling.load(std::memory_order_acquire))
+				{
+					peakUsage = (std::max)(peakUsage, GetTotalUsedVirtualMemory());
+					std::this_thread::sleep_for(std::chrono::microseconds(200));
+				}
+			});
+
+		timer.Start();
+		bGo.store(true, std::memory_order_release);
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		timer.StopAt(*std::max_element(finishCounters.begin(), finishCounters.end()));
+
+		bSampling.store(false, std::memory_order_release);
+		sampler.join();
+
+		peakMemory = peakUsage - beforeTest;
+	}
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "AllocatorTraits.h"
+#include "FragmentationAnalyzer.h"
+#include "Harness.h"
+#include "TestMatrix.h"
+
+// Heap state after a random half of the blocks is freed: the allocations count of every size range is allocated
+// with its size distribution, a shuffled half of it is freed and the allocator is walked with FragmentationAnalyzer.
+// Only the allocators with WalkHeap (AllocatorTraits.h) can be analyzed, the heap maps of the regions go to heap_map.txt.
+template<typename TAllocator>
+class TestCase_Fragmentation
+{
+public:
+	// Heap maps printed per size range, all of them are in Result::m_fragmentation
+	static const size_t PRINTED_MAPS_COUNT = 8;
+
+	static void RunTests(Result& result, const TestMatrix& matrix, uint32_t seed)
+	{
+		if constexpr (!HasWalkHeap<TAllocator>::value)
+		{
+			printf("%s fragmentation: no WalkHeap, skipped\n\n", result.m_allocator.c_str());
+		}
+		else
+		{
+			printf("%s fragmentation after freeing a random half:\n", result.m_allocator.c_str());
+			for (const SizeRange& size : matrix.m_sizes)
+			{
+				FragmentationStats& stats = result.m_fragmentation[size.m_name];
+				stats = FragmentationStats();
+				Analyze(size, seed, stats);
+
+				printf("    %-8s %zu regions %.2fmb: allocated %.2fmb for %.2fmb requested (internal %.1f%%), "
+					"free %.2fmb in %zu blocks, largest %.2fmb (external %.1f%%), metadata %.2fmb",
+					size.m_name.c_str(), stats.m_regions, ToMb(stats.m_regionBytes), ToMb(stats.m_allocatedBytes), ToMb(stats.m_requestedBytes),
+					stats.GetInternal() * 100.0, ToMb(stats.m_freeBytes), stats.m_freeBlocks, ToMb(stats.m_largestFreeBlock),
+					stats.GetExternal() * 100.0, ToMb(stats.GetMetadataBytes()));
+				if (stats.m_untrackedBytes)
+				{
+					printf(", %.2fmb allocated but not held by the test", ToMb(stats.m_untrackedBytes));
+				}
+				printf("\n");
+
+				for (size_t i = 0; i < stats.m_heapMaps.size() && i < PRINTED_MAPS_COUNT; i++)
+				{
+					printf("        %s\n", stats.m_heapMaps[i].c_str());
+				}
+				if (stats.m_heapMaps.size() > PRINTED_MAPS_COUNT)
+				{
+					printf("        ... %zu more regions\n", stats.m_heapMaps.size() - PRINTED_MAPS_COUNT);
+				}
+			}
+			printf("\n");
+		}
+	}
+
+	static void Analyze(const SizeRange& range, uint32_t seed, FragmentationStats& stats)
+	{
+		std::default_random_engine rd(128648432u);
+		SizeDistribution distribution = range.m_distribution;
+		distribution.Prepare(range.m_minSize, range.m_maxSize);
+
+		std::vector<void*> ptrs(range.m_allocations, nullptr);
+		std::vector<size_t> sizes(range.m_allocations, 0);
+		std::vector<size_t> order(range.m_allocations);
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			order[i] = i;
+		}
+		std::shuffle(order.begin(), order.end(), std::mt19937(seed));
+
+		TAllocator allocator;
+		for (size_t i = 0; i < ptrs.size(); i++)
+		{
+			sizes[i] = distribution.Draw(rd);
+			ptrs[i] = allocator.Allocate(sizes[i], 8);
+		}
+
+		for (size_t i = 0; i < order.size() / 2; i++)
+		{
+			void*& ptr = ptrs[order[i]];
+			if (ptr)
+			{
+				allocator.Free(ptr);
+				ptr = nullptr;
+			}
+		}
+
+		std::unordered_map<const void*, size_t> requested;
+		requested.reserve(ptrs.size());
+		for (size_t i = 0; i < ptrs.size(); i++)
+		{
+			if (ptrs[i])
+			{
+				requested[ptrs[i]] = sizes[i];
+			}
+		}
+
+		{
+			FragmentationAnalyzer analyzer(requested, stats);
+			allocator.WalkHeap(analyzer);
+		}
+
+		for (void* ptr : ptrs)
+		{
+			if (ptr)
+			{
+				allocator.Free(ptr);
+			}
+		}
+	}
+
+private:
+	static double ToMb(size_t bytes)
+	{
+		return (double)bytes / 1048576.0;
+	}
+};
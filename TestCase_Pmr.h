@@ -0,0 +1,337 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <map>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <vector>
+#include "Harness.h"
+#include "PmrResource.h"
+
+// Timings and footprint of a workload, the footprint is sampled outside the timer when the containers are the largest
+struct PmrStats
+{
+	Timer m_timer;
+	size_t m_operations = 0;
+	size_t m_footprint = 0;
+	// time of every round, exported as the repetitions of the result
+	std::vector<double> m_roundMs;
+};
+
+// The workloads of TestCase_Pmr on any memory_resource, and their runs on the standard resources to compare with:
+//     map:    std::pmr::map of 200000 random keys, a random half erased and inserted again;
+//     list:   std::pmr::list of 200000 elements, every other one erased and as many pushed to the front;
+//     string: std::pmr::vector of 50000 std::pmr::string of 16-256 chars built by appends of 4-32 chars.
+// The standard resources are new_delete_resource, unsynchronized_pool_resource and monotonic_buffer_resource
+// over new_delete_resource, run once per workload and reused by every allocator.
+class PmrWorkloads
+{
+public:
+	static const size_t RoundsCount = 3;
+
+	typedef void (*Workload)(std::pmr::memory_resource*, PmrStats&, std::mt19937&, size_t);
+
+	struct Baseline
+	{
+		// peak of the bytes the containers request, the same for every resource
+		size_t m_requestedBytes = 0;
+		double m_newDeleteMs = 0.0;
+		double m_poolMs = 0.0;
+		double m_monotonicMs = 0.0;
+	};
+
+	static void RunMap(std::pmr::memory_resource* resource, PmrStats& stats, std::mt19937& random, size_t beforeTest)
+	{
+		std::vector<uint64_t> keys(200000);
+		for (uint64_t& key : keys)
+		{
+			key = ((uint64_t)random() << 32) | random();
+		}
+		std::vector<uint64_t> erased = keys;
+		std::shuffle(erased.begin(), erased.end(), random);
+		erased.resize(erased.size() / 2);
+
+		std::pmr::map<uint64_t, uint64_t> map(resource);
+
+		stats.m_timer.Start();
+		for (uint64_t key : keys)
+		{
+			map.emplace(key, key);
+		}
+		stats.m_timer.Stop();
+
+		Sample(stats, beforeTest);
+
+		stats.m_timer.Start();
+		for (uint64_t key : erased)
+		{
+			map.erase(key);
+		}
+		for (uint64_t key : erased)
+		{
+			map.emplace(key, key);
+		}
+		map.clear();
+		stats.m_timer.Stop();
+
+		stats.m_operations += keys.size() + erased.size() * 2;
+	}
+
+	static void RunList(std::pmr::memory_resource* resource, PmrStats& stats, std::mt19937& random, size_t beforeTest)
+	{
+		const size_t ElementsCount = 200000;
+		const uint64_t value = random();
+
+		std::pmr::list<uint64_t> list(resource);
+
+		stats.m_timer.Start();
+		for (size_t i = 0; i < ElementsCount; i++)
+		{
+			list.push_back(value + i);
+		}
+		stats.m_timer.Stop();
+
+		Sample(stats, beforeTest);
+
+		stats.m_timer.Start();
+		size_t erased = 0;
+		for (auto it = list.begin(); it != list.end(); erased++)
+		{
+			it = list.erase(it);
+			if (it != list.end())
+			{
+				++it;
+			}
+		}
+		for (size_t i = 0; i < erased; i++)
+		{
+			list.push_front(value - i);
+		}
+		list.clear();
+		stats.m_timer.Stop();
+
+		stats.m_operations += ElementsCount + erased * 2;
+	}
+
+	static void RunString(std::pmr::memory_resource* resource, PmrStats& stats, std::mt19937& random, size_t beforeTest)
+	{
+		const size_t StringsCount = 50000;
+
+		std::uniform_int_distribution<size_t> lengths(16, 256);
+		std::uniform_int_distribution<size_t> pieces(4, 32);
+		std::vector<size_t> plan;
+		for (size_t i = 0; i < StringsCount; i++)
+		{
+			for (size_t length = lengths(random); length > 0;)
+			{
+				const size_t piece = (std::min)(length, pieces(random));
+				plan.push_back(piece);
+				length -= piece;
+			}
+			plan.push_back(0);
+		}
+		const std::string text(32, 'x');
+
+		std::pmr::vector<std::pmr::string> strings(resource);
+
+		stats.m_timer.Start();
+		strings.emplace_back();
+		for (size_t piece : plan)
+		{
+			if (piece == 0)
+			{
+				strings.emplace_back();
+				continue;
+			}
+			strings.back().append(text.data(), piece);
+		}
+		strings.pop_back();
+		stats.m_timer.Stop();
+
+		Sample(stats, beforeTest);
+
+		stats.m_timer.Start();
+		strings.clear();
+		strings.shrink_to_fit();
+		stats.m_timer.Stop();
+
+		stats.m_operations += plan.size();
+	}
+
+	// RoundsCount rounds of the workload with a fresh random sequence from seed
+	static void Run(std::pmr::memory_resource* resource, Workload workload, uint32_t seed, PmrStats& stats, size_t beforeTest)
+	{
+		std::mt19937 random(seed);
+		for (size_t round = 0; round < RoundsCount; round++)
+		{
+			const int64_t before = stats.m_timer.m_counterAcc;
+			workload(resource, stats, random, beforeTest);
+			stats.m_roundMs.push_back(stats.m_timer.ResultAccumulatedMsSince(before));
+		}
+	}
+
+	// The standard resources on the workload, measured on the first call and kept for the next allocators
+	static const Baseline& GetBaseline(const char* name, Workload workload, uint32_t seed)
+	{
+		static std::map<std::string, Baseline> baselines;
+
+		auto it = baselines.find(name);
+		if (it != baselines.end())
+		{
+			return it->second;
+		}
+
+		Baseline& baseline = baselines[name];
+		{
+			CountingResource counting;
+			PmrStats stats;
+			Run(&counting, workload, seed, stats, 0);
+			baseline.m_requestedBytes = counting.m_peakBytes;
+		}
+		{
+			PmrStats stats;
+			Run(std::pmr::new_delete_resource(), workload, seed, stats, 0);
+			baseline.m_newDeleteMs = stats.m_timer.ResultAccumulatedSec() * 1000.0;
+		}
+		{
+			std::pmr::unsynchronized_pool_resource pool(std::pmr::new_delete_resource());
+			PmrStats stats;
+			Run(&pool, workload, seed, stats, 0);
+			baseline.m_poolMs = stats.m_timer.ResultAccumulatedSec() * 1000.0;
+		}
+		{
+			std::pmr::monotonic_buffer_resource monotonic(std::pmr::new_delete_resource());
+			PmrStats stats;
+			Run(&monotonic, workload, seed, stats, 0);
+			baseline.m_monotonicMs = stats.m_timer.ResultAccumulatedSec() * 1000.0;
+		}
+
+		printf("    %-8s std::pmr new_delete %.2fms, unsynchronized_pool %.2fms, monotonic_buffer %.2fms\n",
+			name, baseline.m_newDeleteMs, baseline.m_poolMs, baseline.m_monotonicMs);
+		return baseline;
+	}
+
+private:
+	// new_delete_resource counting the live bytes
+	class CountingResource : public std::pmr::memory_resource
+	{
+	public:
+		size_t m_liveBytes = 0;
+		size_t m_peakBytes = 0;
+
+	protected:
+		void* do_allocate(size_t bytes, size_t alignment) override
+		{
+			m_liveBytes += bytes;
+			m_peakBytes = (std::max)(m_peakBytes, m_liveBytes);
+			return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+		}
+
+		void do_deallocate(void* ptr, size_t bytes, size_t alignment) override
+		{
+			m_liveBytes -= bytes;
+			std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+		{
+			return this == &other;
+		}
+	};
+
+	static void Sample(PmrStats& stats, size_t beforeTest)
+	{
+		const size_t used = GetTotalUsedVirtualMemory();
+		stats.m_footprint = (std::max)(stats.m_footprint, used > beforeTest ? used - beforeTest : (size_t)0);
+	}
+};
+
+// The std::pmr containers on ContestMemoryResource<TAllocator> against the standard resources, see PmrWorkloads.
+// The time, ops/sec and the overhead above the requested bytes go to Result::m_results["pmr"],
+// the time is also printed relative to every standard resource.
+template<typename TAllocator>
+class TestCase_Pmr
+{
+public:
+	static void RunTests(Result& result, uint32_t seed)
+	{
+		printf("%s memory_resource:\n", result.m_allocator.c_str());
+		RunTest(result, "map", PmrWorkloads::RunMap, seed);
+		RunTest(result, "list", PmrWorkloads::RunList, seed);
+		RunTest(result, "string", PmrWorkloads::RunString, seed);
+		CheckAlignment(result, seed);
+		printf("\n");
+	}
+
+	// Every pointer of the resource must honour the requested alignment, whatever the allocator returns; the blocks are
+	// filled to their last byte, so a resource writing outside its blocks corrupts the heap of the allocator here
+	static void CheckAlignment(Result& result, uint32_t seed)
+	{
+		static const size_t Alignments[] = { 1, 2, 4, 8, 16, 32, 64, 4096 };
+		static const size_t BlocksCount = 1000;
+
+		std::mt19937 random(seed);
+		std::uniform_int_distribution<size_t> sizes(1, 512);
+
+		size_t misaligned = 0;
+		{
+			ContestMemoryResource<TAllocator> resource;
+			for (size_t alignment : Alignments)
+			{
+				std::vector<std::pair<void*, size_t>> blocks(BlocksCount);
+				for (auto& block : blocks)
+				{
+					block.second = sizes(random);
+					block.first = resource.allocate(block.second, alignment);
+					misaligned += (uintptr_t)block.first % alignment != 0 ? 1 : 0;
+					memset(block.first, 0xA5, block.second);
+				}
+
+				std::shuffle(blocks.begin(), blocks.end(), random);
+				for (auto& block : blocks)
+				{
+					resource.deallocate(block.first, block.second, alignment);
+				}
+			}
+		}
+
+		printf("    alignment 1-4096: %zu of %zu pointers misaligned\n", misaligned, BlocksCount * (sizeof(Alignments) / sizeof(Alignments[0])));
+		if (misaligned)
+		{
+			result.m_errors.push_back("pmr: " + std::to_string(misaligned) + " pointers of ContestMemoryResource are misaligned");
+		}
+	}
+
+	static void RunTest(Result& result, const char* name, PmrWorkloads::Workload workload, uint32_t seed)
+	{
+		const PmrWorkloads::Baseline& baseline = PmrWorkloads::GetBaseline(name, workload, seed);
+
+		PmrStats stats;
+		const size_t beforeTest = GetTotalUsedVirtualMemory();
+		{
+			ContestMemoryResource<TAllocator> resource;
+			PmrWorkloads::Run(&resource, workload, seed, stats, beforeTest);
+		}
+
+		const size_t overhead = stats.m_footprint > baseline.m_requestedBytes ? stats.m_footprint - baseline.m_requestedBytes : 0;
+		const float memoryOverheadMb = (float)((double)overhead / 1048576.0);
+		result.m_results["pmr"][name][baseline.m_requestedBytes] = { stats.m_timer.ResultAccumulatedMs(), memoryOverheadMb };
+		result.m_statistics["pmr"][name][baseline.m_requestedBytes] = SampleStatistics::Compute(stats.m_roundMs);
+
+		const double ms = stats.m_timer.ResultAccumulatedSec() * 1000.0;
+		printf("    %-8s %.2fms, %.2f Mops/s, memory overhead %.2fmb; time to new_delete %.2fx, unsynchronized_pool %.2fx, monotonic_buffer %.2fx\n",
+			name, ms, ms > 0.0 ? (double)stats.m_operations / ms * 0.001 : 0.0, memoryOverheadMb,
+			GetRatio(ms, baseline.m_newDeleteMs), GetRatio(ms, baseline.m_poolMs), GetRatio(ms, baseline.m_monotonicMs));
+	}
+
+private:
+	static double GetRatio(double ms, double baselineMs)
+	{
+		return baselineMs > 0.0 ? ms / baselineMs : 0.0;
+	}
+};
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "AllocatorTraits.h"
+#include "Harness.h"
+
+// Growable buffers like std::vector or a string builder: every buffer starts at InitialSize and grows up to MaxSize
+// with ReallocateBlock, the new tail is written after every step. geometric doubles the size, additive adds Step bytes.
+// The buffers grow round-robin: with one buffer the block being grown is always the last one allocated,
+// so an allocator that grows blocks in place shows it, with several of them the growth interleaves.
+// Allocators without Reallocate pay Allocate + memcpy + Free on every step. The content is checked after every round.
+template<typename TAllocator>
+class TestCase_Reallocate
+{
+public:
+	enum EGrowth
+	{
+		Geometric,
+		Additive
+	};
+
+	struct ReallocateStats
+	{
+		Timer m_timer;
+		size_t m_reallocations = 0;
+		size_t m_inPlace = 0;
+		size_t m_failed = 0;
+		size_t m_memoryOverhead = 0;
+		bool m_bCorrupted = false;
+		// time of every round, exported as the repetitions of the result
+		std::vector<double> m_roundMs;
+	};
+
+	static void RunTests(Result& result)
+	{
+		printf("%s reallocate (%s):\n", result.m_allocator.c_str(), HasReallocate<TAllocator>::value ? "native" : "Allocate + copy + Free");
+		RunTest(result, "geometric", Geometric, 16, 256 * 1024, 1, 2000);
+		RunTest(result, "geometric_x16", Geometric, 16, 256 * 1024, 16, 125);
+		RunTest(result, "additive", Additive, 256, 64 * 1024, 1, 200);
+		RunTest(result, "additive_x16", Additive, 256, 64 * 1024, 16, 12);
+		CheckNeighbours(result);
+		printf("\n");
+	}
+
+	// The middle one of three blocks allocated in a row is reallocated and its new bytes written, then the blocks around it
+	// and the copied bytes are checked: an allocator copying past the old block or placing the new one over a neighbour fails it
+	static void CheckNeighbours(Result& result)
+	{
+		static const size_t Sizes[][2] = { { 16, 1000 }, { 1000, 16 }, { 100, 5000 }, { 4096, 65536 } };
+
+		size_t corrupted = 0;
+		for (const auto& size : Sizes)
+		{
+			const size_t oldSize = size[0];
+			const size_t newSize = size[1];
+
+			TAllocator allocator;
+			uint8_t* blocks[3];
+			for (size_t b = 0; b < 3; b++)
+			{
+				blocks[b] = (uint8_t*)allocator.Allocate(oldSize, 8);
+				for (size_t i = 0; blocks[b] && i < oldSize; i++)
+				{
+					blocks[b][i] = GetContent(b, i);
+				}
+			}
+
+			uint8_t* ptr = blocks[0] && blocks[1] && blocks[2] ? (uint8_t*)ReallocateBlock(allocator, blocks[1], oldSize, newSize) : nullptr;
+			if (!ptr)
+			{
+				continue;
+			}
+
+			for (size_t i = oldSize; i < newSize; i++)
+			{
+				ptr[i] = GetContent(1, i);
+			}
+
+			bool bIntact = true;
+			for (size_t i = 0; i < oldSize; i++)
+			{
+				bIntact = bIntact && blocks[0][i] == GetContent(0, i) && blocks[2][i] == GetContent(2, i);
+			}
+			for (size_t i = 0; i < newSize; i++)
+			{
+				bIntact = bIntact && ptr[i] == GetContent(1, i);
+			}
+			corrupted += bIntact ? 0 : 1;
+
+			allocator.Free(blocks[0]);
+			allocator.Free(ptr);
+			allocator.Free(blocks[2]);
+		}
+
+		printf("    neighbours     %s\n", corrupted ? "CONTENT IS CORRUPTED" : "intact");
+		if (corrupted)
+		{
+			result.m_errors.push_back("realloc: " + std::to_string(corrupted) + " reallocations of a block between two others corrupted the content");
+		}
+	}
+
+	// For Additive the initial size is also the step
+	static void RunTest(Result& result, const char* name, EGrowth growth, size_t initialSize, size_t maxSize, size_t buffersCount, size_t roundsCount)
+	{
+		ReallocateStats stats;
+		RunGrowth(growth, initialSize, maxSize, buffersCount, roundsCount, stats);
+
+		const float memoryOverheadMb = (float)((double)stats.m_memoryOverhead / 1048576.0);
+		result.m_results["realloc"][name][maxSize * buffersCount] = { stats.m_timer.ResultAccumulatedMs(), memoryOverheadMb };
+		result.m_statistics["realloc"][name][maxSize * buffersCount] = SampleStatistics::Compute(stats.m_roundMs);
+
+		const double seconds = stats.m_timer.ResultAccumulatedSec();
+		printf("    %-14s %.2fms, %.2f M reallocations/s, in place %.1f%%, memory overhead %.2fmb%s%s\n", name, stats.m_timer.ResultAccumulatedSec() * 1000.0,
+			seconds > 0.0 ? (double)stats.m_reallocations / seconds * 0.000001 : 0.0,
+			stats.m_reallocations ? 100.0 * (double)stats.m_inPlace / (double)stats.m_reallocations : 0.0, memoryOverheadMb,
+			stats.m_failed ? ", FAILED REALLOCATIONS" : "", stats.m_bCorrupted ? ", CONTENT IS CORRUPTED" : "");
+	}
+
+	static void RunGrowth(EGrowth growth, size_t initialSize, size_t maxSize, size_t buffersCount, size_t roundsCount, ReallocateStats& stats)
+	{
+		std::vector<uint8_t*> buffers(buffersCount, nullptr);
+		std::vector<size_t> sizes(buffersCount, 0);
+		std::vector<bool> bGrowing(buffersCount, true);
+
+		const size_t beforeTest = GetTotalUsedVirtualMemory();
+		{
+			TAllocator allocator;
+
+			for (size_t round = 0; round < roundsCount; round++)
+			{
+				std::fill(sizes.begin(), sizes.end(), 0);
+				std::fill(bGrowing.begin(), bGrowing.end(), true);
+				const int64_t before = stats.m_timer.m_counterAcc;
+
+				stats.m_timer.Start();
+				for (size_t growing = buffersCount; growing > 0;)
+				{
+					growing = 0;
+					for (size_t b = 0; b < buffersCount; b++)
+					{
+						if (!bGrowing[b])
+						{
+							continue;
+						}
+
+						const size_t oldSize = sizes[b];
+						size_t newSize = oldSize == 0 ? initialSize : (growth == Geometric ? oldSize * 2 : oldSize + initialSize);
+						newSize = (std::min)(newSize, maxSize);
+
+						uint8_t* ptr = (uint8_t*)ReallocateBlock(allocator, buffers[b], oldSize, newSize);
+						stats.m_reallocations += buffers[b] ? 1 : 0;
+						if (!ptr)
+						{
+							stats.m_failed++;
+							bGrowing[b] = false;
+							continue;
+						}
+
+						stats.m_inPlace += ptr == buffers[b] ? 1 : 0;
+						for (size_t i = oldSize; i < newSize; i++)
+						{
+							ptr[i] = GetContent(b, i);
+						}
+
+						buffers[b] = ptr;
+						sizes[b] = newSize;
+						bGrowing[b] = newSize < maxSize;
+						growing += bGrowing[b] ? 1 : 0;
+					}
+				}
+				stats.m_timer.Stop();
+
+				const size_t used = GetTotalUsedVirtualMemory();
+				const size_t footprint = used > beforeTest ? used - beforeTest : 0;
+				size_t liveBytes = 0;
+				for (size_t b = 0; b < buffersCount; b++)
+				{
+					liveBytes += sizes[b];
+					for (size_t i = 0; i < sizes[b] && !stats.m_bCorrupted; i++)
+					{
+						stats.m_bCorrupted = buffers[b][i] != GetContent(b, i);
+					}
+				}
+				stats.m_memoryOverhead = (std::max)(stats.m_memoryOverhead, footprint > liveBytes ? footprint - liveBytes : 0);
+
+				stats.m_timer.Start();
+				for (size_t b = 0; b < buffersCount; b++)
+				{
+					if (buffers[b])
+					{
+						allocator.Free(buffers[b]);
+						buffers[b] = nullptr;
+					}
+				}
+				stats.m_timer.Stop();
+				stats.m_roundMs.push_back(stats.m_timer.ResultAccumulatedMsSince(before));
+			}
+		}
+	}
+
+private:
+	static uint8_t GetContent(size_t buffer, size_t offset)
+	{
+		return (uint8_t)(offset * 31 + buffer);
+	}
+};
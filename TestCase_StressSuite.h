@@ -0,0 +1,558 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Harness.h"
+#include "LockedAllocator.h"
+#include "TestCase_ThreadScaling.h"
+
+// Ports of the classic allocator stress programs on the contest interface, scaled down to run in seconds:
+//     larson:        server simulation (Larson & Krishnan), every thread replaces random blocks of its array of live blocks,
+//                    then the arrays are handed to a new generation of threads, which frees the blocks of the previous one;
+//     xmalloc:       xmalloc-test (Lever & Boreham), producers allocate batches of blocks and put them to a shared queue,
+//                    consumers take the batches and free them;
+//     cache-scratch: passive false sharing (Hoard), every thread frees a small object allocated for it by the main thread,
+//                    then allocates, writes and frees objects of the same size; the allocator shouldn't give it the freed one
+//                    as it shares the cache line with the objects of the other threads;
+//     cache-thrash:  active false sharing (Hoard), the same without the initial objects, the allocator shouldn't put
+//                    the objects of different threads to the same cache line;
+//     mstress:       mixed lifetimes (mimalloc-bench), mostly small blocks with some large ones, half of them freed at once,
+//                    some retained in a per-thread array and some exchanged through a global array and freed by another thread.
+// They run on 1, 2, 4 ... hardware_concurrency threads against a single instance behind TLock ("shared"),
+// larson also with an instance per array of blocks ("per-thread"), which moves to the next generation with the array.
+// The random numbers come from an xorshift in the timed loops, like the originals call rand there.
+template<typename TAllocator, typename TLock = MutexLock>
+class TestCase_StressSuite
+{
+public:
+	typedef LockedAllocator<TAllocator, TLock> SharedAllocator;
+
+	static void RunTests(Result& result, bool bPerThread = true)
+	{
+		result.m_scaling["larson"] = RunLarsonTests(8, 1000, 1000, 20000, 10, bPerThread);
+		result.m_scaling["xmalloc"] = RunXmallocTests(8, 256, 1024, 100);
+		result.m_scaling["cache"] = RunCacheTests(8, 200, 50000);
+		result.m_scaling["mstress"] = RunMstressTests(500000);
+
+		printf("%s stress suite:\n", result.m_allocator.c_str());
+		PrintStress(result.m_scaling["larson"]);
+		PrintStress(result.m_scaling["xmalloc"]);
+		PrintStress(result.m_scaling["cache"]);
+		PrintStress(result.m_scaling["mstress"]);
+		printf("\n");
+	}
+
+	static ScalingResult RunLarsonTests(const size_t MinSize, const size_t MaxSize, const size_t BlocksPerThread, const size_t StepsPerGeneration,
+		const size_t GenerationsCount, bool bPerThread = true, size_t maxThreads = 0)
+	{
+		ScalingResult result;
+
+		for (int mode = 0; mode < 2; mode++)
+		{
+			const bool bShared = mode == 1;
+			if (!bShared && !bPerThread)
+			{
+				continue;
+			}
+
+			std::vector<ScalingPoint>& points = result[bShared ? "larson/shared" : "larson/per-thread"];
+			for (size_t threads : TestCase_ThreadScaling<TAllocator, TLock>::GetThreadsCounts(maxThreads))
+			{
+				Timer timer;
+				if (bShared)
+				{
+					SharedAllocator allocator;
+					std::vector<SharedAllocator*> allocators(threads, &allocator);
+					RunLarson(allocators, MinSize, MaxSize, BlocksPerThread, StepsPerGeneration, GenerationsCount, timer);
+				}
+				else
+				{
+					std::vector<std::unique_ptr<TAllocator>> instances(threads);
+					std::vector<TAllocator*> allocators(threads);
+					for (size_t t = 0; t < threads; t++)
+					{
+						instances[t].reset(new TAllocator());
+						allocators[t] = instances[t].get();
+					}
+					RunLarson(allocators, MinSize, MaxSize, BlocksPerThread, StepsPerGeneration, GenerationsCount, timer);
+				}
+
+				// a step frees a block and allocates a new one
+				AddPoint(points, threads, timer, 2.0 * (double)StepsPerGeneration * (double)GenerationsCount * (double)threads);
+			}
+			SetEfficiency(points);
+		}
+
+		return result;
+	}
+
+	// Threads counts are producers + consumers, half of each
+	static ScalingResult RunXmallocTests(const size_t MinSize, const size_t MaxSize, const size_t BatchSize, const size_t BatchesPerProducer, size_t maxThreads = 0)
+	{
+		ScalingResult result;
+
+		std::vector<ScalingPoint>& points = result["xmalloc/shared"];
+		for (size_t threads : TestCase_ThreadScaling<TAllocator, TLock>::GetThreadsCounts(maxThreads))
+		{
+			const size_t pairs = (std::max)(threads / 2, (size_t)1);
+
+			Timer timer;
+			RunXmalloc(pairs, MinSize, MaxSize, BatchSize, BatchesPerProducer, timer);
+			AddPoint(points, pairs * 2, timer, 2.0 * (double)BatchSize * (double)BatchesPerProducer * (double)pairs);
+		}
+
+		// 1 and 2 threads are both a single pair
+		points.erase(std::unique(points.begin(), points.end(), [](const ScalingPoint& a, const ScalingPoint& b) { return a.m_threads == b.m_threads; }), points.end());
+		SetEfficiency(points);
+		return result;
+	}
+
+	// Ops are the byte writes to the objects, false sharing shows up there rather than in the allocations
+	static ScalingResult RunCacheTests(const size_t ObjectSize, const size_t Iterations, const size_t Repetitions, size_t maxThreads = 0)
+	{
+		ScalingResult result;
+
+		for (int mode = 0; mode < 2; mode++)
+		{
+			const bool bScratch = mode == 0;
+
+			std::vector<ScalingPoint>& points = result[bScratch ? "cache-scratch/shared" : "cache-thrash/shared"];
+			for (size_t threads : TestCase_ThreadScaling<TAllocator, TLock>::GetThreadsCounts(maxThreads))
+			{
+				Timer timer;
+				RunCache(threads, bScratch, ObjectSize, Iterations, Repetitions, timer);
+				AddPoint(points, threads, timer, (double)Iterations * (double)Repetitions * (double)ObjectSize * (double)threads);
+			}
+			SetEfficiency(points);
+		}
+
+		return result;
+	}
+
+	static ScalingResult RunMstressTests(const size_t StepsPerThread, size_t maxThreads = 0)
+	{
+		ScalingResult result;
+
+		std::vector<ScalingPoint>& points = result["mstress/shared"];
+		for (size_t threads : TestCase_ThreadScaling<TAllocator, TLock>::GetThreadsCounts(maxThreads))
+		{
+			Timer timer;
+			RunMstress(threads, StepsPerThread, timer);
+			// every step allocates a block and frees one on average
+			AddPoint(points, threads, timer, 2.0 * (double)StepsPerThread * (double)threads);
+		}
+		SetEfficiency(points);
+
+		return result;
+	}
+
+	static void PrintStress(ScalingResult& stress)
+	{
+		std::vector<std::string> keys;
+		for (auto& it : stress)
+		{
+			keys.push_back(it.first);
+		}
+		std::sort(keys.begin(), keys.end());
+
+		for (const std::string& key : keys)
+		{
+			printf("    %-22s", key.c_str());
+			for (const ScalingPoint& point : stress[key])
+			{
+				printf(" %3zu: %7.2f Mops/s (%3.0f%%)", point.m_threads, point.m_opsPerSec * 0.000001, point.m_efficiency * 100.0);
+			}
+			printf("\n");
+		}
+	}
+
+private:
+	struct FastRandom
+	{
+		uint64_t m_state;
+
+		explicit FastRandom(uint64_t seed) : m_state(seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+		inline uint32_t Next()
+		{
+			m_state ^= m_state >> 12;
+			m_state ^= m_state << 25;
+			m_state ^= m_state >> 27;
+			return (uint32_t)((m_state * 0x2545F4914F6CDD1Dull) >> 32);
+		}
+
+		inline size_t NextSize(size_t minSize, size_t maxSize)
+		{
+			return minSize + Next() % (maxSize - minSize + 1);
+		}
+	};
+
+	static void AddPoint(std::vector<ScalingPoint>& points, size_t threads, const Timer& timer, double opsCount)
+	{
+		const double seconds = timer.ResultAccumulatedSec();
+
+		ScalingPoint point;
+		point.m_threads = threads;
+		point.m_ms = timer.ResultAccumulatedMs();
+		point.m_opsPerSec = seconds > 0.0 ? opsCount / seconds : 0.0;
+		points.push_back(point);
+	}
+
+	static void SetEfficiency(std::vector<ScalingPoint>& points)
+	{
+		for (ScalingPoint& point : points)
+		{
+			const double ideal = points[0].m_opsPerSec * (double)point.m_threads / (double)points[0].m_threads;
+			point.m_efficiency = ideal > 0.0 ? point.m_opsPerSec / ideal : 0.0;
+		}
+	}
+
+	static inline void Touch(void* ptr, size_t size, uint32_t value)
+	{
+		if (ptr)
+		{
+			((uint8_t*)ptr)[0] = (uint8_t)value;
+			((uint8_t*)ptr)[size - 1] = (uint8_t)value;
+		}
+	}
+
+	// allocators[t] serves the array of blocks t in every generation
+	template<typename TAlloc>
+	static void RunLarson(const std::vector<TAlloc*>& allocators, size_t minSize, size_t maxSize, size_t blocksCount, size_t stepsCount,
+		size_t generationsCount, Timer& timer)
+	{
+		const size_t threadsCount = allocators.size();
+		std::vector<std::vector<void*>> blocks(threadsCount, std::vector<void*>(blocksCount, nullptr));
+
+		for (size_t t = 0; t < threadsCount; t++)
+		{
+			FastRandom random(t);
+			for (void*& ptr : blocks[t])
+			{
+				const size_t size = random.NextSize(minSize, maxSize);
+				ptr = allocators[t]->Allocate(size, 8);
+				Touch(ptr, size, (uint32_t)t);
+			}
+		}
+
+		timer.Start();
+		for (size_t generation = 0; generation < generationsCount; generation++)
+		{
+			std::vector<std::thread> threads;
+			threads.reserve(threadsCount);
+			for (size_t t = 0; t < threadsCount; t++)
+			{
+				threads.emplace_back([&, t, generation]()
+					{
+						TAlloc& allocator = *allocators[t];
+						std::vector<void*>& array = blocks[t];
+						FastRandom random((generation + 1) * 1000003 + t);
+
+						for (size_t step = 0; step < stepsCount; step++)
+						{
+							const uint32_t value = random.Next();
+							void*& ptr = array[value % blocksCount];
+							if (ptr)
+							{
+								allocator.Free(ptr);
+							}
+
+							const size_t size = random.NextSize(minSize, maxSize);
+							ptr = allocator.Allocate(size, 8);
+							Touch(ptr, size, value);
+						}
+					});
+			}
+
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+		}
+		timer.Stop();
+
+		for (size_t t = 0; t < threadsCount; t++)
+		{
+			for (void* ptr : blocks[t])
+			{
+				if (ptr)
+				{
+					allocators[t]->Free(ptr);
+				}
+			}
+		}
+	}
+
+	static void RunXmalloc(size_t pairsCount, size_t minSize, size_t maxSize, size_t batchSize, size_t batchesPerProducer, Timer& timer)
+	{
+		SharedAllocator allocator;
+
+		std::mutex queueMutex;
+		std::vector<std::vector<void*>> queue;
+		std::atomic<size_t> batchesLeft{ batchesPerProducer * pairsCount };
+		std::atomic<size_t> ready{ 0 };
+		std::atomic<bool> bGo{ false };
+
+		std::vector<std::thread> threads;
+		threads.reserve(pairsCount * 2);
+
+		for (size_t p = 0; p < pairsCount; p++)
+		{
+			threads.emplace_back([&, p]()
+				{
+					FastRandom random(p);
+					ready.fetch_add(1);
+					while (!bGo.load(std::memory_order_acquire))
+					{
+						std::this_thread::yield();
+					}
+
+					for (size_t b = 0; b < batchesPerProducer; b++)
+					{
+						std::vector<void*> batch(batchSize);
+						for (void*& ptr : batch)
+						{
+							const size_t size = random.NextSize(minSize, maxSize);
+							ptr = allocator.Allocate(size, 8);
+							Touch(ptr, size, (uint32_t)b);
+						}
+
+						std::lock_guard<std::mutex> lock(queueMutex);
+						queue.push_back(std::move(batch));
+					}
+				});
+
+			threads.emplace_back([&]()
+				{
+					ready.fetch_add(1);
+					while (!bGo.load(std::memory_order_acquire))
+					{
+						std::this_thread::yield();
+					}
+
+					std::vector<void*> batch;
+					while (batchesLeft.load() > 0)
+					{
+						{
+							std::lock_guard<std::mutex> lock(queueMutex);
+							if (!queue.empty())
+							{
+								batch = std::move(queue.back());
+								queue.pop_back();
+								batchesLeft.fetch_sub(1);
+							}
+						}
+
+						if (batch.empty())
+						{
+							std::this_thread::yield();
+							continue;
+						}
+
+						for (void* ptr : batch)
+						{
+							if (ptr)
+							{
+								allocator.Free(ptr);
+							}
+						}
+						batch.clear();
+					}
+				});
+		}
+
+		while (ready.load() < threads.size())
+		{
+			std::this_thread::yield();
+		}
+
+		timer.Start();
+		bGo.store(true, std::memory_order_release);
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		timer.Stop();
+	}
+
+	static void RunCache(size_t threadsCount, bool bScratch, size_t objectSize, size_t iterations, size_t repetitions, Timer& timer)
+	{
+		SharedAllocator allocator;
+
+		// allocated one after another by the main thread, so they are likely to share cache lines
+		std::vector<void*> initial(threadsCount, nullptr);
+		if (bScratch)
+		{
+			for (void*& ptr : initial)
+			{
+				ptr = allocator.Allocate(objectSize, 1);
+			}
+		}
+
+		std::atomic<size_t> ready{ 0 };
+		std::atomic<bool> bGo{ false };
+
+		std::vector<std::thread> threads;
+		threads.reserve(threadsCount);
+
+		for (size_t t = 0; t < threadsCount; t++)
+		{
+			threads.emplace_back([&, t]()
+				{
+					ready.fetch_add(1);
+					while (!bGo.load(std::memory_order_acquire))
+					{
+						std::this_thread::yield();
+					}
+
+					if (initial[t])
+					{
+						allocator.Free(initial[t]);
+					}
+
+					for (size_t i = 0; i < iterations; i++)
+					{
+						volatile uint8_t* object = (volatile uint8_t*)allocator.Allocate(objectSize, 1);
+						if (!object)
+						{
+							continue;
+						}
+
+						for (size_t r = 0; r < repetitions; r++)
+						{
+							for (size_t k = 0; k < objectSize; k++)
+							{
+								object[k] = (uint8_t)(object[k] + 1);
+							}
+						}
+						allocator.Free((void*)object);
+					}
+				});
+		}
+
+		while (ready.load() < threadsCount)
+		{
+			std::this_thread::yield();
+		}
+
+		timer.Start();
+		bGo.store(true, std::memory_order_release);
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		timer.Stop();
+	}
+
+	static void RunMstress(size_t threadsCount, size_t stepsCount, Timer& timer)
+	{
+		static const size_t RETAINED_COUNT = 1000;
+		static const size_t TRANSFER_COUNT = 256;
+
+		SharedAllocator allocator;
+
+		std::vector<std::atomic<void*>> transfer(TRANSFER_COUNT);
+		for (std::atomic<void*>& slot : transfer)
+		{
+			slot.store(nullptr);
+		}
+		std::vector<std::vector<void*>> retained(threadsCount, std::vector<void*>(RETAINED_COUNT, nullptr));
+
+		std::atomic<size_t> ready{ 0 };
+		std::atomic<bool> bGo{ false };
+
+		std::vector<std::thread> threads;
+		threads.reserve(threadsCount);
+
+		for (size_t t = 0; t < threadsCount; t++)
+		{
+			threads.emplace_back([&, t]()
+				{
+					FastRandom random(t + 17);
+					std::vector<void*>& kept = retained[t];
+
+					ready.fetch_add(1);
+					while (!bGo.load(std::memory_order_acquire))
+					{
+						std::this_thread::yield();
+					}
+
+					for (size_t step = 0; step < stepsCount; step++)
+					{
+						const uint32_t value = random.Next();
+
+						// 90% small, 9% medium, 1% large
+						const uint32_t kind = value % 100;
+						const size_t size = kind < 90 ? random.NextSize(8, 128) : (kind < 99 ? random.NextSize(128, 4096) : random.NextSize(4096, 262144));
+						void* ptr = allocator.Allocate(size, 8);
+						Touch(ptr, size, value);
+
+						// half dies at once, 40% lives until a random replacement, 10% goes to another thread
+						const uint32_t lifetime = (value >> 8) % 10;
+						if (lifetime < 5)
+						{
+							if (ptr)
+							{
+								allocator.Free(ptr);
+							}
+						}
+						else if (lifetime < 9)
+						{
+							void*& slot = kept[(value >> 12) % RETAINED_COUNT];
+							if (slot)
+							{
+								allocator.Free(slot);
+							}
+							slot = ptr;
+						}
+						else
+						{
+							void* previous = transfer[(value >> 12) % TRANSFER_COUNT].exchange(ptr);
+							if (previous)
+							{
+								allocator.Free(previous);
+							}
+						}
+					}
+				});
+		}
+
+		while (ready.load() < threadsCount)
+		{
+			std::this_thread::yield();
+		}
+
+		timer.Start();
+		bGo.store(true, std::memory_order_release);
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		timer.Stop();
+
+		for (std::vector<void*>& kept : retained)
+		{
+			for (void* ptr : kept)
+			{
+				if (ptr)
+				{
+					allocator.Free(ptr);
+				}
+			}
+		}
+		for (std::atomic<void*>& slot : transfer)
+		{
+			if (void* ptr = slot.load())
+			{
+				allocator.Free(ptr);
+			}
+		}
+	}
+};
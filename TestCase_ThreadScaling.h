@@ -0,0 +1,310 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include "Harness.h"
+#include "LockedAllocator.h"
+
+// Multithreaded mode of the performance tests.
+// The simple, shuffle and random patterns run on 1, 2, 4 ... hardware_concurrency threads,
+// each thread with its own sizes distribution, either against an allocator instance per thread ("per-thread")
+// or against a single instance shared behind TLock ("shared").
+// Allocators construction and destruction are not timed, shuffles are precomputed.
+template<typename TAllocator, typename TLock = MutexLock>
+class TestCase_ThreadScaling
+{
+public:
+	typedef LockedAllocator<TAllocator, TLock> SharedAllocator;
+
+	enum class EPattern
+	{
+		Simple,
+		Shuffle,
+		Random
+	};
+
+	static void RunTests(Result& result, bool bPerThread = true, bool bShared = true)
+	{
+		result.m_scaling["small"] = RunScalingTests(1, 32, 5, 200000, bPerThread, bShared);
+		result.m_scaling["medium"] = RunScalingTests(128, 40000, 5, 2000, bPerThread, bShared);
+
+		printf("%s threads scaling:\n", result.m_allocator.c_str());
+		PrintScaling("small", result.m_scaling["small"]);
+		PrintScaling("medium", result.m_scaling["medium"]);
+		printf("\n");
+	}
+
+	// 1, 2, 4 ... up to maxThreads (hardware concurrency by default), maxThreads itself is always included
+	static std::vector<size_t> GetThreadsCounts(size_t maxThreads = 0)
+	{
+		if (maxThreads == 0)
+		{
+			maxThreads = (std::max)((size_t)std::thread::hardware_concurrency(), (size_t)1);
+		}
+
+		std::vector<size_t> res;
+		for (size_t threads = 1; threads < maxThreads; threads <<= 1)
+		{
+			res.push_back(threads);
+		}
+		res.push_back(maxThreads);
+
+		return res;
+	}
+
+	static ScalingResult RunScalingTests(const size_t MinSize = 1, const size_t MaxSize = 32, const size_t IterationsCount = 5, const size_t AllocationsPerThread = 200000,
+		bool bPerThread = true, bool bShared = true, size_t maxThreads = 0)
+	{
+		static const EPattern patterns[] = { EPattern::Simple, EPattern::Shuffle, EPattern::Random };
+
+		ScalingResult result;
+
+		const std::vector<size_t> threadsCounts = GetThreadsCounts(maxThreads);
+		const size_t maxThreadsCount = threadsCounts.back();
+
+		std::vector<std::vector<size_t>> sizesToAllocate(maxThreadsCount);
+		for (size_t t = 0; t < maxThreadsCount; t++)
+		{
+			std::default_random_engine rd(128648432u + (uint32_t)t);
+
+			sizesToAllocate[t].resize(AllocationsPerThread);
+			for (size_t i = 0; i < AllocationsPerThread; ++i)
+			{
+				sizesToAllocate[t][i] = rd() % MaxSize + MinSize;
+			}
+		}
+
+		for (EPattern pattern : patterns)
+		{
+			std::vector<std::vector<size_t>> freeOrders(maxThreadsCount);
+			for (size_t t = 0; t < maxThreadsCount; t++)
+			{
+				freeOrders[t] = GetFreeOrder(pattern, AllocationsPerThread, (uint32_t)t);
+			}
+
+			for (int mode = 0; mode < 2; mode++)
+			{
+				const bool bSharedMode = mode == 1;
+				if ((bSharedMode && !bShared) || (!bSharedMode && !bPerThread))
+				{
+					continue;
+				}
+
+				std::vector<ScalingPoint>& points = result[std::string(GetPatternName(pattern)) + (bSharedMode ? "/shared" : "/per-thread")];
+
+				for (size_t threads : threadsCounts)
+				{
+					Timer timer;
+					for (size_t i = 0; i < IterationsCount; i++)
+					{
+						RunThreads(threads, pattern, sizesToAllocate, freeOrders, bSharedMode, timer);
+					}
+
+					// every allocation is freed
+					const double opsCount = 2.0 * (double)AllocationsPerThread * (double)threads * (double)IterationsCount;
+					const double seconds = timer.ResultAccumulatedSec();
+
+					ScalingPoint point;
+					point.m_threads = threads;
+					point.m_ms = timer.ResultAccumulatedMs();
+					point.m_opsPerSec = seconds > 0.0 ? opsCount / seconds : 0.0;
+					points.push_back(point);
+				}
+
+				for (ScalingPoint& point : points)
+				{
+					const double ideal = points[0].m_opsPerSec * (double)point.m_threads;
+					point.m_efficiency = ideal > 0.0 ? point.m_opsPerSec / ideal : 0.0;
+				}
+			}
+		}
+
+		return result;
+	}
+
+	static const char* GetPatternName(EPattern pattern)
+	{
+		switch (pattern)
+		{
+		case EPattern::Simple:
+			return "simple";
+		case EPattern::Shuffle:
+			return "shuffle";
+		default:
+			return "random";
+		}
+	}
+
+	static void PrintScaling(const char* sizeName, ScalingResult& scaling)
+	{
+		static const char* keys[] = { "simple/per-thread", "shuffle/per-thread", "random/per-thread", "simple/shared", "shuffle/shared", "random/shared" };
+
+		for (const char* key : keys)
+		{
+			auto it = scaling.find(key);
+			if (it == scaling.end())
+			{
+				continue;
+			}
+
+			printf("    %-7s %-19s", sizeName, key);
+			for (const ScalingPoint& point : it->second)
+			{
+				printf(" %3zu: %7.2f Mops/s (%3.0f%%)", point.m_threads, point.m_opsPerSec * 0.000001, point.m_efficiency * 100.0);
+			}
+			printf("\n");
+		}
+	}
+
+private:
+
+	// Precomputed order of frees, the same as TestCase_MemoryPerformance produces with shuffles
+	static std::vector<size_t> GetFreeOrder(EPattern pattern, size_t count, uint32_t seed)
+	{
+		std::vector<size_t> order;
+
+		switch (pattern)
+		{
+		case EPattern::Simple:
+			break;
+		case EPattern::Shuffle:
+			order.resize(count);
+			for (size_t i = 0; i < count; i++)
+			{
+				order[i] = i;
+			}
+			break;
+		case EPattern::Random:
+			order.resize(count / 4);
+			for (size_t i = 0; i < order.size(); i++)
+			{
+				order[i] = i;
+			}
+			break;
+		}
+
+		std::mt19937 g(seed);
+		std::shuffle(order.begin(), order.end(), g);
+
+		return order;
+	}
+
+	template<typename TAlloc>
+	static void RunPattern(TAlloc& allocator, EPattern pattern, const std::vector<size_t>& sizesToAllocate, const std::vector<size_t>& freeOrder, std::vector<void*>& ptrs)
+	{
+		const size_t count = sizesToAllocate.size();
+
+		switch (pattern)
+		{
+		case EPattern::Simple:
+			for (size_t i = 0; i < count; ++i)
+			{
+				ptrs[i] = allocator.Allocate(sizesToAllocate[i], 1);
+			}
+			for (size_t i = 0; i < count; ++i)
+			{
+				allocator.Free(ptrs[i]);
+			}
+			break;
+
+		case EPattern::Shuffle:
+			for (size_t i = 0; i < count; ++i)
+			{
+				ptrs[i] = allocator.Allocate(sizesToAllocate[i], 4);
+			}
+			for (size_t i = 0; i < count; ++i)
+			{
+				allocator.Free(ptrs[freeOrder[i]]);
+			}
+			break;
+
+		case EPattern::Random:
+		{
+			const size_t border = count / 4;
+			for (size_t i = 0; i < border * 2; ++i)
+			{
+				ptrs[i] = allocator.Allocate(sizesToAllocate[i], 1);
+			}
+			for (size_t i = 0; i < border; ++i)
+			{
+				allocator.Free(ptrs[freeOrder[i]]);
+			}
+			for (size_t i = border * 2; i < count; ++i)
+			{
+				ptrs[i] = allocator.Allocate(sizesToAllocate[i], 1);
+			}
+			for (size_t i = border; i < count; ++i)
+			{
+				allocator.Free(ptrs[i]);
+			}
+			break;
+		}
+		}
+	}
+
+	static void RunThreads(size_t threadsCount, EPattern pattern, const std::vector<std::vector<size_t>>& sizesToAllocate,
+		const std::vector<std::vector<size_t>>& freeOrders, bool bShared, Timer& timer)
+	{
+		std::unique_ptr<SharedAllocator> sharedAllocator;
+		std::vector<std::unique_ptr<TAllocator>> allocators(threadsCount);
+
+		if (bShared)
+		{
+			sharedAllocator.reset(new SharedAllocator());
+		}
+		else
+		{
+			for (size_t t = 0; t < threadsCount; t++)
+			{
+				allocators[t].reset(new TAllocator());
+			}
+		}
+
+		std::atomic<size_t> ready{ 0 };
+		std::atomic<bool> bGo{ false };
+
+		std::vector<std::thread> threads;
+		threads.reserve(threadsCount);
+
+		for (size_t t = 0; t < threadsCount; t++)
+		{
+			threads.emplace_back([&, t]()
+				{
+					std::vector<void*> ptrs(sizesToAllocate[t].size(), nullptr);
+
+					ready.fetch_add(1);
+					while (!bGo.load(std::memory_order_acquire))
+					{
+						std::this_thread::yield();
+					}
+
+					if (bShared)
+					{
+						RunPattern(*sharedAllocator, pattern, sizesToAllocate[t], freeOrders[t], ptrs);
+					}
+					else
+					{
+						RunPattern(*allocators[t], pattern, sizesToAllocate[t], freeOrders[t], ptrs);
+					}
+				});
+		}
+
+		while (ready.load() < threadsCount)
+		{
+			std::this_thread::yield();
+		}
+
+		timer.Start();
+		bGo.store(true, std::memory_order_release);
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		timer.Stop();
+	}
+};
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Harness.h"
+#include "AllocationTrace.h"
+
+// Replays a recorded allocation trace (see AllocationTrace.h) through Allocate/Free of a single allocator instance.
+// Records of all the threads are replayed in the trace order on the calling thread.
+// Time and memory overhead are measured the same way as in TestCase_MemoryPerformance: the timer covers the allocator
+// lifetime, the overhead is the committed memory above the live bytes, sampled every SAMPLE_STEP records outside the timer.
+// The live blocks are in a table indexed by id up to DENSE_IDS_COUNT, the sparse ids above it go to a hash map.
+// An id reused without Free leaks its block like the traced program did: it stays allocated and counted as live until the end.
+template<typename TAllocator>
+class TestCase_TraceReplay
+{
+public:
+	static const size_t SAMPLE_STEP = 4096;
+	// Ids below that are indexed in a table, 16 bytes per id
+	static const uint64_t DENSE_IDS_COUNT = 1ull << 24;
+
+	struct ReplayStats
+	{
+		Timer m_timer;
+		size_t m_records = 0;
+		size_t m_allocations = 0;
+		size_t m_frees = 0;
+		size_t m_failedAllocations = 0;
+		// Frees of ids that aren't live: the allocation happened before the recording started or was lost
+		size_t m_unmatchedFrees = 0;
+		// Allocations of an id that is still live, the traced program leaked the block
+		size_t m_leakedBlocks = 0;
+		size_t m_threads = 0;
+		size_t m_peakLiveBytes = 0;
+		size_t m_memoryOverhead = 0;
+		float m_factor = 1.0f;
+		bool m_bCorrupted = false;
+	};
+
+	static void RunTests(Result& result, const char* path, size_t iterationsCount = 1)
+	{
+		ReplayStats stats;
+		if (!ReplayFile(path, iterationsCount, stats))
+		{
+			printf("%s\n    Can't open trace %s\n\n", result.m_allocator.c_str(), path);
+			return;
+		}
+
+		const float ms = (float)stats.m_timer.ResultAccumulatedMs();
+		const float memoryOverheadMb = (float)((double)stats.m_memoryOverhead / 1048576.0);
+		const float peakLiveMb = (float)((double)stats.m_peakLiveBytes / 1048576.0);
+		const double seconds = stats.m_timer.ResultAccumulatedSec();
+		const double opsPerSec = seconds > 0.0 ? (double)(stats.m_allocations + stats.m_frees) / seconds : 0.0;
+
+		result.m_results["trace"]["replay"][stats.m_peakLiveBytes] = { stats.m_timer.ResultAccumulatedMs(), memoryOverheadMb };
+
+		const float score = ms > 0.0f ? stats.m_factor * CalculateScore(ms, memoryOverheadMb, 5.0f, peakLiveMb) : 0.0f;
+
+		printf("%s trace %s:\n    Score: %.2f,\n    Memory overhead: %.2fmb (peak live %.2fmb),\n    Time: %.2fsec, %.2f Mops/s\n",
+			result.m_allocator.c_str(), path, score, memoryOverheadMb, peakLiveMb, ms * 0.001f, opsPerSec * 0.000001);
+		printf("    Records: %zu, threads: %zu, failed allocations: %zu, unmatched frees: %zu, leaked blocks: %zu%s\n\n",
+			stats.m_records, stats.m_threads, stats.m_failedAllocations, stats.m_unmatchedFrees, stats.m_leakedBlocks, stats.m_bCorrupted ? ", TRACE IS CORRUPTED" : "");
+	}
+
+	static bool ReplayFile(const char* path, size_t iterationsCount, ReplayStats& stats)
+	{
+		AllocationTraceReader reader;
+		if (!reader.Open(path))
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < iterationsCount; i++)
+		{
+			reader.Rewind();
+			Replay(reader, stats);
+		}
+
+		return true;
+	}
+
+	static void Replay(AllocationTraceReader& reader, ReplayStats& stats)
+	{
+		struct Block
+		{
+			void* m_ptr;
+			size_t m_size;
+		};
+
+		// the table and the map are grown outside of the timer and excluded from the overhead
+		std::vector<Block> blocks((size_t)(std::min)(reader.GetHeader().m_idsCount, DENSE_IDS_COUNT), Block{ nullptr, 0 });
+		size_t blocksCapacity = blocks.capacity();
+		std::unordered_map<uint64_t, Block> sparseBlocks;
+		// blocks of the reused ids, freed at the end with the ones never freed
+		std::vector<void*> leakedBlocks;
+
+		std::set<uint64_t> threads;
+
+		size_t totalShouldAllocate = 0;
+		size_t totalAllocated = 0;
+		size_t liveBytes = 0;
+		size_t records = 0;
+
+		const size_t beforeTest = GetTotalUsedVirtualMemory();
+		const size_t blocksBytesBefore = blocksCapacity * sizeof(Block);
+
+		auto sampleMemory = [&]()
+		{
+			// a node of the map is about the pair and two pointers
+			const size_t blocksBytes = blocksCapacity * sizeof(Block) - blocksBytesBefore + leakedBlocks.capacity() * sizeof(void*) +
+				sparseBlocks.size() * (sizeof(std::pair<const uint64_t, Block>) + 2 * sizeof(void*)) + sparseBlocks.bucket_count() * sizeof(void*);
+			const size_t used = GetTotalUsedVirtualMemory();
+			if (used > beforeTest + liveBytes + blocksBytes)
+			{
+				stats.m_memoryOverhead = (std::max)(stats.m_memoryOverhead, used - beforeTest - liveBytes - blocksBytes);
+			}
+		};
+
+		Timer& timer = stats.m_timer;
+		timer.Start();
+		{
+			TAllocator allocator;
+
+			TraceRecord record;
+			while (reader.Next(record))
+			{
+				switch (record.m_opcode)
+				{
+				case ETraceOpcode::Allocate:
+				{
+					Block* found = nullptr;
+					if (record.m_id < blocks.size())
+					{
+						found = &blocks[(size_t)record.m_id];
+					}
+					else
+					{
+						timer.Stop();
+						if (record.m_id < DENSE_IDS_COUNT)
+						{
+							blocks.resize((size_t)(std::min)((std::max)(record.m_id + 1, (uint64_t)blocks.size() * 2), DENSE_IDS_COUNT), Block{ nullptr, 0 });
+							blocksCapacity = blocks.capacity();
+							found = &blocks[(size_t)record.m_id];
+						}
+						else
+						{
+							found = &sparseBlocks.emplace(record.m_id, Block{ nullptr, 0 }).first->second;
+						}
+						timer.Start();
+					}
+
+					Block& block = *found;
+					if (block.m_ptr)
+					{
+						// the id was reused without Free, the block stays allocated and its bytes live
+						timer.Stop();
+						leakedBlocks.push_back(block.m_ptr);
+						stats.m_leakedBlocks++;
+						timer.Start();
+					}
+
+					const size_t size = (size_t)record.m_size;
+					block.m_ptr = allocator.Allocate(size, (size_t)record.m_alignment);
+					block.m_size = size;
+
+					totalShouldAllocate += size;
+					stats.m_allocations++;
+					if (block.m_ptr)
+					{
+						totalAllocated += size;
+						liveBytes += size;
+						stats.m_peakLiveBytes = (std::max)(stats.m_peakLiveBytes, liveBytes);
+					}
+					else
+					{
+						stats.m_failedAllocations++;
+					}
+					break;
+				}
+				case ETraceOpcode::Free:
+				{
+					Block* found = nullptr;
+					if (record.m_id < blocks.size())
+					{
+						found = &blocks[(size_t)record.m_id];
+					}
+					else if (record.m_id >= DENSE_IDS_COUNT)
+					{
+						timer.Stop();
+						auto it = sparseBlocks.find(record.m_id);
+						found = it != sparseBlocks.end() ? &it->second : nullptr;
+						timer.Start();
+					}
+
+					if (!found || !found->m_ptr)
+					{
+						stats.m_unmatchedFrees++;
+						break;
+					}
+
+					allocator.Free(found->m_ptr);
+					liveBytes -= found->m_size;
+					found->m_ptr = nullptr;
+					stats.m_frees++;
+
+					if (record.m_id >= DENSE_IDS_COUNT)
+					{
+						timer.Stop();
+						sparseBlocks.erase(record.m_id);
+						timer.Start();
+					}
+					break;
+				}
+				case ETraceOpcode::Thread:
+					timer.Stop();
+					threads.insert(record.m_id);
+					timer.Start();
+					break;
+				}
+
+				if (++records % SAMPLE_STEP == 0)
+				{
+					timer.Stop();
+					sampleMemory();
+					reader.ReleaseConsumed();
+					timer.Start();
+				}
+			}
+
+			timer.Stop();
+			sampleMemory();
+
+			// blocks the traced program never freed
+			for (Block& block : blocks)
+			{
+				if (block.m_ptr)
+				{
+					allocator.Free(block.m_ptr);
+				}
+			}
+			for (auto& block : sparseBlocks)
+			{
+				if (block.second.m_ptr)
+				{
+					allocator.Free(block.second.m_ptr);
+				}
+			}
+			for (void* ptr : leakedBlocks)
+			{
+				allocator.Free(ptr);
+			}
+			timer.Start();
+		}
+		timer.Stop();
+
+		stats.m_records += records;
+		stats.m_threads = (std::max)(stats.m_threads, threads.size());
+		stats.m_factor = totalShouldAllocate ? (float)((double)totalAllocated / (double)totalShouldAllocate) : 1.0f;
+		stats.m_bCorrupted = stats.m_bCorrupted || reader.IsCorrupted();
+	}
+};
@@ -0,0 +1,555 @@
+#pragma once
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "SizeDistribution.h"
+
+// What a run of the contest tests: the allocators, the size ranges of TestCase_MemoryPerformance, its patterns
+// and the iterations counts. The defaults are the contest itself, the command line and config files change them
+// without recompiling:
+//
+//     MemoryAllocatorContest --allocators=DefaultMalloc,AntonShatalov --sizes=small --patterns=shuffle --iterations=5
+//     MemoryAllocatorContest --size=pages:4096:4096:200000 --sizes=pages,medium
+//     MemoryAllocatorContest --size=objects:1:4096:1000000 --distribution=objects:lognormal:32:1 --sizes=objects
+//     MemoryAllocatorContest --config=sweep.conf
+//
+// A config file has an option per line without the dashes, "allocators = DefaultMalloc, AntonShatalov", # starts a comment.
+// The options are applied in order, so the command line after --config overrides the file. Only --sizes selects the ranges
+// after all the other options, so a range can be defined after it.
+
+enum EPattern
+{
+	PatternSimple,
+	PatternShuffle,
+	PatternRandom,
+	PatternsCount
+};
+
+inline const char* GetPatternName(int pattern)
+{
+	static const char* names[PatternsCount] = { "simple", "shuffle", "random" };
+	return names[pattern];
+}
+
+// Which block of the live set TestCase_Churn frees
+enum EChurnLifetime
+{
+	ChurnFifo,
+	ChurnLifo,
+	ChurnRandom,
+	ChurnExponential,
+	ChurnLifetimesCount
+};
+
+inline const char* GetChurnLifetimeName(int lifetime)
+{
+	static const char* names[ChurnLifetimesCount] = { "fifo", "lifo", "random", "exponential" };
+	return names[lifetime];
+}
+
+// The sizes of a range are MinSize + rand() % MaxSize as RunPerformanceTests draws them, or any other distribution
+// within [MinSize, MaxSize], see SizeDistribution.h. The allocations count is the largest of its 5 steps
+struct SizeRange
+{
+	std::string m_name;
+	size_t m_minSize = 1;
+	size_t m_maxSize = 32;
+	size_t m_allocations = 1000000;
+	size_t m_iterations = 10;
+	SizeDistribution m_distribution;
+
+	std::string GetTitle() const
+	{
+		std::string title = m_name;
+		title[0] = (char)toupper((unsigned char)title[0]);
+		title += " allocations [" + std::to_string(m_minSize) + "," + std::to_string(m_maxSize) + "] bytes";
+		return m_distribution.GetType() == SizeUniform ? title : title + ", " + m_distribution.GetDescription();
+	}
+};
+
+struct TestMatrix
+{
+	// Names from the allocators registry of main(), empty runs all of them
+	std::vector<std::string> m_allocators;
+	std::vector<SizeRange> m_sizes;
+	// Ranges selected by --sizes in their order, empty keeps all of m_sizes; applied by ParseTestMatrix after all the options
+	std::vector<std::string> m_sizeNames;
+	// Bit per EPattern
+	unsigned m_patterns = (1u << PatternsCount) - 1;
+	// Overrides the iterations count of every size range if not 0
+	size_t m_iterations = 0;
+	// Bit per EChurnLifetime, TestCase_Churn runs if any
+	unsigned m_churnLifetimes = 0;
+	// Churn steps per block of the live set
+	size_t m_churnSteps = 10;
+	bool m_bListAllocators = false;
+	bool m_bHelp = false;
+
+	static TestMatrix GetDefault()
+	{
+		TestMatrix matrix;
+		matrix.m_sizes.push_back({ "small", 1, 32, 1000000, 20, SizeDistribution() });
+		matrix.m_sizes.push_back({ "medium", 128, 40000, 50000, 10, SizeDistribution() });
+		matrix.m_sizes.push_back({ "large", 4000000, 80000000, 800, 200, SizeDistribution() });
+		matrix.m_sizes.push_back({ "random", 1, 16000000000, 25, 900, SizeDistribution() });
+		return matrix;
+	}
+
+	bool HasPattern(int pattern) const
+	{
+		return (m_patterns & (1u << pattern)) != 0;
+	}
+
+	bool HasChurnLifetime(int lifetime) const
+	{
+		return (m_churnLifetimes & (1u << lifetime)) != 0;
+	}
+
+	bool HasAllocator(const std::string& name) const
+	{
+		if (m_allocators.empty())
+		{
+			return true;
+		}
+
+		for (const std::string& allocator : m_allocators)
+		{
+			if (EqualsNoCase(allocator, name))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	size_t GetIterations(const SizeRange& size) const
+	{
+		return m_iterations ? m_iterations : size.m_iterations;
+	}
+
+	static bool EqualsNoCase(const std::string& a, const std::string& b)
+	{
+		if (a.size() != b.size())
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i]))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+inline const char* GetTestMatrixUsage()
+{
+	return
+		"Options:\n"
+		"  --allocators=NAME,...          allocators to test, all by default\n"
+		"  --list                         print the allocators and the size ranges and exit\n"
+		"  --size=NAME:MIN:MAX:COUNT[:N]  define a size range of COUNT allocations of MIN + rand() % MAX bytes,\n"
+		"                                 N iterations; replaces the range of the same name\n"
+		"  --distribution=NAME:TYPE       sizes of the range NAME: uniform (MIN + rand() % MAX), lognormal:MEDIAN:SIGMA,\n"
+		"                                 zipf:EXPONENT over the size classes, histogram:PATH of a histogram file or a trace\n"
+		"  --sizes=NAME,...               size ranges to run and their order, small,medium,large,random by default;\n"
+		"                                 selected after all the other options, so --size may come later\n"
+		"  --patterns=NAME,...            simple, shuffle, random; all by default\n"
+		"  --iterations=N                 iterations count of every size range\n"
+		"  --churn=LIFETIME,...           run the steady-state churn of every size range: fifo, lifo, random, exponential or all\n"
+		"  --churn-steps=N                churn steps per live block, 10 by default\n"
+		"  --config=PATH                  read the options from a file, one \"option = value\" per line\n"
+		"  --help                         print this help and exit\n";
+}
+
+inline std::string TrimMatrixValue(const std::string& value)
+{
+	const size_t start = value.find_first_not_of(" \t\r");
+	if (start == std::string::npos)
+	{
+		return std::string();
+	}
+	return value.substr(start, value.find_last_not_of(" \t\r") - start + 1);
+}
+
+inline std::vector<std::string> SplitMatrixValue(const std::string& value, char separator)
+{
+	std::vector<std::string> items;
+	size_t start = 0;
+	while (start <= value.size())
+	{
+		size_t end = value.find(separator, start);
+		end = end == std::string::npos ? value.size() : end;
+		items.push_back(TrimMatrixValue(value.substr(start, end - start)));
+		start = end + 1;
+	}
+	return items;
+}
+
+inline bool ParseMatrixCount(const std::string& value, size_t& count)
+{
+	if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos)
+	{
+		return false;
+	}
+	count = (size_t)strtoull(value.c_str(), nullptr, 10);
+	return true;
+}
+
+// The names become identifiers in results.html and fields of the exported results
+inline bool IsMatrixName(const std::string& name)
+{
+	if (name.empty() || !isalpha((unsigned char)name[0]))
+	{
+		return false;
+	}
+
+	for (char c : name)
+	{
+		if (!isalnum((unsigned char)c) && c != '_')
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+inline bool ReadTestMatrixConfig(const std::string& path, TestMatrix& matrix, std::string& error, int depth = 0);
+
+// Applies a single option, false with the error set if it's invalid
+inline bool ApplyTestMatrixOption(const std::string& key, const std::string& value, TestMatrix& matrix, std::string& error, int depth = 0)
+{
+	if (key == "allocators")
+	{
+		matrix.m_allocators.clear();
+		for (const std::string& name : SplitMatrixValue(value, ','))
+		{
+			if (name.empty())
+			{
+				error = "Empty allocator name in \"" + value + "\"";
+				return false;
+			}
+			matrix.m_allocators.push_back(name);
+		}
+		return true;
+	}
+
+	if (key == "size")
+	{
+		const std::vector<std::string> fields = SplitMatrixValue(value, ':');
+		SizeRange size;
+		size.m_name = fields[0];
+
+		bool bValid = (fields.size() == 4 || fields.size() == 5) && IsMatrixName(size.m_name) &&
+			ParseMatrixCount(fields[1], size.m_minSize) && ParseMatrixCount(fields[2], size.m_maxSize) &&
+			ParseMatrixCount(fields[3], size.m_allocations) && (fields.size() == 4 || ParseMatrixCount(fields[4], size.m_iterations));
+
+		// every step of the test allocates a fifth of the count more
+		bValid = bValid && size.m_minSize > 0 && size.m_maxSize > 0 && size.m_allocations >= 5 && size.m_iterations > 0;
+		if (!bValid)
+		{
+			error = "Invalid size range \"" + value + "\", expected NAME:MIN:MAX:COUNT[:ITERATIONS] with COUNT at least 5";
+			return false;
+		}
+
+		for (SizeRange& it : matrix.m_sizes)
+		{
+			if (it.m_name == size.m_name)
+			{
+				it = size;
+				return true;
+			}
+		}
+		matrix.m_sizes.push_back(size);
+		return true;
+	}
+
+	if (key == "distribution")
+	{
+		const size_t colon = value.find(':');
+		const std::string name = value.substr(0, colon);
+
+		SizeRange* size = nullptr;
+		for (SizeRange& it : matrix.m_sizes)
+		{
+			size = it.m_name == name ? &it : size;
+		}
+
+		if (!size || colon == std::string::npos)
+		{
+			error = "Invalid distribution \"" + value + "\", expected NAME:TYPE[:PARAMETERS] of a defined size range";
+			return false;
+		}
+
+		// the path of a histogram may have colons
+		const std::string type = value.substr(colon + 1, value.find(':', colon + 1) - colon - 1);
+		const std::string parameters = type.size() + colon + 1 < value.size() ? value.substr(colon + type.size() + 2) : std::string();
+		const std::vector<std::string> fields = SplitMatrixValue(parameters, ':');
+
+		if (type == "uniform" && parameters.empty())
+		{
+			size->m_distribution = SizeDistribution();
+			return true;
+		}
+
+		if (type == "lognormal" && fields.size() == 2 && atof(fields[0].c_str()) >= 1.0 && atof(fields[1].c_str()) > 0.0)
+		{
+			size->m_distribution = SizeDistribution::LogNormal(atof(fields[0].c_str()), atof(fields[1].c_str()));
+			return true;
+		}
+
+		if (type == "zipf" && fields.size() == 1 && atof(fields[0].c_str()) > 0.0)
+		{
+			size->m_distribution = SizeDistribution::Zipf(atof(fields[0].c_str()));
+			return true;
+		}
+
+		if (type == "histogram" && !parameters.empty())
+		{
+			SizeDistribution distribution;
+			if (!SizeDistribution::LoadHistogram(parameters, distribution, error))
+			{
+				return false;
+			}
+
+			distribution.Prepare(size->m_minSize, size->m_maxSize);
+			if (distribution.IsEmpty())
+			{
+				error = "No sizes of the histogram " + parameters + " are within the range " + name;
+				return false;
+			}
+
+			size->m_distribution = distribution;
+			return true;
+		}
+
+		error = "Invalid distribution \"" + value + "\", expected uniform, lognormal:MEDIAN:SIGMA, zipf:EXPONENT or histogram:PATH";
+		return false;
+	}
+
+	if (key == "sizes")
+	{
+		matrix.m_sizeNames.clear();
+		for (const std::string& name : SplitMatrixValue(value, ','))
+		{
+			if (name.empty())
+			{
+				error = "Empty size range name in \"" + value + "\"";
+				return false;
+			}
+			matrix.m_sizeNames.push_back(name);
+		}
+		return true;
+	}
+
+	if (key == "patterns")
+	{
+		matrix.m_patterns = 0;
+		for (const std::string& name : SplitMatrixValue(value, ','))
+		{
+			int pattern = 0;
+			while (pattern < PatternsCount && name != GetPatternName(pattern))
+			{
+				pattern++;
+			}
+
+			if (pattern == PatternsCount)
+			{
+				error = "Unknown pattern \"" + name + "\"";
+				return false;
+			}
+			matrix.m_patterns |= 1u << pattern;
+		}
+		return true;
+	}
+
+	if (key == "churn")
+	{
+		matrix.m_churnLifetimes = 0;
+		for (const std::string& name : SplitMatrixValue(value, ','))
+		{
+			int lifetime = 0;
+			while (lifetime < ChurnLifetimesCount && name != GetChurnLifetimeName(lifetime))
+			{
+				lifetime++;
+			}
+
+			if (name == "all")
+			{
+				matrix.m_churnLifetimes = (1u << ChurnLifetimesCount) - 1;
+			}
+			else if (lifetime == ChurnLifetimesCount)
+			{
+				error = "Unknown churn lifetime \"" + name + "\"";
+				return false;
+			}
+			else
+			{
+				matrix.m_churnLifetimes |= 1u << lifetime;
+			}
+		}
+		return true;
+	}
+
+	if (key == "churn-steps")
+	{
+		if (!ParseMatrixCount(value, matrix.m_churnSteps) || matrix.m_churnSteps == 0)
+		{
+			error = "Invalid churn steps \"" + value + "\"";
+			return false;
+		}
+		return true;
+	}
+
+	if (key == "iterations")
+	{
+		if (!ParseMatrixCount(value, matrix.m_iterations) || matrix.m_iterations == 0)
+		{
+			error = "Invalid iterations count \"" + value + "\"";
+			return false;
+		}
+		return true;
+	}
+
+	if (key == "config")
+	{
+		return ReadTestMatrixConfig(value, matrix, error, depth + 1);
+	}
+
+	if (key == "list")
+	{
+		matrix.m_bListAllocators = true;
+		return true;
+	}
+
+	if (key == "help")
+	{
+		matrix.m_bHelp = true;
+		return true;
+	}
+
+	error = "Unknown option \"" + key + "\"";
+	return false;
+}
+
+inline bool ReadTestMatrixConfig(const std::string& path, TestMatrix& matrix, std::string& error, int depth)
+{
+	// a config including itself
+	if (depth > 8)
+	{
+		error = "Config files nested too deep at " + path;
+		return false;
+	}
+
+	std::ifstream file(path);
+	if (!file)
+	{
+		error = "Can't read the config file " + path;
+		return false;
+	}
+
+	std::string line;
+	size_t lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		line = TrimMatrixValue(line.substr(0, line.find('#')));
+		if (line.empty())
+		{
+			continue;
+		}
+
+		const size_t equals = line.find('=');
+		const std::string key = TrimMatrixValue(line.substr(0, equals));
+		const std::string value = equals == std::string::npos ? std::string() : TrimMatrixValue(line.substr(equals + 1));
+
+		if (!ApplyTestMatrixOption(key, value, matrix, error, depth))
+		{
+			error = path + ":" + std::to_string(lineNumber) + ": " + error;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Keeps the size ranges of m_sizeNames in their order, false with the error set on an undefined one
+inline bool SelectTestMatrixSizes(TestMatrix& matrix, std::string& error)
+{
+	if (matrix.m_sizeNames.empty())
+	{
+		return true;
+	}
+
+	std::vector<SizeRange> sizes;
+	for (const std::string& name : matrix.m_sizeNames)
+	{
+		const SizeRange* found = nullptr;
+		for (const SizeRange& it : matrix.m_sizes)
+		{
+			found = it.m_name == name ? &it : found;
+		}
+
+		if (!found)
+		{
+			error = "Unknown size range \"" + name + "\", define it with --size";
+			return false;
+		}
+		sizes.push_back(*found);
+	}
+
+	matrix.m_sizes = sizes;
+	matrix.m_sizeNames.clear();
+	return true;
+}
+
+// Options are "--key=value" or "--key value", false with the error set on an invalid one
+inline bool ParseTestMatrix(int argc, char** argv, TestMatrix& matrix, std::string& error)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		if (arg.compare(0, 2, "--") != 0)
+		{
+			error = "Unexpected argument \"" + arg + "\"";
+			return false;
+		}
+
+		const size_t equals = arg.find('=');
+		const std::string key = arg.substr(2, equals == std::string::npos ? std::string::npos : equals - 2);
+
+		std::string value;
+		if (equals != std::string::npos)
+		{
+			value = arg.substr(equals + 1);
+		}
+		else if (key != "list" && key != "help" && i + 1 < argc)
+		{
+			value = argv[++i];
+		}
+
+		if (!ApplyTestMatrixOption(key, value, matrix, error))
+		{
+			return false;
+		}
+	}
+
+	if (!SelectTestMatrixSizes(matrix, error))
+	{
+		return false;
+	}
+
+	if (matrix.m_sizes.empty() || matrix.m_patterns == 0)
+	{
+		error = "Nothing to run, no size ranges or patterns selected";
+		return false;
+	}
+
+	return true;
+}
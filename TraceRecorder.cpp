@@ -0,0 +1,637 @@
+// LD_PRELOAD library recording allocation traces of a live process in the AllocationTrace.h format.
+//
+//     g++ -std=c++17 -O2 -fPIC -shared -pthread TraceRecorder.cpp -o libtracerecorder.so -ldl
+//     ALLOC_TRACE_FILE=app.trace LD_PRELOAD=./libtracerecorder.so ./app
+//
+// Every block gets a 16 bytes header in front of it with the trace id, so free doesn't need any lookups.
+// Ids are reused after free through per-thread caches. Every call takes a number from the global sequence
+// and is pushed into a per-thread single producer ring, a background thread merges the rings in the sequence order
+// and writes the trace, so the replay sees the same order of Allocate/Free as the process did.
+// malloc family allocations are recorded with 16 bytes alignment, realloc as Allocate of the new block + Free of the old one.
+// Linux and glibc only: the real allocator is reached through __libc_malloc and friends.
+
+#ifdef _WIN32
+#error "TraceRecorder is a Linux LD_PRELOAD library"
+#endif
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "AllocationTrace.h"
+
+extern "C"
+{
+	void* __libc_malloc(size_t size);
+	void __libc_free(void* ptr);
+	void* __libc_calloc(size_t count, size_t size);
+	void* __libc_realloc(void* ptr, size_t size);
+	void* __libc_memalign(size_t alignment, size_t size);
+}
+
+namespace
+{
+	const size_t HEADER_SIZE = 16;
+	const size_t DEFAULT_ALIGNMENT = 16;
+	const uint64_t NO_ID = ~0ull;
+
+	const size_t RING_SIZE = 16384;
+	const size_t ID_CACHE_SIZE = 1024;
+	const size_t ID_BATCH_SIZE = ID_CACHE_SIZE / 2;
+
+	struct BlockHeader
+	{
+		uint64_t m_id;
+		// distance from the block returned by libc to the user pointer
+		uint64_t m_offset;
+	};
+
+	struct RawRecord
+	{
+		uint64_t m_sequence;
+		uint64_t m_id;
+		uint64_t m_size;
+		uint32_t m_alignment;
+		uint32_t m_opcode;
+	};
+
+	// Single producer (the owning thread) / single consumer (the flush thread) queue, lives in its own mapping
+	struct TraceRing
+	{
+		enum EState : int
+		{
+			Active,
+			// the thread exited, the flush thread frees the ring once it's drained
+			Orphan,
+			Free
+		};
+
+		alignas(64) std::atomic<uint64_t> m_head;
+		alignas(64) std::atomic<uint64_t> m_tail;
+		std::atomic<int> m_state;
+		uint64_t m_threadId;
+		TraceRing* m_next;
+		RawRecord m_records[RING_SIZE];
+	};
+
+	// Batch of ids moved between the per-thread caches
+	struct IdBatch
+	{
+		IdBatch* m_next;
+		uint64_t m_ids[ID_BATCH_SIZE];
+	};
+
+	struct ThreadState
+	{
+		TraceRing* m_ring;
+		// set while the thread is inside the recorder and for the flush thread itself, nothing is recorded then
+		bool m_bInside;
+		size_t m_idsCount;
+		uint64_t m_ids[ID_CACHE_SIZE];
+	};
+
+	// initial-exec TLS never calls malloc on access
+	__thread ThreadState t_state __attribute__((tls_model("initial-exec")));
+
+	std::atomic<bool> g_bEnabled{ false };
+	std::atomic<uint64_t> g_sequence{ 0 };
+	std::atomic<uint64_t> g_nextId{ 0 };
+	std::atomic<uint64_t> g_threadsCount{ 0 };
+	std::atomic<TraceRing*> g_rings{ nullptr };
+
+	std::atomic_flag g_idBatchesLock = ATOMIC_FLAG_INIT;
+	IdBatch* g_idBatches = nullptr;
+
+	pthread_key_t g_threadKey;
+	pthread_t g_flushThread;
+	std::atomic<bool> g_bStop{ false };
+	AllocationTraceWriter* g_writer = nullptr;
+
+	typedef size_t (*MallocUsableSizeFunc)(void*);
+	MallocUsableSizeFunc g_realMallocUsableSize = nullptr;
+
+	struct InsideGuard
+	{
+		InsideGuard()
+		{
+			t_state.m_bInside = true;
+		}
+
+		~InsideGuard()
+		{
+			t_state.m_bInside = false;
+		}
+	};
+
+	inline BlockHeader* GetHeader(void* ptr)
+	{
+		return (BlockHeader*)((uint8_t*)ptr - HEADER_SIZE);
+	}
+
+	inline void* GetRawBlock(void* ptr)
+	{
+		return (uint8_t*)ptr - GetHeader(ptr)->m_offset;
+	}
+
+	TraceRing* AcquireRing()
+	{
+		TraceRing* ring = nullptr;
+		for (TraceRing* it = g_rings.load(std::memory_order_acquire); it; it = it->m_next)
+		{
+			int state = TraceRing::Free;
+			if (it->m_state.compare_exchange_strong(state, TraceRing::Active))
+			{
+				ring = it;
+				break;
+			}
+		}
+
+		if (!ring)
+		{
+			void* memory = mmap(nullptr, sizeof(TraceRing), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (memory == MAP_FAILED)
+			{
+				return nullptr;
+			}
+
+			ring = new (memory) TraceRing();
+			ring->m_head.store(0);
+			ring->m_tail.store(0);
+			ring->m_state.store(TraceRing::Active);
+
+			TraceRing* head = g_rings.load();
+			do
+			{
+				ring->m_next = head;
+			} while (!g_rings.compare_exchange_weak(head, ring));
+		}
+
+		ring->m_threadId = g_threadsCount.fetch_add(1);
+		pthread_setspecific(g_threadKey, ring);
+		return ring;
+	}
+
+	uint64_t AcquireId()
+	{
+		ThreadState& state = t_state;
+		if (state.m_idsCount == 0)
+		{
+			IdBatch* batch = nullptr;
+			while (g_idBatchesLock.test_and_set(std::memory_order_acquire))
+			{
+			}
+			batch = g_idBatches;
+			if (batch)
+			{
+				g_idBatches = batch->m_next;
+			}
+			g_idBatchesLock.clear(std::memory_order_release);
+
+			if (batch)
+			{
+				memcpy(state.m_ids, batch->m_ids, sizeof(batch->m_ids));
+				state.m_idsCount = ID_BATCH_SIZE;
+				__libc_free(batch);
+			}
+			else
+			{
+				// fresh ids are taken in batches too, ids stay dense
+				const uint64_t first = g_nextId.fetch_add(ID_BATCH_SIZE);
+				for (size_t i = 0; i < ID_BATCH_SIZE; i++)
+				{
+					state.m_ids[i] = first + ID_BATCH_SIZE - 1 - i;
+				}
+				state.m_idsCount = ID_BATCH_SIZE;
+			}
+		}
+
+		return state.m_ids[--state.m_idsCount];
+	}
+
+	// Moves ID_BATCH_SIZE ids from the end of the thread cache to the shared pool
+	bool ShareIds()
+	{
+		ThreadState& state = t_state;
+
+		IdBatch* batch = (IdBatch*)__libc_malloc(sizeof(IdBatch));
+		if (!batch)
+		{
+			return false;
+		}
+
+		state.m_idsCount -= ID_BATCH_SIZE;
+		memcpy(batch->m_ids, state.m_ids + state.m_idsCount, sizeof(batch->m_ids));
+
+		while (g_idBatchesLock.test_and_set(std::memory_order_acquire))
+		{
+		}
+		batch->m_next = g_idBatches;
+		g_idBatches = batch;
+		g_idBatchesLock.clear(std::memory_order_release);
+
+		return true;
+	}
+
+	void ReleaseId(uint64_t id)
+	{
+		ThreadState& state = t_state;
+
+		// the thread frees more than it allocates, share the surplus with the others,
+		// if that fails the id is just lost, the trace stays correct
+		if (state.m_idsCount == ID_CACHE_SIZE && !ShareIds())
+		{
+			return;
+		}
+
+		state.m_ids[state.m_idsCount++] = id;
+	}
+
+	void OnThreadExit(void* ring)
+	{
+		ThreadState& state = t_state;
+		InsideGuard guard;
+
+		while (state.m_idsCount >= ID_BATCH_SIZE && ShareIds())
+		{
+		}
+
+		// allocations made later by the other TLS destructors take a new ring
+		state.m_ring = nullptr;
+		((TraceRing*)ring)->m_state.store(TraceRing::Orphan, std::memory_order_release);
+	}
+
+	size_t GetRealUsableSize(void* raw)
+	{
+		if (!g_realMallocUsableSize)
+		{
+			g_realMallocUsableSize = (MallocUsableSizeFunc)dlsym(RTLD_NEXT, "malloc_usable_size");
+		}
+		return g_realMallocUsableSize(raw);
+	}
+
+	// The slot is reserved before the sequence number is taken, so the flush thread never waits
+	// for a number that is stuck behind a full ring
+	void Emit(ETraceOpcode opcode, uint64_t id, uint64_t size, uint64_t alignment)
+	{
+		ThreadState& state = t_state;
+		if (!state.m_ring)
+		{
+			state.m_ring = AcquireRing();
+			if (!state.m_ring)
+			{
+				return;
+			}
+		}
+
+		TraceRing* ring = state.m_ring;
+		const uint64_t tail = ring->m_tail.load(std::memory_order_relaxed);
+		while (tail - ring->m_head.load(std::memory_order_acquire) >= RING_SIZE)
+		{
+			sched_yield();
+		}
+
+		RawRecord& record = ring->m_records[tail % RING_SIZE];
+		record.m_sequence = g_sequence.fetch_add(1, std::memory_order_relaxed);
+		record.m_id = id;
+		record.m_size = size;
+		record.m_alignment = (uint32_t)alignment;
+		record.m_opcode = (uint32_t)opcode;
+		ring->m_tail.store(tail + 1, std::memory_order_release);
+	}
+
+	inline void* RecordAllocation(void* raw, size_t offset, size_t size, size_t alignment)
+	{
+		if (!raw)
+		{
+			return nullptr;
+		}
+
+		void* ptr = (uint8_t*)raw + offset;
+		BlockHeader* header = GetHeader(ptr);
+		header->m_offset = offset;
+		header->m_id = NO_ID;
+
+		if (g_bEnabled.load(std::memory_order_relaxed) && !t_state.m_bInside)
+		{
+			InsideGuard guard;
+			header->m_id = AcquireId();
+			Emit(ETraceOpcode::Allocate, header->m_id, size, alignment);
+		}
+
+		return ptr;
+	}
+
+	inline void RecordFree(void* ptr)
+	{
+		const uint64_t id = GetHeader(ptr)->m_id;
+		if (id != NO_ID && g_bEnabled.load(std::memory_order_relaxed) && !t_state.m_bInside)
+		{
+			InsideGuard guard;
+			Emit(ETraceOpcode::Free, id, 0, 0);
+			ReleaseId(id);
+		}
+	}
+
+	void* AllocateAligned(size_t alignment, size_t size)
+	{
+		if (alignment <= DEFAULT_ALIGNMENT)
+		{
+			if (size > SIZE_MAX - HEADER_SIZE)
+			{
+				return nullptr;
+			}
+			return RecordAllocation(__libc_malloc(size + HEADER_SIZE), HEADER_SIZE, size, DEFAULT_ALIGNMENT);
+		}
+
+		// the header lives in the padding, the user pointer is raw + alignment
+		if (size > SIZE_MAX - alignment)
+		{
+			return nullptr;
+		}
+		return RecordAllocation(__libc_memalign(alignment, size + alignment), alignment, size, alignment);
+	}
+
+	// Appends the records of all rings in the sequence order, stops at the first number that isn't published yet
+	// unless bFinal, then the gaps of the threads still running at exit are skipped
+	void Drain(uint64_t& nextSequence, uint64_t& lastThreadId, bool bFinal)
+	{
+		for (;;)
+		{
+			TraceRing* best = nullptr;
+			uint64_t bestSequence = ~0ull;
+
+			for (TraceRing* ring = g_rings.load(std::memory_order_acquire); ring; ring = ring->m_next)
+			{
+				const uint64_t head = ring->m_head.load(std::memory_order_relaxed);
+				if (head == ring->m_tail.load(std::memory_order_acquire))
+				{
+					continue;
+				}
+
+				const uint64_t sequence = ring->m_records[head % RING_SIZE].m_sequence;
+				if (sequence < bestSequence)
+				{
+					bestSequence = sequence;
+					best = ring;
+				}
+			}
+
+			if (!best || (bestSequence != nextSequence && !bFinal))
+			{
+				break;
+			}
+
+			// a ring is consumed as long as it has the next numbers, that's the common case of one busy thread
+			uint64_t head = best->m_head.load(std::memory_order_relaxed);
+			const uint64_t tail = best->m_tail.load(std::memory_order_acquire);
+			for (; head != tail; head++)
+			{
+				const RawRecord& record = best->m_records[head % RING_SIZE];
+				if (record.m_sequence != nextSequence && !(bFinal && record.m_sequence == bestSequence))
+				{
+					break;
+				}
+
+				if (best->m_threadId != lastThreadId)
+				{
+					g_writer->Thread(best->m_threadId);
+					lastThreadId = best->m_threadId;
+				}
+
+				if (record.m_opcode == (uint32_t)ETraceOpcode::Allocate)
+				{
+					g_writer->Allocate(record.m_id, record.m_size, record.m_alignment);
+				}
+				else
+				{
+					g_writer->Free(record.m_id);
+				}
+
+				nextSequence = record.m_sequence + 1;
+				bestSequence = nextSequence;
+			}
+			best->m_head.store(head, std::memory_order_release);
+		}
+
+		// rings of the exited threads are reused once they are drained
+		for (TraceRing* ring = g_rings.load(std::memory_order_acquire); ring; ring = ring->m_next)
+		{
+			if (ring->m_state.load(std::memory_order_acquire) == TraceRing::Orphan && ring->m_head.load() == ring->m_tail.load())
+			{
+				ring->m_state.store(TraceRing::Free, std::memory_order_release);
+			}
+		}
+	}
+
+	void* FlushThread(void*)
+	{
+		t_state.m_bInside = true;
+
+		uint64_t nextSequence = 0;
+		uint64_t lastThreadId = ~0ull;
+		while (!g_bStop.load(std::memory_order_acquire))
+		{
+			Drain(nextSequence, lastThreadId, false);
+			g_writer->Flush();
+			usleep(1000);
+		}
+
+		Drain(nextSequence, lastThreadId, false);
+		Drain(nextSequence, lastThreadId, true);
+		return nullptr;
+	}
+
+	__attribute__((constructor)) void StartRecording()
+	{
+		InsideGuard guard;
+
+		GetRealUsableSize(nullptr);
+
+		const char* path = getenv("ALLOC_TRACE_FILE");
+		char defaultPath[64];
+		if (!path || !*path)
+		{
+			snprintf(defaultPath, sizeof(defaultPath), "alloc-trace.%d.bin", (int)getpid());
+			path = defaultPath;
+		}
+
+		g_writer = new AllocationTraceWriter();
+		if (!g_writer->Open(path))
+		{
+			fprintf(stderr, "TraceRecorder: can't open %s\n", path);
+			return;
+		}
+
+		pthread_key_create(&g_threadKey, OnThreadExit);
+		pthread_atfork(nullptr, nullptr, []() { g_bEnabled.store(false); });
+
+		if (pthread_create(&g_flushThread, nullptr, FlushThread, nullptr) != 0)
+		{
+			fprintf(stderr, "TraceRecorder: can't start the flush thread\n");
+			return;
+		}
+
+		g_bEnabled.store(true);
+	}
+
+	__attribute__((destructor)) void StopRecording()
+	{
+		if (!g_bEnabled.exchange(false))
+		{
+			return;
+		}
+
+		InsideGuard guard;
+		g_bStop.store(true, std::memory_order_release);
+		pthread_join(g_flushThread, nullptr);
+		g_writer->Close();
+	}
+}
+
+extern "C"
+{
+	void* malloc(size_t size)
+	{
+		return AllocateAligned(DEFAULT_ALIGNMENT, size);
+	}
+
+	void free(void* ptr)
+	{
+		if (!ptr)
+		{
+			return;
+		}
+
+		RecordFree(ptr);
+		__libc_free(GetRawBlock(ptr));
+	}
+
+	void* calloc(size_t count, size_t size)
+	{
+		if (size && count > (SIZE_MAX - HEADER_SIZE) / size)
+		{
+			errno = ENOMEM;
+			return nullptr;
+		}
+
+		return RecordAllocation(__libc_calloc(1, count * size + HEADER_SIZE), HEADER_SIZE, count * size, DEFAULT_ALIGNMENT);
+	}
+
+	void* realloc(void* ptr, size_t size)
+	{
+		if (!ptr)
+		{
+			return malloc(size);
+		}
+		if (size == 0)
+		{
+			free(ptr);
+			return nullptr;
+		}
+		if (size > SIZE_MAX - HEADER_SIZE)
+		{
+			errno = ENOMEM;
+			return nullptr;
+		}
+
+		// the new block is recorded before the old one is freed, both are alive during the copy
+		const BlockHeader oldHeader = *GetHeader(ptr);
+		void* res = nullptr;
+		if (oldHeader.m_offset == HEADER_SIZE)
+		{
+			void* raw = __libc_realloc(GetRawBlock(ptr), size + HEADER_SIZE);
+			if (!raw)
+			{
+				return nullptr;
+			}
+			res = RecordAllocation(raw, HEADER_SIZE, size, DEFAULT_ALIGNMENT);
+		}
+		else
+		{
+			res = malloc(size);
+			if (!res)
+			{
+				return nullptr;
+			}
+			const size_t oldSize = GetRealUsableSize(GetRawBlock(ptr)) - oldHeader.m_offset;
+			memcpy(res, ptr, oldSize < size ? oldSize : size);
+			__libc_free(GetRawBlock(ptr));
+		}
+
+		if (oldHeader.m_id != NO_ID && g_bEnabled.load(std::memory_order_relaxed) && !t_state.m_bInside)
+		{
+			InsideGuard guard;
+			Emit(ETraceOpcode::Free, oldHeader.m_id, 0, 0);
+			ReleaseId(oldHeader.m_id);
+		}
+
+		return res;
+	}
+
+	void* reallocarray(void* ptr, size_t count, size_t size)
+	{
+		if (size && count > SIZE_MAX / size)
+		{
+			errno = ENOMEM;
+			return nullptr;
+		}
+		return realloc(ptr, count * size);
+	}
+
+	void* memalign(size_t alignment, size_t size)
+	{
+		if (alignment & (alignment - 1))
+		{
+			errno = EINVAL;
+			return nullptr;
+		}
+		return AllocateAligned(alignment, size);
+	}
+
+	int posix_memalign(void** memptr, size_t alignment, size_t size)
+	{
+		if ((alignment & (alignment - 1)) || alignment % sizeof(void*) != 0)
+		{
+			return EINVAL;
+		}
+
+		void* ptr = AllocateAligned(alignment, size);
+		if (!ptr)
+		{
+			return ENOMEM;
+		}
+		*memptr = ptr;
+		return 0;
+	}
+
+	void* aligned_alloc(size_t alignment, size_t size)
+	{
+		return memalign(alignment, size);
+	}
+
+	void* valloc(size_t size)
+	{
+		return AllocateAligned((size_t)sysconf(_SC_PAGESIZE), size);
+	}
+
+	void* pvalloc(size_t size)
+	{
+		const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+		return AllocateAligned(pageSize, (size + pageSize - 1) & ~(pageSize - 1));
+	}
+
+	size_t malloc_usable_size(void* ptr)
+	{
+		if (!ptr)
+		{
+			return 0;
+		}
+		return GetRealUsableSize(GetRawBlock(ptr)) - GetHeader(ptr)->m_offset;
+	}
+}